@@ -0,0 +1,387 @@
+// run: make bench [BENCH_ARGS="iterations=5000 io-mode=reactor"]
+//
+// Drives connect, discovery, read and write round trips, write without response streaming, and notification delivery
+// against the simulated device in bench/peripheral.sim, printing ops/sec, latency percentiles, and CPU time per op as
+// JSON.  CPU time is for the whole process, so it includes the thread playing the device
+#include "warble/warble.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static const char* READ_UUID = "00002a29-0000-1000-8000-00805f9b34fb";
+static const char* WRITE_UUID = "326a9001-85cb-9195-d9dd-464cfbbae75a";
+static const char* NOTIFY_UUID = "326a9006-85cb-9195-d9dd-464cfbbae75a";
+static const seconds OP_TIMEOUT(10);
+
+struct Result {
+    string name;
+    size_t ops;
+    double elapsed_s;
+    // negative if the work cannot be told apart from the rest of the process
+    double cpu_s;
+    vector<double> latencies_us;
+};
+
+static double cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double elapsed_us(steady_clock::time_point start, steady_clock::time_point end) {
+    return duration_cast<nanoseconds>(end - start).count() / 1e3;
+}
+
+// Counts completions reported from warble's threads, keeping the first error
+class Completions {
+public:
+    Completions() : count(0) {
+    }
+
+    void complete(const char* error) {
+        lock_guard<mutex> lock(m);
+        if (error != nullptr && this->error.empty()) {
+            this->error = error;
+        }
+        count++;
+        cv.notify_all();
+    }
+
+    // throws if `target` completions are not reached in time or an op failed
+    void wait(size_t target, const string& what) {
+        unique_lock<mutex> lock(m);
+        if (!cv.wait_for(lock, OP_TIMEOUT, [this, target]() { return count >= target || !error.empty(); })) {
+            throw runtime_error(what + " timed out");
+        }
+        if (!error.empty()) {
+            throw runtime_error(what + " failed: " + error);
+        }
+    }
+
+private:
+    mutex m;
+    condition_variable cv;
+    size_t count;
+    string error;
+};
+
+struct TimedOp {
+    steady_clock::time_point start, end;
+    Completions* completions;
+};
+
+static void on_char_op(void* context, WarbleGattChar* caller, const char* error) {
+    auto op = static_cast<TimedOp*>(context);
+    op->end = steady_clock::now();
+    op->completions->complete(error);
+}
+
+static void on_read(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_UBYTE len, const char* error) {
+    on_char_op(context, caller, error);
+}
+
+static void on_connect(void* context, WarbleGatt* caller, const char* error) {
+    auto op = static_cast<TimedOp*>(context);
+    op->end = steady_clock::now();
+    op->completions->complete(error);
+}
+
+static void on_disconnect(void* context, WarbleGatt* caller, WARBLE_INT status) {
+    static_cast<Completions*>(context)->complete(nullptr);
+}
+
+static Result bench_connect(WarbleGatt* gatt, size_t iterations, Result& discovery) {
+    Result connect = { "connect", iterations, 0.0, 0.0, {} };
+    discovery = { "discovery", iterations, 0.0, -1.0, {} };
+
+    Completions connects, disconnects;
+    warble_gatt_on_disconnect(gatt, &disconnects, on_disconnect);
+
+    for(size_t i = 0; i < iterations; i++) {
+        WarbleGattStats before, after;
+        warble_gatt_get_stats(gatt, &before);
+
+        TimedOp op = { steady_clock::now(), {}, &connects };
+        auto cpu_start = cpu_seconds();
+        warble_gatt_connect_async(gatt, &op, on_connect);
+        connects.wait(i + 1, "connect");
+        connect.cpu_s += cpu_seconds() - cpu_start;
+        connect.latencies_us.push_back(elapsed_us(op.start, op.end));
+
+        // the library records discovery as part of every connect, the difference is this connect's
+        warble_gatt_get_stats(gatt, &after);
+        discovery.latencies_us.push_back(static_cast<double>(after.discovery.total_us - before.discovery.total_us));
+
+        // the last connection is left up for the benchmarks that follow
+        if (i + 1 < iterations) {
+            warble_gatt_disconnect(gatt);
+            disconnects.wait(i + 1, "disconnect");
+        }
+    }
+
+    warble_gatt_on_disconnect(gatt, nullptr, nullptr);
+
+    for(auto it: connect.latencies_us) {
+        connect.elapsed_s += it / 1e6;
+    }
+    for(auto it: discovery.latencies_us) {
+        discovery.elapsed_s += it / 1e6;
+    }
+    return connect;
+}
+
+// issues one op at a time, each after the previous one completed
+template<typename F>
+static Result bench_round_trip(const string& name, size_t iterations, F issue) {
+    Result result = { name, iterations, 0.0, 0.0, {} };
+    Completions completions;
+    TimedOp op = { {}, {}, &completions };
+
+    auto start = steady_clock::now();
+    auto cpu_start = cpu_seconds();
+    for(size_t i = 0; i < iterations; i++) {
+        op.start = steady_clock::now();
+        issue(&op);
+        completions.wait(i + 1, name);
+        result.latencies_us.push_back(elapsed_us(op.start, op.end));
+    }
+    result.cpu_s = cpu_seconds() - cpu_start;
+    result.elapsed_s = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+
+    return result;
+}
+
+// keeps `window` commands in flight, latency is from queueing a command until its callback
+static Result bench_write_without_resp(WarbleGattChar* gattchar, size_t iterations, size_t window, WARBLE_UBYTE len) {
+    Result result = { "write_without_resp", iterations, 0.0, 0.0, {} };
+    Completions completions;
+    vector<TimedOp> ops(iterations, { {}, {}, &completions });
+    vector<WARBLE_UBYTE> value(len, 0xa5);
+
+    auto start = steady_clock::now();
+    auto cpu_start = cpu_seconds();
+    for(size_t i = 0; i < iterations; i++) {
+        if (i >= window) {
+            completions.wait(i - window + 1, "write_without_resp");
+        }
+        ops[i].start = steady_clock::now();
+        warble_gattchar_write_without_resp_async(gattchar, value.data(), len, &ops[i], on_char_op);
+    }
+    completions.wait(iterations, "write_without_resp");
+    result.cpu_s = cpu_seconds() - cpu_start;
+    result.elapsed_s = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+
+    for(const auto& it: ops) {
+        result.latencies_us.push_back(elapsed_us(it.start, it.end));
+    }
+    return result;
+}
+
+struct NotificationState {
+    mutex m;
+    condition_variable cv;
+    size_t target;
+    vector<double> latencies_us;
+    steady_clock::time_point last;
+};
+
+static void on_notification(void* context, WarbleGattChar* caller, const WarbleGattNotificationEvent* event) {
+    auto state = static_cast<NotificationState*>(context);
+    auto now = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+
+    lock_guard<mutex> lock(state->m);
+    if (state->latencies_us.size() < state->target) {
+        // from the kernel receiving the packet until the application sees it
+        state->latencies_us.push_back((now - static_cast<int64_t>(event->timestamp)) / 1e3);
+        state->last = steady_clock::now();
+        if (state->latencies_us.size() == state->target) {
+            state->cv.notify_all();
+        }
+    }
+}
+
+static void ignore_notification(void* context, WarbleGattChar* caller, const WarbleGattNotificationEvent* event) {
+}
+
+static Result bench_notifications(WarbleGattChar* gattchar, size_t count, WarbleGattSequenceStats& sequence) {
+    Result result = { "notifications", count, 0.0, 0.0, {} };
+    NotificationState state;
+    state.target = count;
+    state.latencies_us.reserve(count);
+
+    // the simulated device puts a 32-bit little endian counter at the start of every notification
+    WarbleGattSequenceConfig config = { 0, 4, 0 };
+    warble_gattchar_set_sequence_tracking(gattchar, &config);
+    warble_gattchar_on_notification_received_ex(gattchar, &state, on_notification);
+
+    Completions completions;
+    TimedOp op = { {}, {}, &completions };
+    auto start = steady_clock::now();
+    auto cpu_start = cpu_seconds();
+    warble_gattchar_enable_notifications_async(gattchar, &op, on_char_op);
+    completions.wait(1, "enable notifications");
+    {
+        unique_lock<mutex> lock(state.m);
+        if (!state.cv.wait_for(lock, OP_TIMEOUT, [&state]() { return state.latencies_us.size() >= state.target; })) {
+            throw runtime_error("notifications timed out");
+        }
+    }
+    result.cpu_s = cpu_seconds() - cpu_start;
+
+    warble_gattchar_disable_notifications_async(gattchar, &op, on_char_op);
+    completions.wait(2, "disable notifications");
+    warble_gattchar_get_sequence_stats(gattchar, &sequence);
+    // notifications sent before the CCCD write may still be on their way
+    warble_gattchar_on_notification_received_ex(gattchar, nullptr, ignore_notification);
+
+    lock_guard<mutex> lock(state.m);
+    result.elapsed_s = duration_cast<nanoseconds>(state.last - start).count() / 1e9;
+    result.latencies_us = move(state.latencies_us);
+    return result;
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    // nearest rank
+    auto rank = static_cast<size_t>(ceil(p * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+static void print_result(Result& result, const string& extra, bool last) {
+    sort(result.latencies_us.begin(), result.latencies_us.end());
+
+    printf("    {\n");
+    printf("      \"name\": \"%s\",\n", result.name.c_str());
+    printf("      \"ops\": %zu,\n", result.ops);
+    printf("      \"ops_per_sec\": %.1f,\n", result.elapsed_s > 0.0 ? result.ops / result.elapsed_s : 0.0);
+    printf("      \"latency_us\": { \"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f },\n", percentile(result.latencies_us, 0.5),
+            percentile(result.latencies_us, 0.99), percentile(result.latencies_us, 0.999));
+    if (result.cpu_s < 0.0) {
+        printf("      \"cpu_us_per_op\": null%s\n", extra.empty() ? "" : ",");
+    } else {
+        printf("      \"cpu_us_per_op\": %.2f%s\n", result.cpu_s * 1e6 / result.ops, extra.empty() ? "" : ",");
+    }
+    if (!extra.empty()) {
+        printf("      %s\n", extra.c_str());
+    }
+    printf("    }%s\n", last ? "" : ",");
+}
+
+static size_t count_arg(unordered_map<string, string>& args, const string& key, size_t fallback) {
+    auto it = args.find(key);
+    if (it == args.end()) {
+        return fallback;
+    }
+
+    char* end;
+    auto value = strtoul(it->second.c_str(), &end, 10);
+    if (it->second.empty() || *end != '\0' || value == 0) {
+        throw runtime_error("'" + key + "' must be a positive integer");
+    }
+    return value;
+}
+
+int main(int argc, char** argv) {
+    unordered_map<string, string> args = {
+        { "sim-file", "bench/peripheral.sim" },
+        { "mac", "CA:FE:00:00:00:01" },
+        { "mtu", "247" }
+    };
+    for(int i = 1; i < argc; i++) {
+        auto split = strchr(argv[i], '=');
+        if (split == nullptr) {
+            cerr << "usage: " << argv[0] << " [sim-file=path] [mac=address] [mtu=n] [io-mode=thread|reactor] [io-threads=n] [connects=n] [iterations=n] "
+                    "[notifications=n] [window=n]" << endl;
+            return 1;
+        }
+        args[string(argv[i], split)] = split + 1;
+    }
+
+    try {
+        auto connects = count_arg(args, "connects", 100), iterations = count_arg(args, "iterations", 2000),
+                notifications = count_arg(args, "notifications", 20000), window = count_arg(args, "window", 32);
+
+        vector<WarbleOption> lib_opts = { { "sim-file", args["sim-file"].c_str() } };
+        for(auto key: { "io-mode", "io-threads" }) {
+            auto it = args.find(key);
+            if (it != args.end()) {
+                lib_opts.push_back({ key, it->second.c_str() });
+            }
+        }
+        warble_lib_init(static_cast<WARBLE_INT>(lib_opts.size()), lib_opts.data());
+
+        WarbleOption gatt_opts[] = {
+            { "mac", args["mac"].c_str() },
+            { "mtu", args["mtu"].c_str() }
+        };
+        auto gatt = warble_gatt_create_with_options(2, gatt_opts);
+        Result discovery;
+        auto connect = bench_connect(gatt, connects, discovery);
+
+        auto read_char = warble_gatt_find_characteristic(gatt, READ_UUID);
+        auto write_char = warble_gatt_find_characteristic(gatt, WRITE_UUID);
+        auto notify_char = warble_gatt_find_characteristic(gatt, NOTIFY_UUID);
+        if (read_char == nullptr || write_char == nullptr || notify_char == nullptr) {
+            throw runtime_error("device is missing the characteristics the benchmark uses");
+        }
+
+        auto read = bench_round_trip("read", iterations, [read_char](TimedOp* op) {
+            warble_gattchar_read_async(read_char, op, on_read);
+        });
+
+        WARBLE_UBYTE value[20] = { 0 };
+        auto write = bench_round_trip("write", iterations, [write_char, &value](TimedOp* op) {
+            warble_gattchar_write_async(write_char, value, sizeof(value), op, on_char_op);
+        });
+
+        // fills a whole command at the negotiated MTU
+        auto payload = static_cast<WARBLE_UBYTE>(min(255, warble_gatt_get_mtu(gatt) - 3));
+        auto write_without_resp = bench_write_without_resp(write_char, iterations * 10, window, payload);
+
+        WarbleGattSequenceStats sequence;
+        auto notify = bench_notifications(notify_char, notifications, sequence);
+
+        warble_gatt_disconnect(gatt);
+        warble_gatt_delete(gatt);
+
+        char extra[128];
+        printf("{\n");
+        printf("  \"version\": \"%s\",\n", warble_lib_version());
+        printf("  \"config\": \"%s\",\n", warble_lib_config());
+        printf("  \"io_mode\": \"%s\",\n", args.count("io-mode") ? args["io-mode"].c_str() : "thread");
+        printf("  \"benchmarks\": [\n");
+        print_result(connect, "", false);
+        print_result(discovery, "", false);
+        print_result(read, "", false);
+        print_result(write, "", false);
+        snprintf(extra, sizeof(extra), "\"bytes_per_op\": %u, \"window\": %zu", payload, window);
+        print_result(write_without_resp, extra, false);
+        snprintf(extra, sizeof(extra), "\"missing\": %u, \"out_of_order\": %u", sequence.missing, sequence.out_of_order);
+        print_result(notify, extra, true);
+        printf("  ]\n");
+        printf("}\n");
+    } catch (const exception& e) {
+        cerr << "gatt_bench: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+// compile: g++ -o uuid_lookup bench/uuid_lookup.cpp src/warble/cpp/uuid128.cpp -std=c++14 -O2 -Isrc
+//
+// Compares the per-lookup cost of find_characteristic's old key scheme, a std::string built from the caller's
+// uuid and hashed into an unordered_map, against parsing into a binary Uuid128 and binary searching a sorted table
+#include "warble/cpp/uuid128.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static const size_t ITERATIONS = 2000000;
+
+template<typename F>
+static double time_lookups(const vector<string>& keys, F lookup) {
+    size_t found = 0;
+    auto start = steady_clock::now();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+        found += lookup(keys[i % keys.size()].c_str()) != nullptr;
+    }
+    auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    if (found != ITERATIONS) {
+        cerr << "lookup missed " << (ITERATIONS - found) << " keys" << endl;
+    }
+    return static_cast<double>(elapsed) / ITERATIONS;
+}
+
+int main(int argc, char** argv) {
+    // roughly the attribute table of a MetaWear board: standard services plus a handful of vendor characteristics
+    vector<string> keys;
+    char buffer[37];
+    for(uint16_t short_uuid: { 0x2a00, 0x2a01, 0x2a04, 0x2a05, 0x2a19, 0x2a24, 0x2a25, 0x2a26, 0x2a27, 0x2a28, 0x2a29 }) {
+        snprintf(buffer, sizeof(buffer), "0000%.4x-0000-1000-8000-00805f9b34fb", short_uuid);
+        keys.push_back(buffer);
+    }
+    for(int i = 0; i < 8; i++) {
+        snprintf(buffer, sizeof(buffer), "326a90%.2x-85cb-9195-d9dd-464cfbbae75a", 0x01 + i);
+        keys.push_back(buffer);
+    }
+
+    int dummy;
+    void* value = &dummy;
+
+    unordered_map<string, void*> string_table;
+    vector<pair<Uuid128, void*>> binary_table;
+    for(auto& key: keys) {
+        Uuid128 uuid;
+        Uuid128::parse(key.c_str(), uuid);
+
+        string_table.emplace(key, value);
+        binary_table.emplace_back(uuid, value);
+    }
+    sort(binary_table.begin(), binary_table.end(), [](const pair<Uuid128, void*>& a, const pair<Uuid128, void*>& b) {
+        return a.first < b.first;
+    });
+
+    double string_ns = time_lookups(keys, [&string_table](const char* uuid) -> void* {
+        auto it = string_table.find(string(uuid));
+        return it == string_table.end() ? nullptr : it->second;
+    });
+    double binary_ns = time_lookups(keys, [&binary_table](const char* uuid) -> void* {
+        Uuid128 key;
+        if (!Uuid128::parse(uuid, key)) {
+            return nullptr;
+        }
+
+        auto it = lower_bound(binary_table.begin(), binary_table.end(), key, [](const pair<Uuid128, void*>& entry, const Uuid128& key) {
+            return entry.first < key;
+        });
+        return it == binary_table.end() || it->first != key ? nullptr : it->second;
+    });
+
+    cout << keys.size() << " characteristics, " << ITERATIONS << " lookups" << endl;
+    cout << "unordered_map<string>: " << string_ns << " ns/lookup" << endl;
+    cout << "sorted Uuid128 table:  " << binary_ns << " ns/lookup" << endl;
+    return 0;
+}
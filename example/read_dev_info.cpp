@@ -2,45 +2,13 @@
 #include "warble/warble.h"
 
 #include <condition_variable>
-#include <functional>
 #include <iostream>
 #include <mutex>
-#include <queue>
 #include <string>
+#include <vector>
 
 using namespace std;
 
-static function<void(void)> read_completed;
-static queue<const char*> uuids;
-static void read_char_values(WarbleGatt* gatt) {
-    if (!uuids.size()) {
-        read_completed();
-        return;
-    }
-
-    auto next = uuids.front();
-    auto gatt_char = warble_gatt_find_characteristic(gatt, next);
-
-    if (gatt_char == nullptr) {
-        cout << next << ": not found " << endl;
-    } else {
-        warble_gattchar_read_async(gatt_char, nullptr, [](void* context, WarbleGattChar* caller, const uint8_t* value, uint8_t length, const char* error) {
-            cout << warble_gattchar_get_uuid(caller);
-            
-            if (error != nullptr) {
-                cout << ": error reading value (" << error << ")" << endl;
-            } else {
-                cout << ": " << string(value, value + length) << endl;
-            }
-
-            WarbleGatt* gatt = (WarbleGatt*) context;
-            uuids.pop();
-
-            read_char_values(warble_gattchar_get_gatt(caller));
-        });
-    }
-}
-
 static condition_variable cv;
 
 int main(int argc, char** argv) {
@@ -50,17 +18,39 @@ int main(int argc, char** argv) {
     auto gatt = warble_gatt_create(argv[1]);
 
     warble_gatt_connect_async(gatt, nullptr, [](void* context, WarbleGatt* caller, const char* error) {
-        uuids.push("00002a26-0000-1000-8000-00805f9b34fb");
-        uuids.push("00002a24-0000-1000-8000-00805f9b34fb");
-        uuids.push("00002a27-0000-1000-8000-00805f9b34fb");
-        uuids.push("00002a29-0000-1000-8000-00805f9b34fb");
-        uuids.push("00002a25-0000-1000-8000-00805f9b34fb");
-
-        read_completed = []() {
-            cv.notify_all();
+        const char* uuids[] = {
+            "00002a26-0000-1000-8000-00805f9b34fb",
+            "00002a24-0000-1000-8000-00805f9b34fb",
+            "00002a27-0000-1000-8000-00805f9b34fb",
+            "00002a29-0000-1000-8000-00805f9b34fb",
+            "00002a25-0000-1000-8000-00805f9b34fb"
         };
 
-        read_char_values(caller);
+        vector<WarbleGattChar*> chars;
+        for(auto it: uuids) {
+            auto gatt_char = warble_gatt_find_characteristic(caller, it);
+            if (gatt_char == nullptr) {
+                cout << it << ": not found " << endl;
+            } else {
+                chars.push_back(gatt_char);
+            }
+        }
+
+        // every value comes back in one callback, packed into as few requests as the device allows
+        warble_gatt_read_multiple(caller, chars.data(), static_cast<int32_t>(chars.size()), nullptr,
+                [](void* context, WarbleGatt* caller, const WarbleGattOpResult* results, int32_t nresults, uint32_t elapsed) {
+            for(int32_t i = 0; i < nresults; i++) {
+                cout << warble_gattchar_get_uuid(results[i].gattchar);
+
+                if (results[i].error != nullptr) {
+                    cout << ": error reading value (" << results[i].error << ")" << endl;
+                } else {
+                    cout << ": " << string(results[i].value, results[i].value + results[i].len) << endl;
+                }
+            }
+
+            cv.notify_all();
+        });
     });
 
     cv.wait(lock);
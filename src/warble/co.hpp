@@ -0,0 +1,598 @@
+/**
+ * @copyright MbientLab License
+ * @file co.hpp
+ * @brief Optional C++20 coroutine front-end over the warble callback functions
+ *
+ * Awaiting one of the operations issues the warble call, and the completion callback resumes the coroutine directly,
+ * on whichever thread warble runs the callback.  Nothing blocks while an operation is in flight, so a handful of
+ * threads can drive as many device sessions as there are coroutines.  The header needs C++20, the library does not.
+ * @code
+ * warble::co::Task<void> session(WarbleGatt* gatt) {
+ *     co_await warble::co::connect(gatt);
+ *
+ *     auto firmware = co_await warble::co::read(warble_gatt_find_characteristic(gatt, "00002a26-0000-1000-8000-00805f9b34fb"));
+ *
+ *     auto data = warble_gatt_find_characteristic(gatt, "326a9006-85cb-9195-d9dd-464cfbbae75a");
+ *     warble::co::NotificationStream stream(data);
+ *     co_await warble::co::enable_notifications(data);
+ *     while(auto value = co_await stream.next()) {
+ *         // ...
+ *     }
+ * }
+ *
+ * warble::co::spawn(session(gatt));
+ * @endcode
+ */
+#pragma once
+
+#if __cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error "warble/co.hpp requires C++20"
+#endif
+
+#include "gatt.h"
+#include "gattchar.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace warble {
+namespace co {
+
+/**
+ * Thrown from <code>co_await</code> when warble completes the operation with an error
+ */
+class Error : public std::runtime_error {
+public:
+    explicit Error(const std::string& msg) : std::runtime_error(msg) {
+    }
+};
+
+template<typename T>
+class Task;
+
+namespace detail {
+
+/**
+ * Awaitable for one warble call.  The call may complete before it returns, inline or on another thread, so
+ * await_suspend and the callback race on a flag and whichever gets there second resumes the coroutine
+ */
+template<typename T, typename Derived>
+class Operation {
+public:
+    Operation() = default;
+    Operation(const Operation&) = delete;
+    Operation& operator=(const Operation&) = delete;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        continuation = handle;
+        static_cast<Derived*>(this)->issue();
+        return !completed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    T await_resume() {
+        if (!error.empty()) {
+            throw Error(error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(result);
+        }
+    }
+
+protected:
+    // Called from the warble callback, value is the error message or nullptr
+    void complete(const char* value) {
+        if (value != nullptr) {
+            error = value;
+        }
+        if (completed.exchange(true, std::memory_order_acq_rel)) {
+            continuation.resume();
+        }
+    }
+
+    struct Empty {};
+    std::conditional_t<std::is_void_v<T>, Empty, T> result{};
+
+private:
+    std::coroutine_handle<> continuation;
+    std::atomic<bool> completed{false};
+    std::string error;
+};
+
+template<typename T>
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    std::optional<T> value;
+
+    template<typename U>
+    void return_value(U&& result) {
+        value.emplace(std::forward<U>(result));
+    }
+    T take() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromiseBase<void> {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    void return_void() {
+    }
+    void take() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+/**
+ * Coroutine that starts right away and frees itself when done, used to run a Task without awaiting it
+ */
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {
+        }
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+}
+
+/**
+ * Coroutine returning T.  It starts when awaited, and the awaiting coroutine resumes from the thread it finishes on
+ */
+template<typename T>
+class Task {
+public:
+    struct promise_type : detail::TaskPromiseBase<T> {
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {
+                }
+            };
+            return FinalAwaiter{};
+        }
+        void unhandled_exception() noexcept {
+            this->exception = std::current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() {
+                return handle.promise().take();
+            }
+        };
+        return Awaiter{handle};
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+
+inline Detached run_detached(Task<void> task) {
+    co_await std::move(task);
+}
+
+template<typename T>
+struct SyncState {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    std::exception_ptr exception;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+};
+
+template<typename T>
+Detached run_sync(Task<T> task, SyncState<T>* state) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(task);
+        } else {
+            state->value.emplace(co_await std::move(task));
+        }
+    } catch (...) {
+        state->exception = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(state->m);
+    state->done = true;
+    state->cv.notify_all();
+}
+
+}
+
+/**
+ * Starts the task without waiting on it, an exception escaping the task terminates the program
+ */
+inline void spawn(Task<void> task) {
+    detail::run_detached(std::move(task));
+}
+
+/**
+ * Blocks the calling thread until the task is done, for bridging from code that is not a coroutine such as main.
+ * Must not be called from a warble callback
+ */
+template<typename T>
+T sync_wait(Task<T> task) {
+    detail::SyncState<T> state;
+    detail::run_sync(std::move(task), &state);
+
+    std::unique_lock<std::mutex> lock(state.m);
+    state.cv.wait(lock, [&state]() { return state.done; });
+    if (state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*state.value);
+    }
+}
+
+/**
+ * Awaitable for <code>warble_gatt_connect_async</code>
+ */
+class Connect : public detail::Operation<void, Connect> {
+public:
+    explicit Connect(WarbleGatt* gatt) : gatt(gatt) {
+    }
+
+    void issue() {
+        warble_gatt_connect_async(gatt, this, [](void* context, WarbleGatt* caller, const char* value) {
+            static_cast<Connect*>(context)->complete(value);
+        });
+    }
+
+private:
+    WarbleGatt* gatt;
+};
+
+/**
+ * Awaitable for <code>warble_gatt_disconnect</code>, resumes with the status the on_disconnect handler receives.
+ * Replaces the handler set with <code>warble_gatt_on_disconnect</code>, and only completes if the object is connected
+ */
+class Disconnect : public detail::Operation<std::int32_t, Disconnect> {
+public:
+    explicit Disconnect(WarbleGatt* gatt) : gatt(gatt) {
+    }
+
+    void issue() {
+        warble_gatt_on_disconnect(gatt, this, [](void* context, WarbleGatt* caller, std::int32_t value) {
+            auto self = static_cast<Disconnect*>(context);
+            warble_gatt_on_disconnect(caller, nullptr, [](void* context, WarbleGatt* caller, std::int32_t value) { });
+            self->result = value;
+            self->complete(nullptr);
+        });
+        warble_gatt_disconnect(gatt);
+    }
+
+private:
+    WarbleGatt* gatt;
+};
+
+/**
+ * Awaitable for <code>warble_gattchar_read_async</code> and <code>warble_gattchar_read_long_async</code>
+ */
+class Read : public detail::Operation<std::vector<std::uint8_t>, Read> {
+public:
+    Read(WarbleGattChar* gattchar, bool long_read) : gattchar(gattchar), long_read(long_read) {
+    }
+
+    void issue() {
+        if (long_read) {
+            warble_gattchar_read_long_async(gattchar, this, [](void* context, WarbleGattChar* caller, const std::uint8_t* value, std::uint16_t length, const char* error) {
+                static_cast<Read*>(context)->finish(value, length, error);
+            });
+        } else {
+            warble_gattchar_read_async(gattchar, this, [](void* context, WarbleGattChar* caller, const std::uint8_t* value, std::uint8_t length, const char* error) {
+                static_cast<Read*>(context)->finish(value, length, error);
+            });
+        }
+    }
+
+private:
+    void finish(const std::uint8_t* value, std::size_t length, const char* error) {
+        if (error == nullptr) {
+            result.assign(value, value + length);
+        }
+        complete(error);
+    }
+
+    WarbleGattChar* gattchar;
+    bool long_read;
+};
+
+/**
+ * Awaitable for the warble_gattchar write functions, the value is copied into the awaitable
+ */
+class Write : public detail::Operation<void, Write> {
+public:
+    enum class Kind {
+        WITH_RESPONSE,
+        WITHOUT_RESPONSE,
+        LONG
+    };
+
+    Write(WarbleGattChar* gattchar, Kind kind, const std::uint8_t* value, std::size_t len) : gattchar(gattchar), kind(kind), value(value, value + len) {
+        if (len > (kind == Kind::LONG ? UINT16_MAX : UINT8_MAX)) {
+            throw std::length_error("value is too long for the write type");
+        }
+    }
+
+    void issue() {
+        auto handler = [](void* context, WarbleGattChar* caller, const char* error) {
+            static_cast<Write*>(context)->complete(error);
+        };
+
+        switch(kind) {
+        case Kind::WITH_RESPONSE:
+            warble_gattchar_write_async(gattchar, value.data(), static_cast<std::uint8_t>(value.size()), this, handler);
+            break;
+        case Kind::WITHOUT_RESPONSE:
+            warble_gattchar_write_without_resp_async(gattchar, value.data(), static_cast<std::uint8_t>(value.size()), this, handler);
+            break;
+        case Kind::LONG:
+            warble_gattchar_write_long_async(gattchar, value.data(), static_cast<std::uint16_t>(value.size()), this, handler);
+            break;
+        }
+    }
+
+private:
+    WarbleGattChar* gattchar;
+    Kind kind;
+    std::vector<std::uint8_t> value;
+};
+
+/**
+ * Awaitable for <code>warble_gattchar_enable_notifications_async</code> and <code>warble_gattchar_disable_notifications_async</code>
+ */
+class SetNotifications : public detail::Operation<void, SetNotifications> {
+public:
+    SetNotifications(WarbleGattChar* gattchar, bool enable) : gattchar(gattchar), enable(enable) {
+    }
+
+    void issue() {
+        auto handler = [](void* context, WarbleGattChar* caller, const char* error) {
+            static_cast<SetNotifications*>(context)->complete(error);
+        };
+
+        if (enable) {
+            warble_gattchar_enable_notifications_async(gattchar, this, handler);
+        } else {
+            warble_gattchar_disable_notifications_async(gattchar, this, handler);
+        }
+    }
+
+private:
+    WarbleGattChar* gattchar;
+    bool enable;
+};
+
+inline Connect connect(WarbleGatt* gatt) {
+    return Connect(gatt);
+}
+
+inline Disconnect disconnect(WarbleGatt* gatt) {
+    return Disconnect(gatt);
+}
+
+inline Read read(WarbleGattChar* gattchar) {
+    return Read(gattchar, false);
+}
+
+inline Read read_long(WarbleGattChar* gattchar) {
+    return Read(gattchar, true);
+}
+
+inline Write write(WarbleGattChar* gattchar, const std::vector<std::uint8_t>& value) {
+    return Write(gattchar, Write::Kind::WITH_RESPONSE, value.data(), value.size());
+}
+
+inline Write write_without_resp(WarbleGattChar* gattchar, const std::vector<std::uint8_t>& value) {
+    return Write(gattchar, Write::Kind::WITHOUT_RESPONSE, value.data(), value.size());
+}
+
+inline Write write_long(WarbleGattChar* gattchar, const std::vector<std::uint8_t>& value) {
+    return Write(gattchar, Write::Kind::LONG, value.data(), value.size());
+}
+
+inline SetNotifications enable_notifications(WarbleGattChar* gattchar) {
+    return SetNotifications(gattchar, true);
+}
+
+inline SetNotifications disable_notifications(WarbleGattChar* gattchar) {
+    return SetNotifications(gattchar, false);
+}
+
+/**
+ * Async generator over a characteristic's notifications.  Takes over the characteristic's notification handler
+ * while it exists; values that arrive while no coroutine is waiting are queued.  The stream must outlive any
+ * notification in flight, disable notifications or disconnect before destroying it
+ */
+class NotificationStream {
+public:
+    explicit NotificationStream(WarbleGattChar* gattchar) : gattchar(gattchar) {
+        warble_gattchar_on_notification_received_long(gattchar, this, [](void* context, WarbleGattChar* caller, const std::uint8_t* value, std::uint16_t length) {
+            static_cast<NotificationStream*>(context)->push(std::vector<std::uint8_t>(value, value + length));
+        });
+    }
+    NotificationStream(const NotificationStream&) = delete;
+    NotificationStream& operator=(const NotificationStream&) = delete;
+
+    ~NotificationStream() {
+        // not every backend checks for a null handler
+        warble_gattchar_on_notification_received_long(gattchar, nullptr, [](void* context, WarbleGattChar* caller, const std::uint8_t* value, std::uint16_t length) { });
+    }
+
+    /**
+     * Awaitable resuming with the next value, or an empty optional once the stream is closed
+     */
+    class Next {
+    public:
+        explicit Next(NotificationStream& stream) : stream(stream) {
+        }
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(stream.m);
+            return stream.take(value);
+        }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(stream.m);
+            if (stream.take(value)) {
+                return false;
+            }
+            stream.waiter = this;
+            continuation = handle;
+            return true;
+        }
+        std::optional<std::vector<std::uint8_t>> await_resume() {
+            return std::move(value);
+        }
+
+    private:
+        friend NotificationStream;
+
+        NotificationStream& stream;
+        std::optional<std::vector<std::uint8_t>> value;
+        std::coroutine_handle<> continuation;
+    };
+
+    Next next() {
+        return Next(*this);
+    }
+
+    /**
+     * Ends the stream, a waiting coroutine resumes with an empty optional once queued values are taken
+     */
+    void close() {
+        Next* resumed;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            closed = true;
+            resumed = std::exchange(waiter, nullptr);
+        }
+        if (resumed != nullptr) {
+            resumed->continuation.resume();
+        }
+    }
+
+    /**
+     * Number of values waiting to be taken
+     */
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m);
+        return queued.size();
+    }
+
+private:
+    // Must be called with the mutex held, returns false if the caller has to wait
+    bool take(std::optional<std::vector<std::uint8_t>>& value) {
+        if (!queued.empty()) {
+            value.emplace(std::move(queued.front()));
+            queued.pop_front();
+            return true;
+        }
+        return closed;
+    }
+
+    void push(std::vector<std::uint8_t> value) {
+        Next* resumed;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (closed) {
+                return;
+            }
+            if ((resumed = std::exchange(waiter, nullptr)) == nullptr) {
+                queued.push_back(std::move(value));
+                return;
+            }
+            resumed->value.emplace(std::move(value));
+        }
+        // hands the value straight to the waiting coroutine, which runs on the I/O thread until it suspends again
+        resumed->continuation.resume();
+    }
+
+    WarbleGattChar* gattchar;
+    mutable std::mutex m;
+    std::deque<std::vector<std::uint8_t>> queued;
+    Next* waiter = nullptr;
+    bool closed = false;
+};
+
+}
+}
@@ -0,0 +1,65 @@
+/**
+ * @copyright MbientLab License
+ * @file connmgr.h
+ * @brief Functions for the WarbleConnMgr object
+ */
+#pragma once
+
+#include "dllmarker.h"
+#include "gatt_fwd.h"
+#include "types.h"
+
+/**
+ * Queues connect attempts so each HCI adapter only has a bounded number in progress at once
+ */
+#ifdef __cplusplus
+struct WarbleConnMgr;
+#else
+typedef struct WarbleConnMgr WarbleConnMgr;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates a WarbleConnMgr object.  Available options:
+ * <ul>
+ *  <li>'connects-per-adapter': number of connect attempts each adapter runs at once, defaults to 1.  Gatt objects that 
+ *  balance links over several adapters use the least loaded one with a free slot for each attempt</li>
+ *  <li>'retries': number of times a failed attempt is retried before its failure is reported, defaults to 2</li>
+ * </ul>
+ * @param nopts         Number of options being passed
+ * @param opts          Array of config options
+ * @return Pointer to the newly created object
+ */
+WARBLE_API WarbleConnMgr* warble_connmgr_create(WARBLE_INT nopts, const WarbleOption* opts);
+/**
+ * Frees the memory allocated for the WarbleConnMgr object.  Attempts that have not started are cancelled and
+ * reported as failed, the function then waits for attempts in progress to finish.  Must not be called from a
+ * warble callback function
+ * @param obj           Object to delete
+ */
+WARBLE_API void warble_connmgr_delete(WarbleConnMgr* obj);
+/**
+ * Queues the WarbleGatt objects to connect, grouped by the adapter each one was created with.  Attempts on
+ * the same adapter run in the order they were queued and failed attempts are retried at the back of the queue.
+ * The WarbleGatt objects must stay alive until the handler has been called for them.
+ * @param obj           Calling object
+ * @param gatts         Array of objects to connect
+ * @param ngatts        Number of elements in the gatts array
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed once per WarbleGatt object, when it has connected or
+ *                      has run out of retries
+ */
+WARBLE_API void warble_connmgr_connect_async(WarbleConnMgr* obj, WarbleGatt* const* gatts, WARBLE_INT ngatts, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+/**
+ * Gets the number of WarbleGatt objects that have been queued but have not yet been reported to their handler
+ * @param obj           Calling object
+ * @return Number of queued and in progress connect attempts
+ */
+WARBLE_API WARBLE_INT warble_connmgr_get_pending(const WarbleConnMgr* obj);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
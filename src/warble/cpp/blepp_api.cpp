@@ -7,90 +7,479 @@
 #include "gattchar_def.h"
 #include "error_messages.h"
 
-#include "blepp_utils.h"
+#include "gatt_batch.h"
+#include "gatt_stats.h"
+#include "notification_ring.h"
+
+#include "blepp_att.h"
+#include "blepp_cache.h"
+#include "blepp_capture.h"
+#include "blepp_discovery.h"
+#include "blepp_hci.h"
+#include "blepp_l2cap.h"
+#include "blepp_reactor.h"
+#include "blepp_transport.h"
 #include "blepp/blestatemachine.h"
 #include "blepp/pretty_printers.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
 #include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <thread>
 #include <unistd.h>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 
 using namespace std;
+using namespace std::chrono;
 using namespace BLEPP;
 
 struct WarbleGattChar_Blepp;
 
-struct WarbleGatt_Blepp : public WarbleGatt {
-    WarbleGatt_Blepp(const char* mac, const char* hci_mac, bool public_addr);
+/**
+ * Characteristics read by one READ_MULTIPLE op.  Values are requested with Read Multiple Variable while the remote 
+ * device supports it, and one at a time after that
+ */
+struct MultiRead {
+    struct Entry {
+        WarbleGattChar_Blepp* source;
+        // batch slot the outcome is reported to
+        void* slot;
+        uint16_t handle;
+        vector<uint8_t> value;
+        string error;
+        bool done;
+    };
+
+    vector<Entry> entries;
+    // first entry not yet read, and how many entries the request in flight covers
+    size_t next, requested;
+    // the value at `next` was cut short by the end of a response, the rest is fetched with read blob requests
+    bool partial;
+};
+
+/**
+ * ATT request waiting in, or at the head of, a connection's operation queue.  Long reads and writes span several 
+ * request/response exchanges and track their progress in the op while it stays at the head of the queue
+ */
+struct GattOp {
+    enum Type {
+        READ,
+        WRITE,
+        // write without response, completes as soon as it is handed to the socket
+        WRITE_CMD,
+        // read followed by read blob requests until a short response
+        READ_LONG,
+        // write request if the value fits in one PDU, otherwise prepare write requests then an execute write
+        WRITE_LONG,
+        // walks the characteristics of a service that was skipped when the link was set up
+        DISCOVER,
+        // reads a group of characteristics, each one's outcome goes to its own WarbleGattBatch slot
+        READ_MULTIPLE
+    };
+
+    Type type;
+    WarbleGattChar_Blepp* source;
+    uint16_t handle;
+    // bytes to write, or bytes read so far
+    vector<uint8_t> value;
+    const char* error_prefix;
+
+    // request currently awaiting a response
+    uint8_t sent_opcode;
+    // next offset for read blob or prepare write requests
+    uint16_t offset;
+    // prepared writes are being discarded after a failure, error holds the original cause
+    bool cancelling;
+    string error;
+    // progress of a DISCOVER op
+    unique_ptr<GattDiscovery> discovery;
+    // progress of a READ_MULTIPLE op
+    unique_ptr<MultiRead> multiple;
+    // when the first request went out, for the round trip histograms
+    steady_clock::time_point started;
+
+    void* context;
+    FnVoid_VoidP_WarbleGattCharP_CharP write_handler;
+    FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP read_handler;
+    FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP read_long_handler;
+};
+
+/**
+ * Write without response command waiting for room in the socket
+ */
+struct StreamCommand {
+    vector<uint8_t> pdu;
+    WarbleGattChar_Blepp* source;
+    // only set for write_without_resp_async calls, the handler is called once the socket takes the command
+    void* context;
+    FnVoid_VoidP_WarbleGattCharP_CharP handler;
+};
+
+struct WarbleGatt_Blepp : public WarbleGatt, public BleppIoSource {
+    enum class DiscoveryMode {
+        // every service is walked before the connect task completes
+        ALL,
+        // only services in the discovery filter are walked
+        FILTERED,
+        // services are walked the first time find_characteristic needs them
+        ON_DEMAND
+    };
+
+    struct ReconnectPolicy {
+        bool enabled;
+        // delay before the first attempt, doubled after each failure up to max_delay
+        milliseconds initial_delay, max_delay;
+        // 0 to keep trying until disconnect is called
+        uint32_t max_attempts;
+    };
+
+    struct ConnectPolicy {
+        // how long the controller looks for the device before the attempt is reported as timed out
+        milliseconds timeout;
+        // LE Create Connection scan interval and window in 0.625ms units, the kernel defaults are used if not set
+        bool set_scan;
+        uint16_t scan_interval, scan_window;
+    };
+
+    WarbleGatt_Blepp(const char* mac, const char* hci_mac, bool public_addr, uint16_t requested_mtu, 
+            size_t notification_capacity, NotificationRing::Overflow notification_overflow, DiscoveryMode discovery_mode, 
+            vector<Uuid128> discovery_filter, const ReconnectPolicy& reconnect_policy, const HciConnParams* conn_params, 
+            const ConnectPolicy& connect_policy, size_t stream_window);
     virtual ~WarbleGatt_Blepp();
 
     virtual void connect_async(void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+    virtual void cancel_connect();
     virtual void disconnect();
     virtual void on_disconnect(void* context, FnVoid_VoidP_WarbleGattP_Int handler);
     virtual bool is_connected() const;
 
-    virtual WarbleGattChar* find_characteristic(const std::string& uuid) const;
-    virtual bool service_exists(const std::string& uuid) const;
+    virtual WarbleGattChar* find_characteristic(const char* uuid) const;
+    virtual bool service_exists(const char* uuid) const;
+    virtual int32_t get_queue_depth() const;
+    virtual uint16_t get_mtu() const;
+    virtual const char* choose_adapter(const vector<string>& full);
+    virtual void get_reconnect_stats(WarbleReconnectStats* stats) const;
+    virtual void get_stats(WarbleGattStats* stats) const;
+    virtual void on_stream_ready(void* context, FnVoid_VoidP_WarbleGattP handler);
+    virtual uint32_t get_stream_queued() const;
+    virtual WarbleL2capChannel* create_l2cap_channel(uint16_t psm, int32_t nopts, const WarbleOption* opts);
+    virtual int32_t get_fd(uint32_t* events) const;
+    virtual int32_t get_timeout() const;
+    virtual void process(uint32_t events);
+    virtual void update_conn_params(const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+    virtual void read_multiple(WarbleGattChar* const* chars, int32_t nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
+    virtual void submit_batch(const WarbleGattOp* ops, int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
+
+    virtual int io_fd() const;
+    virtual bool io_wants_write() const;
+    virtual steady_clock::time_point io_deadline() const;
+    virtual void io_process(bool readable, bool writable);
+    virtual void io_timeout();
 
 private:
     friend WarbleGattChar_Blepp;
 
     void clear_characteristics();
+    // Looks up a characteristic from the services walked so far, attr_mutex must be held
+    WarbleGattChar_Blepp* lookup_characteristic(const Uuid128& uuid) const;
+    // Walks services not yet discovered, one at a time, until one holds the characteristic.  Blocks the calling thread
+    WarbleGattChar_Blepp* discover_characteristic(const Uuid128& uuid);
+    // Adds the characteristics of a service walked after the link was set up
+    void add_discovered(GattServiceInfo& walked);
+    // Reuses the object a characteristic had on an earlier connection, or creates one.  attr_mutex must be held
+    WarbleGattChar_Blepp* bind_characteristic(const GattCharacteristicInfo& info);
+
+    // Each returns false once the connection attempt or link has ended, at which point the object may already be freed
+    bool start_session();
+    bool handle_events(bool readable, bool writable);
+    bool handle_timeout();
+    bool handle_failure();
+    // Reports a connect attempt that failed before the link came up
+    bool fail_connect(const char* error);
+    // Called right before the connect handler runs, cancel_connect no longer applies to the attempt after this
+    void end_connect_attempt(bool succeeded);
+    bool end_session();
+    void close_session();
+    void release_session();
+
+    // Auto-reconnect: waits out the backoff delay, on its own thread only in the thread io-mode, then starts a connect attempt
+    void schedule_reconnect();
+    // Starts the next attempt once the backoff delay is over, or gives up if reconnecting was cancelled
+    void attempt_reconnect();
+    // Clears the pending reconnect and reports the link loss, the object may be freed once this returns
+    void stop_reconnecting();
+    static void reconnect_completed(void* context, WarbleGatt* caller, const char* value);
+    void report_conn_params(const string& cause, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+
+    // Link setup once libblepp has connected the socket: optional MTU exchange, a cache check when the 
+    // attribute cache is enabled, then service discovery if the cache could not be used
+    void begin_setup();
+    void check_cache();
+    // Whether a service's characteristics are walked while the link is set up
+    bool walk_at_connect(const Uuid128& uuid) const;
+    void start_discovery();
+    // Walks services from a cached table the discovery filter selects but the cache does not have
+    void resume_discovery(vector<GattServiceInfo> known);
+    void continue_discovery();
+    void process_setup_response(const uint8_t* pdu, size_t len);
+    void setup_failed(const char* error);
+    void finish_setup();
+    void service_changed();
+
+    // ATT bearer, owned by warble as soon as the link is up
+    void process_att();
+    // Setup requests wait a bit for the socket to have room, a stream filling the socket buffer must not fail them
+    bool att_send(const uint8_t* pdu, size_t len, bool wait_on_full = true);
+    void submit(GattOp* ops, size_t nops);
+    // Queues a write command and sends what the socket takes.  Windowed commands are refused, returning false, once 
+    // stream_window commands are waiting
+    bool stream_enqueue(StreamCommand command, bool windowed);
+    // Hands queued write commands to the socket until it is full, then waits on the socket becoming writable
+    void flush_stream();
+    void fail_stream(const char* error);
+    // Gets the I/O thread to pick up a change in io_wants_write
+    void refresh_io_events();
+    // Sends queued requests until one is in flight or the socket is full, op_mutex must be held.  Ops that finish 
+    // without waiting on a response are moved to `finished` with their error field set if they failed
+    void pump(vector<GattOp>& finished);
+    // Picks up pump where a full socket stopped it, called by the I/O thread once the socket is writable
+    void resume_ops();
+    // Sends the next request for the op, returns false and sets the op's error if the socket write failed.  A full 
+    // socket leaves the request unsent with ops_blocked set, the op is still pending so true is returned
+    bool send_request(GattOp& op);
+    // Updates the head op with a response PDU, returns true once the op is done.  op_mutex must be held
+    bool advance_head(GattOp& op, const uint8_t* pdu, size_t len);
+    bool advance_read_multiple(GattOp& op, const uint8_t* pdu, size_t len);
+    void process_response(const uint8_t* pdu, size_t len);
+    void complete_finished(vector<GattOp>& finished);
+    void complete(GattOp& op);
+    void fail_pending(const char* error);
 
     string mac, hci_mac;
-
-    void *on_disconnect_context;
+    // "auto" or a comma separated list spreads connections over adapters, an empty candidate list meaning every adapter
+    bool hci_balanced;
+    vector<string> hci_candidates;
+    // adapter the current session's link is counted against, and the one the connection manager chose for the next session
+    string session_hci, next_hci;
+    // 0 if notifications are handed straight to the handlers
+    size_t notification_capacity;
+    NotificationRing::Overflow notification_overflow;
+    DiscoveryMode discovery_mode;
+    // sorted
+    vector<Uuid128> discovery_filter;
+
+    void *on_disconnect_context, *connect_context;
     FnVoid_VoidP_WarbleGattP_Int on_disconnect_handler;
+    FnVoid_VoidP_WarbleGattP_CharP connect_handler;
+
+    ConnectPolicy connect_policy;
+    steady_clock::time_point connect_started, setup_started, last_notification;
+    GattStats stats;
+    // connect_pending is guarded by session_mutex, connect_cancelled is also read by the io thread
+    bool connect_pending;
+    atomic<bool> connect_cancelled;
+
+    // requested as soon as the link is up
+    bool request_conn_params;
+    HciConnParams conn_params;
+
+    // stream_full is set when a windowed command was refused, the ready handler is called once the queue drains to half
+    mutable mutex stream_mutex;
+    deque<StreamCommand> stream;
+    size_t stream_window, stream_bytes;
+    bool stream_full;
+    // socket refused a command, read by the I/O thread to decide whether to wait on the socket becoming writable
+    atomic<bool> stream_blocked;
+    void* stream_ready_context;
+    FnVoid_VoidP_WarbleGattP stream_ready_handler;
+    // wakes the per connection I/O thread when it has to start waiting on writes, unused in reactor mode
+    int wake_fd;
+
+    mutable mutex op_mutex;
+    deque<GattOp> pending_ops;
+    bool op_in_flight, att_ready;
+    // head op could not be sent for lack of room in the socket, read by the I/O thread like stream_blocked
+    atomic<bool> ops_blocked;
+    uint16_t mtu, requested_mtu;
+    // cleared for the rest of the link once the remote device rejects Read Multiple Variable
+    bool read_multi_var;
+
+    enum class SetupStage {
+        MTU,
+        DATABASE_HASH,
+        DISCOVERY
+    };
 
-    WarbleGattChar_Blepp* active_char;
-    void* write_context;
-    FnVoid_VoidP_WarbleGattCharP_CharP write_handler;
-
-    BLEGATTStateMachine gatt;
-    unordered_map<string, WarbleGattChar_Blepp*> characteristics;
-    unordered_set<string> services;
+    GattDiscovery discovery;
+    SetupStage setup_stage;
+    string setup_error;
+    vector<uint8_t> db_hash;
+    uint16_t service_changed_handle;
+    // HCI connection handle of the link, labels the PDUs in capture files
+    uint16_t hci_handle;
+    // attribute table came from the on-disk cache rather than discovery, cache_outdated is set if more services were walked on top of it
+    bool att_owned, discovering, from_cache, cache_outdated;
+
+    unique_ptr<BleppLink> link;
+    // guards the attribute table against lookups from user threads while the io thread adds to it
+    mutable mutex attr_mutex;
+    // one on-demand walk at a time
+    mutex on_demand_mutex;
+    vector<GattServiceInfo> service_infos;
+    // sorted by uuid, lookups parse the caller's string straight into binary and binary search
+    vector<pair<Uuid128, WarbleGattChar_Blepp*>> characteristics;
+    // objects from earlier connections not matched to the current table, kept alive as callers may hold them
+    vector<pair<Uuid128, WarbleGattChar_Blepp*>> retired;
+    unordered_map<uint16_t, WarbleGattChar_Blepp*> value_handles;
+    vector<Uuid128> services;
+
+    ReconnectPolicy reconnect_policy;
+    // reconnect_pending, reconnect_cancelled and reconnect_stats are guarded by session_mutex
+    bool reconnect_pending, reconnect_cancelled, reconnecting;
+    uint32_t reconnect_attempt;
+    // update_conn_params requests still waiting on the controller, guarded by session_mutex
+    uint32_t param_updates;
+    // the object is registered with the reactor only to wait out the reconnect delay, there is no socket
+    atomic<bool> reconnect_timer;
+    steady_clock::time_point link_lost;
+    WarbleReconnectStats reconnect_stats;
 
     thread blepp_state_machine;
-    bool public_addr, connected, local_dc;
+    mutable mutex session_mutex;
+    condition_variable session_ended;
+    thread::id io_thread;
+    // reconnect_at is when the next auto-reconnect attempt starts in the manual and reactor modes, guarded by session_mutex
+    steady_clock::time_point connect_deadline, reconnect_at;
+    int sock, dc_code;
+    bool public_addr, connected, local_dc, terminate, awaiting_connect, session_active, use_reactor, manual_io;
 };
 
 struct WarbleGattChar_Blepp : public WarbleGattChar {
-    WarbleGattChar_Blepp(WarbleGatt_Blepp* owner, BLEPP::Characteristic& ble_char);
+    WarbleGattChar_Blepp(WarbleGatt_Blepp* owner, const GattCharacteristicInfo& info);
 
     virtual ~WarbleGattChar_Blepp();
 
     virtual void write_async(const std::uint8_t* value, std::uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void write_without_resp_async(const std::uint8_t* value, std::uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+    virtual void write_long_async(const std::uint8_t* value, std::uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+    virtual int32_t stream_write(const std::uint8_t* value, std::uint16_t len);
 
     virtual void read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler);
+    virtual void read_long_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler);
 
     virtual void enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void disable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler);
+    virtual void on_notification_received_long(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler);
+    virtual int32_t drain_notifications(WarbleGattNotification* buf, int32_t max);
+    virtual uint32_t get_dropped_notifications() const;
+    virtual void on_notification_received_ex(void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler);
+    virtual void set_sequence_tracking(const WarbleGattSequenceConfig* config);
+    virtual void get_sequence_stats(WarbleGattSequenceStats* stats) const;
 
     virtual const char* get_uuid() const;
     virtual WarbleGatt* get_gatt() const;
 private:
     friend WarbleGatt_Blepp;
+
+    // timestamp is in nanoseconds since the Unix epoch
+    void notify(const uint8_t* value, size_t len, uint64_t timestamp);
+    // Returns how many counter values were skipped before the notification, only called from the io thread
+    uint32_t check_sequence(const uint8_t* value, size_t len);
+    // Points the object at a characteristic from a new connection, or detaches it from the link if info is null
+    void rebind(const GattCharacteristicInfo* info);
+
+    GattOp new_op(GattOp::Type type, uint16_t handle, const char* error_prefix, void* context);
+    GattOp read_op(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler);
+    GattOp read_long_op(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler);
+    GattOp write_op(GattOp::Type type, const uint8_t* value, size_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+    // Returns false and calls the handler with an error if the value is longer than an attribute can hold
+    bool write_long_op(const uint8_t* value, size_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler, GattOp& op);
+    // Returns false and calls the handler with an error if the characteristic has no CCCD
+    bool cccd_op(uint16_t value, const char* error_prefix, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler, GattOp& op);
+    void write_cccd_async(uint16_t value, const char* error_prefix, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     
     WarbleGatt_Blepp* owner;
-    Characteristic& ble_char;
+    uint16_t value_handle, cccd_handle;
+    // last value written to the CCCD, restored after auto-reconnect
+    uint16_t cccd_value;
     char uuid_str[37];
 
-    void *read_context, *value_changed_context;
-    FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP read_handler;
+    void *value_changed_context;
     FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte value_changed_handler;
-
-    function<void(const char*)> gatt_op_error_handler;
+    FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort value_changed_long_handler;
+    FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP value_changed_ex_handler;
+    unique_ptr<NotificationRing> notifications;
+
+    // offset in the low 16 bits, then size and the big endian flag, so the io thread picks up changes with one load
+    atomic<uint32_t> sequence_config;
+    // io thread's copy of the config the last counter was read with
+    uint32_t sequence_applied, last_sequence;
+    bool has_sequence;
+    atomic<uint32_t> sequence_gaps, sequence_missing, sequence_out_of_order;
 };
 
+// Object whose update_conn_params handler the current thread is running
+static thread_local const WarbleGatt_Blepp* updating_params = nullptr;
+
+// Receive time the kernel attached to a message, falls back to the current time if the socket did not supply one
+static uint64_t receive_timestamp(msghdr& msg) {
+    for(auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+        }
+    }
+    return static_cast<uint64_t>(duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+// Converts to controller units, returns false if a value is outside what the Bluetooth spec allows
+static bool to_hci_params(const WarbleGattConnParams& params, HciConnParams& raw) {
+    if (!(params.min_interval >= 7.5f && params.min_interval <= params.max_interval && params.max_interval <= 4000.f) || 
+            params.latency > 499 || params.supervision_timeout < 100 || params.supervision_timeout > 32000) {
+        return false;
+    }
+
+    raw.min_interval = static_cast<uint16_t>(lround(params.min_interval / 1.25f));
+    raw.max_interval = static_cast<uint16_t>(lround(params.max_interval / 1.25f));
+    raw.latency = params.latency;
+    raw.supervision_timeout = static_cast<uint16_t>(params.supervision_timeout / 10);
+    // the timeout has to outlast twice the longest gap the remote device may leave between packets
+    return 4u * raw.supervision_timeout > (1u + raw.latency) * raw.max_interval;
+}
+
 WarbleGatt* warblegatt_create(std::int32_t nopts, const WarbleOption* opts) {
     const char *mac = nullptr, *hci_mac = "";
     bool public_addr = false;
+    uint16_t requested_mtu = att::DEFAULT_LE_MTU;
+    size_t notification_capacity = 0;
+    auto notification_overflow = NotificationRing::DROP_NEWEST;
+    auto discovery_mode = WarbleGatt_Blepp::DiscoveryMode::ALL;
+    vector<Uuid128> discovery_filter;
+    WarbleGatt_Blepp::ReconnectPolicy reconnect_policy = { false, milliseconds(250), milliseconds(30000), 0 };
+    size_t stream_window = 32;
+    WarbleGattConnParams conn_params = { 0.f, 0.f, 0, 0 };
+    bool set_conn_params = false;
+    WarbleGatt_Blepp::ConnectPolicy connect_policy = { milliseconds(10000), false, 0, 0 };
+    float scan_interval = 0.f, scan_window = 0.f;
     unordered_map<string, function<void(const char*)>> arg_processors = {
         {"mac", [&mac](const char* value) { mac = value; }}, 
         {"hci", [&hci_mac](const char* value) { hci_mac = value; }},
@@ -101,6 +490,153 @@ WarbleGatt* warblegatt_create(std::int32_t nopts, const WarbleOption* opts) {
                 throw runtime_error("invalid value for \'address-type\' option (blepp api): one of [public, random]");
             }
         }},
+        {"mtu", [&requested_mtu](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < att::DEFAULT_LE_MTU || parsed > static_cast<long>(att::MAX_PDU_LEN)) {
+                throw runtime_error("invalid value for \'mtu\' option (blepp api): must be between 23 and 517");
+            }
+            requested_mtu = static_cast<uint16_t>(parsed);
+        }},
+        {"notification-buffer", [&notification_capacity](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0 || parsed > 65536) {
+                throw runtime_error("invalid value for \'notification-buffer\' option (blepp api): must be between 1 and 65536");
+            }
+            notification_capacity = static_cast<size_t>(parsed);
+        }},
+        {"notification-overflow", [&notification_overflow](const char* value) {
+            if (!strcmp(value, "drop-newest")) {
+                notification_overflow = NotificationRing::DROP_NEWEST;
+            } else if (!strcmp(value, "drop-oldest")) {
+                notification_overflow = NotificationRing::DROP_OLDEST;
+            } else {
+                throw runtime_error("invalid value for \'notification-overflow\' option (blepp api): one of [drop-newest, drop-oldest]");
+            }
+        }},
+        {"stream-window", [&stream_window](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0 || parsed > 65536) {
+                throw runtime_error("invalid value for \'stream-window\' option (blepp api): must be between 1 and 65536");
+            }
+            stream_window = static_cast<size_t>(parsed);
+        }},
+        {"discover-services", [&discovery_mode, &discovery_filter](const char* value) {
+            discovery_filter.clear();
+            if (!strcmp(value, "all")) {
+                discovery_mode = WarbleGatt_Blepp::DiscoveryMode::ALL;
+            } else if (!strcmp(value, "on-demand")) {
+                discovery_mode = WarbleGatt_Blepp::DiscoveryMode::ON_DEMAND;
+            } else {
+                // comma separated service uuids
+                stringstream stream(value);
+                string item;
+                while(getline(stream, item, ',')) {
+                    Uuid128 uuid;
+                    if (!Uuid128::parse(item.c_str(), uuid)) {
+                        throw runtime_error("invalid value for \'discover-services\' option (blepp api): one of [all, on-demand] or a comma separated list of service uuids");
+                    }
+                    discovery_filter.push_back(uuid);
+                }
+                if (discovery_filter.empty()) {
+                    throw runtime_error("invalid value for \'discover-services\' option (blepp api): one of [all, on-demand] or a comma separated list of service uuids");
+                }
+
+                sort(discovery_filter.begin(), discovery_filter.end());
+                discovery_mode = WarbleGatt_Blepp::DiscoveryMode::FILTERED;
+            }
+        }},
+        {"auto-reconnect", [&reconnect_policy](const char* value) {
+            if (!strcmp(value, "true")) {
+                reconnect_policy.enabled = true;
+            } else if (!strcmp(value, "false")) {
+                reconnect_policy.enabled = false;
+            } else {
+                throw runtime_error("invalid value for \'auto-reconnect\' option (blepp api): one of [true, false]");
+            }
+        }},
+        {"reconnect-delay", [&reconnect_policy](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'reconnect-delay\' option (blepp api): must be a positive number of milliseconds");
+            }
+            reconnect_policy.initial_delay = milliseconds(parsed);
+        }},
+        {"reconnect-max-delay", [&reconnect_policy](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'reconnect-max-delay\' option (blepp api): must be a positive number of milliseconds");
+            }
+            reconnect_policy.max_delay = milliseconds(parsed);
+        }},
+        {"reconnect-attempts", [&reconnect_policy](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < 0) {
+                throw runtime_error("invalid value for \'reconnect-attempts\' option (blepp api): must be a non-negative integer");
+            }
+            reconnect_policy.max_attempts = static_cast<uint32_t>(parsed);
+        }},
+        {"conn-interval-min", [&conn_params, &set_conn_params](const char* value) {
+            char* end;
+            conn_params.min_interval = strtof(value, &end);
+            if (*value == '\0' || *end != '\0') {
+                throw runtime_error("invalid value for \'conn-interval-min\' option (blepp api): must be a number of milliseconds");
+            }
+            set_conn_params = true;
+        }},
+        {"conn-interval-max", [&conn_params, &set_conn_params](const char* value) {
+            char* end;
+            conn_params.max_interval = strtof(value, &end);
+            if (*value == '\0' || *end != '\0') {
+                throw runtime_error("invalid value for \'conn-interval-max\' option (blepp api): must be a number of milliseconds");
+            }
+            set_conn_params = true;
+        }},
+        {"conn-latency", [&conn_params, &set_conn_params](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < 0 || parsed > 499) {
+                throw runtime_error("invalid value for \'conn-latency\' option (blepp api): must be between 0 and 499");
+            }
+            conn_params.latency = static_cast<uint16_t>(parsed);
+            set_conn_params = true;
+        }},
+        {"supervision-timeout", [&conn_params, &set_conn_params](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < 100 || parsed > 32000) {
+                throw runtime_error("invalid value for \'supervision-timeout\' option (blepp api): must be between 100 and 32000 milliseconds");
+            }
+            conn_params.supervision_timeout = static_cast<uint16_t>(parsed);
+            set_conn_params = true;
+        }},
+        {"connect-timeout", [&connect_policy](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'connect-timeout\' option (blepp api): must be a positive number of milliseconds");
+            }
+            connect_policy.timeout = milliseconds(parsed);
+        }},
+        {"connect-scan-interval", [&scan_interval](const char* value) {
+            char* end;
+            scan_interval = strtof(value, &end);
+            if (*value == '\0' || *end != '\0' || !(scan_interval >= 2.5f && scan_interval <= 10240.f)) {
+                throw runtime_error("invalid value for \'connect-scan-interval\' option (blepp api): must be between 2.5 and 10240 milliseconds");
+            }
+        }},
+        {"connect-scan-window", [&scan_window](const char* value) {
+            char* end;
+            scan_window = strtof(value, &end);
+            if (*value == '\0' || *end != '\0' || !(scan_window >= 2.5f && scan_window <= 10240.f)) {
+                throw runtime_error("invalid value for \'connect-scan-window\' option (blepp api): must be between 2.5 and 10240 milliseconds");
+            }
+        }},
     };
 
     for(int i = 0; i < nopts; i++) {
@@ -113,31 +649,133 @@ WarbleGatt* warblegatt_create(std::int32_t nopts, const WarbleOption* opts) {
     if (mac == nullptr) {
         throw runtime_error("required option 'mac' was not set");
     }
+    if (discovery_mode == WarbleGatt_Blepp::DiscoveryMode::ON_DEMAND && blepp_io_mode() == BleppIoMode::MANUAL) {
+        // lookups come from the thread running the connection and could never wait for the walk to finish
+        throw runtime_error("invalid value for \'discover-services\' option (blepp api): on-demand cannot be used with the manual io-mode");
+    }
+
+    HciConnParams raw_conn_params;
+    if (set_conn_params) {
+        // a single interval bound pins the interval, the timeout defaults to 4s or whatever the other values need
+        if (conn_params.min_interval == 0.f) {
+            conn_params.min_interval = conn_params.max_interval;
+        } else if (conn_params.max_interval == 0.f) {
+            conn_params.max_interval = conn_params.min_interval;
+        }
+        if (conn_params.supervision_timeout == 0) {
+            float needed = (1 + conn_params.latency) * conn_params.max_interval * 2 + 10;
+            conn_params.supervision_timeout = static_cast<uint16_t>(min(32000.f, max(4000.f, needed)));
+        }
+
+        if (!to_hci_params(conn_params, raw_conn_params)) {
+            throw runtime_error("invalid connection parameter options (blepp api): intervals must be between 7.5 and 4000 milliseconds, "
+                    "and the supervision timeout longer than 2 * (1 + latency) * max interval");
+        }
+    }
+
+    if (scan_interval != 0.f || scan_window != 0.f) {
+        // whichever value is missing falls back to the kernel's 60ms default, the window can never outlast the interval
+        if (scan_interval == 0.f) {
+            scan_interval = max(60.f, scan_window);
+        } else if (scan_window == 0.f) {
+            scan_window = min(60.f, scan_interval);
+        }
+        if (scan_window > scan_interval) {
+            throw runtime_error("invalid connect scan options (blepp api): the scan window cannot be longer than the scan interval");
+        }
+
+        connect_policy.set_scan = true;
+        connect_policy.scan_interval = static_cast<uint16_t>(lround(scan_interval / 0.625f));
+        connect_policy.scan_window = static_cast<uint16_t>(lround(scan_window / 0.625f));
+    }
 
-    return new WarbleGatt_Blepp(mac, hci_mac, public_addr);
+    return new WarbleGatt_Blepp(mac, hci_mac, public_addr, requested_mtu, notification_capacity, notification_overflow, discovery_mode, 
+            move(discovery_filter), reconnect_policy, set_conn_params ? &raw_conn_params : nullptr, connect_policy, stream_window);
 }
 
-WarbleGatt_Blepp::WarbleGatt_Blepp(const char* mac, const char* hci_mac, bool public_addr) : 
-        mac(mac), hci_mac(hci_mac), on_disconnect_context(nullptr), on_disconnect_handler(nullptr), active_char(nullptr), public_addr(public_addr), connected(false), local_dc(false) {
-    gatt.cb_connected = [this]() {
+WarbleGatt_Blepp::WarbleGatt_Blepp(const char* mac, const char* hci_mac, bool public_addr, uint16_t requested_mtu, 
+        size_t notification_capacity, NotificationRing::Overflow notification_overflow, DiscoveryMode discovery_mode, 
+        vector<Uuid128> discovery_filter, const ReconnectPolicy& reconnect_policy, const HciConnParams* conn_params, 
+        const ConnectPolicy& connect_policy, size_t stream_window) : 
+        mac(mac), hci_mac(hci_mac), hci_balanced(false), notification_capacity(notification_capacity), notification_overflow(notification_overflow), discovery_mode(discovery_mode), 
+        discovery_filter(move(discovery_filter)), on_disconnect_context(nullptr), connect_context(nullptr), on_disconnect_handler(nullptr), connect_handler(nullptr), 
+        connect_policy(connect_policy), connect_pending(false), connect_cancelled(false), request_conn_params(conn_params != nullptr), conn_params(), 
+        stream_window(stream_window), stream_bytes(0), stream_full(false), stream_blocked(false), stream_ready_context(nullptr), stream_ready_handler(nullptr), op_in_flight(false), att_ready(false), ops_blocked(false), mtu(att::DEFAULT_LE_MTU), requested_mtu(requested_mtu), read_multi_var(true), setup_stage(SetupStage::MTU), service_changed_handle(0), hci_handle(0), att_owned(false), discovering(false), from_cache(false), 
+        cache_outdated(false), reconnect_policy(reconnect_policy), reconnect_pending(false), reconnect_cancelled(false), reconnecting(false), 
+        reconnect_attempt(0), param_updates(0), reconnect_timer(false), reconnect_stats(), sock(-1), dc_code(0), public_addr(public_addr), connected(false), local_dc(false), terminate(false), awaiting_connect(false), 
+        session_active(false), use_reactor(false), manual_io(false) {
+    if (conn_params != nullptr) {
+        this->conn_params = *conn_params;
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (!strcmp(hci_mac, "auto")) {
+        hci_balanced = true;
+    } else if (strchr(hci_mac, ',') != nullptr) {
+        stringstream stream(hci_mac);
+        string item;
+
+        hci_balanced = true;
+        while(getline(stream, item, ',')) {
+            if (!item.empty()) {
+                hci_candidates.push_back(item);
+            }
+        }
+    }
+
+    // a replay set through warble_lib_init stands in for the adapter from creation on
+    link = blepp_transport::create_link();
+    // libblepp only brings up the L2CAP link, warble drives the ATT bearer from there so the MTU can be 
+    // exchanged before discovery responses grow past the default size
+    link->on_connected = [this]() {
         connected = true;
-        gatt.read_primary_services();
-    };
-    gatt.cb_find_characteristics = [this]() {
-        gatt.get_client_characteristic_configuration();
-    };
-    gatt.cb_services_read = [this]() {
-        gatt.find_all_characteristics();
-    };
-    gatt.cb_write_response = [this]() {
-        active_char->gatt_op_error_handler = nullptr;
-        active_char = nullptr;
-        write_handler(write_context, active_char, nullptr);
+        begin_setup();
     };
 }
 
 WarbleGatt_Blepp::~WarbleGatt_Blepp() {
-    gatt.close();
+    if (manual_io) {
+        // no loop will call process again for this object, wind the session down here
+        bool active, pending;
+        {
+            lock_guard<mutex> lock(session_mutex);
+            active = session_active;
+            pending = reconnect_pending;
+        }
+        if (active || pending) {
+            disconnect();
+        }
+        if (active) {
+            handle_events(false, false);
+        }
+        if (pending && !active) {
+            attempt_reconnect();
+        }
+    }
+    {
+        unique_lock<mutex> lock(session_mutex);
+        if ((session_active || reconnect_pending) && this_thread::get_id() != io_thread) {
+            lock.unlock();
+            disconnect();
+            lock.lock();
+
+            session_ended.wait(lock, [this]() { return !session_active && !reconnect_pending; });
+        }
+
+        // deleted from an update_conn_params handler, the request thread sees the cleared pointer and leaves the object alone
+        uint32_t remaining = 0;
+        if (updating_params == this) {
+            updating_params = nullptr;
+            remaining = 1;
+        }
+        session_ended.wait(lock, [this, remaining]() { return param_updates == remaining; });
+    }
+    if (use_reactor) {
+        blepp_reactor::remove(this);
+    }
+
+    link->close();
+    close(wake_fd);
 
     clear_characteristics();
 }
@@ -146,259 +784,1959 @@ void WarbleGatt_Blepp::clear_characteristics() {
     for(auto it: characteristics) {
         delete it.second;
     }
+    for(auto it: retired) {
+        delete it.second;
+    }
     characteristics.clear();
+    retired.clear();
+    value_handles.clear();
 }
 
 void WarbleGatt_Blepp::connect_async(void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
-    thread th([this, context, handler]() {
-        local_dc = false;
+    connect_context = context;
+    connect_handler = handler;
+    connect_started = steady_clock::now();
+    {
+        lock_guard<mutex> lock(session_mutex);
+        connect_pending = true;
+        connect_cancelled = false;
+    }
 
-        bool terminate = false;
-        int dc_code;
+    auto mode = blepp_io_mode();
+    manual_io = mode == BleppIoMode::MANUAL;
+    use_reactor = mode == BleppIoMode::REACTOR;
 
-        gatt.cb_disconnected = [this, &terminate, &dc_code](BLEGATTStateMachine::Disconnect d) {
-            if (active_char != nullptr && active_char->gatt_op_error_handler != nullptr) {
-                active_char->gatt_op_error_handler(BLEGATTStateMachine::get_disconnect_string(d));
+    if (use_reactor) {
+        if (start_session()) {
+            blepp_reactor::add(this);
+        }
+    } else if (manual_io) {
+        // the application's loop picks the socket up through get_fd
+        start_session();
+    } else {
+        thread th([this]() {
+            if (!start_session()) {
+                return;
             }
 
-            dc_code = d.error_code;
-            terminate = true;
-        };
-        gatt.cb_get_client_characteristic_configuration = [this, context, handler]() {
-            services.clear();
-            clear_characteristics();
+            bool active;
+            do {
+                pollfd fds[2] = {
+                    { sock, static_cast<short>(POLLIN | (io_wants_write() ? POLLOUT : 0)), 0 },
+                    { wake_fd, POLLIN, 0 }
+                };
+                int timeout = -1;
+
+                if (awaiting_connect) {
+                    auto remaining = duration_cast<milliseconds>(connect_deadline - steady_clock::now()).count();
+                    timeout = remaining < 0 ? 0 : static_cast<int>(remaining);
+                }
 
-            for(auto& service: gatt.primary_services) {
-                services.insert(uuid_to_string(service.uuid));
-    	        for(auto& characteristic: service.characteristics) {
-                    characteristics.emplace(uuid_to_string(characteristic.uuid), new WarbleGattChar_Blepp(this, characteristic));
+                int status = poll(fds, 2, timeout);
+                if (status > 0 && (fds[1].revents & POLLIN)) {
+                    uint64_t value;
+                    while(read(wake_fd, &value, sizeof(value)) > 0) {
+                    }
                 }
-            }
 
-            handler(context, this, nullptr);
-        };
+                if (status == 0) {
+                    active = handle_timeout();
+                } else if (status < 0) {
+                    active = errno == EINTR ? true : handle_failure();
+                } else if (fds[0].revents) {
+                    active = handle_events(fds[0].revents & (POLLIN | POLLERR | POLLHUP), fds[0].revents & (POLLOUT | POLLERR | POLLHUP));
+                } else {
+                    // woken to recompute the events to wait on
+                    active = true;
+                }
+            } while(active);
+        });
+        th.detach();
+        swap(blepp_state_machine, th);
+    }
+}
 
-        auto socket_select = [this, &terminate](timeval* timeout) {
-            fd_set write_set, read_set;
-            FD_ZERO(&read_set);
-            FD_ZERO(&write_set);
+bool WarbleGatt_Blepp::start_session() {
+    local_dc = false;
+    terminate = false;
 
-            FD_SET(gatt.socket(), &read_set);
-            if(gatt.wait_on_write()) {
-                FD_SET(gatt.socket(), &write_set);
-            }
+    att_owned = false;
+    discovering = false;
 
-            int status = select(gatt.socket() + 1, &read_set, &write_set, nullptr, timeout);
-            if (!local_dc && !terminate && status > 0) {
-                if(FD_ISSET(gatt.socket(), &write_set)) {
-                    gatt.write_and_process_next();
-                }
+    link->on_disconnected = [this](int error_code) {
+        dc_code = error_code;
+        terminate = true;
+    };
 
-                if(FD_ISSET(gatt.socket(), &read_set)) {
-                    gatt.read_and_process_next();
-                }
-            }
+    string device;
+    if (!link->on_adapter()) {
+        session_hci.clear();
+    } else if (hci_balanced) {
+        device = session_hci = next_hci.empty() ? hci_pool::acquire(hci_candidates) : hci_pool::retain(next_hci);
+        next_hci.clear();
+        if (device.empty()) {
+            end_connect_attempt(false);
+            connect_handler(connect_context, this, WARBLE_NO_FREE_ADAPTER);
+            return false;
+        }
+    } else {
+        device = hci_mac;
+        session_hci = hci_pool::retain(hci_mac);
+    }
 
-            return status;
-        };
+    if (connect_policy.set_scan && link->on_adapter()) {
+        // adapter wide, an unprivileged process keeps the kernel's values and connects regardless
+        hci_link::set_connect_scan(device, connect_policy.scan_interval, connect_policy.scan_window);
+    }
 
-        gatt.connect(mac, false, public_addr, hci_mac);
-        timeval timeout = { 10, 0 };
-        int status = socket_select(&timeout);
-        if (status <= 0) {
-            gatt.close();
-            handler(context, this, status == 0 ? WARBLE_CONNECT_TIMEOUT : WARBLE_GATT_ERROR);
-        } else {
-            while(!local_dc && !terminate && socket_select(nullptr) > 0) {
-            }
-            
-            if (!local_dc) {
-                gatt.cb_disconnected = [](BLEGATTStateMachine::Disconnect d) { };
-            }
-            gatt.close();
+    try {
+        link->connect(mac, public_addr, device);
+    } catch (const std::exception& e) {
+        link->close();
+        hci_pool::release(session_hci);
+        end_connect_attempt(false);
+        connect_handler(connect_context, this, e.what());
+        return false;
+    }
 
-            connected = false;
-            if (on_disconnect_handler != nullptr) {
-                on_disconnect_handler(on_disconnect_context, this, dc_code);
-            }
-        }
-    });
-    th.detach();
-    swap(blepp_state_machine, th);
+    sock = link->socket();
+    connect_deadline = steady_clock::now() + connect_policy.timeout;
+    awaiting_connect = true;
+
+    lock_guard<mutex> lock(session_mutex);
+    session_active = true;
+    // cancel_connect came in before there was a socket to shut down, the io thread reports it on its first wakeup
+    if (connect_cancelled) {
+        shutdown(sock, SHUT_RDWR);
+    }
+    return true;
 }
 
-void WarbleGatt_Blepp::disconnect() {
-    local_dc = true;
-    shutdown(gatt.socket(), SHUT_RDWR);
+void WarbleGatt_Blepp::close_session() {
+    if (use_reactor) {
+        blepp_reactor::remove(this);
+    }
+    link->close();
 }
 
-void WarbleGatt_Blepp::on_disconnect(void* context, FnVoid_VoidP_WarbleGattP_Int handler) {
-    on_disconnect_context = context;
-    on_disconnect_handler = handler;
+void WarbleGatt_Blepp::release_session() {
+    hci_pool::release(session_hci);
+
+    lock_guard<mutex> lock(session_mutex);
+    session_active = false;
+    session_ended.notify_all();
 }
 
-bool WarbleGatt_Blepp::is_connected() const {
-    return connected;
+void WarbleGatt_Blepp::begin_setup() {
+    {
+        lock_guard<mutex> lock(op_mutex);
+        mtu = att::DEFAULT_LE_MTU;
+        read_multi_var = true;
+    }
+
+    // from here on, every PDU on the socket is read and written by warble rather than libblepp
+    att_owned = true;
+    // notifications carry the time the kernel took the packet off the adapter rather than when the io thread got to it
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+    int handle = hci_link::connection_handle(sock);
+    hci_handle = handle < 0 ? 0 : static_cast<uint16_t>(handle);
+    // lets a capture file map the handle back to the device, replays match links by mac with it
+    btsnoop::connection(hci_handle, mac, public_addr);
+    if (request_conn_params && link->on_adapter() && handle >= 0) {
+        // a rejected request leaves the controller's choice in place, the link is still usable
+        hci_link::send_params(session_hci, hci_handle, conn_params);
+    }
+    discovering = true;
+    setup_started = steady_clock::now();
+    last_notification = steady_clock::time_point();
+    from_cache = false;
+    cache_outdated = false;
+    service_changed_handle = 0;
+    db_hash.clear();
+    setup_error.clear();
+
+    if (requested_mtu > att::DEFAULT_LE_MTU) {
+        uint8_t pdu[3];
+
+        setup_stage = SetupStage::MTU;
+        if (!att_send(pdu, att::encode_mtu(pdu, att::MTU_REQ, requested_mtu))) {
+            setup_failed(strerror(errno));
+        }
+    } else {
+        check_cache();
+    }
 }
 
-WarbleGattChar* WarbleGatt_Blepp::find_characteristic(const std::string& uuid) const {
-    auto it = characteristics.find(uuid);
-    return it == characteristics.end() ? nullptr : it->second;
+void WarbleGatt_Blepp::check_cache() {
+    if (!gatt_cache::enabled()) {
+        start_discovery();
+        return;
+    }
+
+    // a cached table is only trusted if the Database Hash, or its absence, matches what was cached
+    uint8_t pdu[7];
+
+    setup_stage = SetupStage::DATABASE_HASH;
+    if (!att_send(pdu, att::encode_read_by_type_req(pdu, 0x0001, 0xffff, att::DATABASE_HASH_UUID))) {
+        setup_failed(strerror(errno));
+    }
 }
 
-bool WarbleGatt_Blepp::service_exists(const std::string& uuid) const {
-    return services.count(uuid);
+bool WarbleGatt_Blepp::walk_at_connect(const Uuid128& uuid) const {
+    // Generic Attribute holds Service Changed, which keeps a cached table honest
+    static const Uuid128 GENERIC_ATTRIBUTE = { 0x0000180100001000ULL, 0x800000805f9b34fbULL };
+
+    switch(discovery_mode) {
+    case DiscoveryMode::FILTERED:
+        return binary_search(discovery_filter.begin(), discovery_filter.end(), uuid) || (gatt_cache::enabled() && uuid == GENERIC_ATTRIBUTE);
+    case DiscoveryMode::ON_DEMAND:
+        return gatt_cache::enabled() && uuid == GENERIC_ATTRIBUTE;
+    default:
+        return true;
+    }
 }
 
-WarbleGattChar_Blepp::WarbleGattChar_Blepp(WarbleGatt_Blepp* owner, BLEPP::Characteristic& ble_char) : owner(owner), ble_char(ble_char) {
-    ble_char.cb_read = [this](const PDUReadResponse& r) {
-        this->owner->active_char->gatt_op_error_handler = nullptr;
-        this->owner->active_char = nullptr;
-        read_handler(read_context, this, r.value().first, r.value().second - r.value().first, nullptr);
-    };
-    ble_char.cb_notify_or_indicate = [this](const PDUNotificationOrIndication& n) {
-        value_changed_handler(value_changed_context, this, n.value().first, n.value().second - n.value().first);
-    };
+void WarbleGatt_Blepp::start_discovery() {
+    setup_stage = SetupStage::DISCOVERY;
+    discovery = GattDiscovery([this](const Uuid128& uuid) { return walk_at_connect(uuid); });
+    continue_discovery();
+}
 
-    string str = uuid_to_string(ble_char.uuid);
-    strcpy(uuid_str, str.c_str());
+void WarbleGatt_Blepp::resume_discovery(vector<GattServiceInfo> known) {
+    vector<size_t> pending;
+    for(size_t i = 0; i < known.size(); i++) {
+        if (!known[i].discovered && walk_at_connect(known[i].uuid)) {
+            pending.push_back(i);
+        }
+    }
+    cache_outdated = !pending.empty();
+
+    setup_stage = SetupStage::DISCOVERY;
+    discovery = GattDiscovery(move(known), move(pending));
+    continue_discovery();
 }
 
-WarbleGattChar_Blepp::~WarbleGattChar_Blepp() {
+void WarbleGatt_Blepp::continue_discovery() {
+    uint8_t pdu[att::MAX_PDU_LEN];
+    size_t len = discovery.next_request(pdu);
 
+    if (len == 0) {
+        finish_setup();
+    } else if (!att_send(pdu, len)) {
+        setup_failed(strerror(errno));
+    }
 }
 
-void WarbleGattChar_Blepp::write_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
-    try {
-        gatt_op_error_handler = [this, context, handler](const char* msg) {
-            owner->active_char = nullptr;
+void WarbleGatt_Blepp::process_setup_response(const uint8_t* pdu, size_t len) {
+    switch(setup_stage) {
+    case SetupStage::MTU:
+        // an error response means the remote device does not support the exchange, stay at the default
+        if (pdu[0] == att::MTU_RSP && len >= 3) {
+            lock_guard<mutex> lock(op_mutex);
+            mtu = max(att::DEFAULT_LE_MTU, min(requested_mtu, att::get_le16(pdu + 1)));
+        }
+        check_cache();
+        break;
+    case SetupStage::DATABASE_HASH: {
+        // opcode, entry length, handle, 128-bit hash
+        if (pdu[0] == att::READ_BY_TYPE_RSP && len >= 20 && pdu[1] == 18) {
+            db_hash.assign(pdu + 4, pdu + 20);
+        }
 
-            if (msg != nullptr) {
-                stringstream error_stream;
-                string full_msg;
+        GattCacheEntry entry;
+        if (gatt_cache::load(mac, entry) && entry.db_hash == db_hash) {
+            from_cache = true;
+            resume_discovery(move(entry.services));
+        } else {
+            start_discovery();
+        }
+        break;
+    }
+    case SetupStage::DISCOVERY:
+        if (!discovery.process_response(pdu, len)) {
+            setup_failed(discovery.error.c_str());
+        } else {
+            continue_discovery();
+        }
+        break;
+    }
+}
 
-                error_stream << WARBLE_GATT_WRITE_ERROR << "(" << msg << ")";
-                full_msg = error_stream.str();
-                handler(context, this, full_msg.c_str());
-            } else {
-                handler(context, this, msg);
-            }            
-        };
-        
-        owner->active_char = this;
-        owner->write_context = context;
-        owner->write_handler = handler;
-        
-        ble_char.write_request(value, len);
-    } catch (const std::exception& e) {
-        gatt_op_error_handler(e.what());
-    } catch (const BLEDevice::WriteError&) {
-        gatt_op_error_handler(nullptr);
+void WarbleGatt_Blepp::setup_failed(const char* error) {
+    setup_error = error;
+    terminate = true;
+}
+
+void WarbleGatt_Blepp::finish_setup() {
+    uint8_t raw_uuid[2];
+    att::put_le16(raw_uuid, att::SERVICE_CHANGED_UUID);
+    const auto service_changed_uuid = Uuid128::from_att(raw_uuid, sizeof(raw_uuid));
+    WarbleGattChar_Blepp* service_changed_char = nullptr;
+    {
+        lock_guard<mutex> lock(attr_mutex);
+        services.clear();
+        service_infos = move(discovery.services);
+
+        // objects from the last connection are matched back to the new table so pointers callers hold stay valid
+        for(auto& it: characteristics) {
+            it.second->rebind(nullptr);
+        }
+        retired.insert(retired.end(), characteristics.begin(), characteristics.end());
+        stable_sort(retired.begin(), retired.end(), [](const pair<Uuid128, WarbleGattChar_Blepp*>& a, const pair<Uuid128, WarbleGattChar_Blepp*>& b) {
+            return a.first < b.first;
+        });
+        characteristics.clear();
+        value_handles.clear();
+
+        for(auto& service: service_infos) {
+            services.push_back(service.uuid);
+            for(auto& info: service.characteristics) {
+                auto gatt_char = bind_characteristic(info);
+                characteristics.emplace_back(info.uuid, gatt_char);
+                value_handles.emplace(gatt_char->value_handle, gatt_char);
+
+                if (info.uuid == service_changed_uuid) {
+                    service_changed_handle = info.value_handle;
+                    service_changed_char = gatt_char;
+                }
+            }
+        }
+
+        // stable so a uuid that appears in several services resolves to the first one discovered
+        sort(services.begin(), services.end());
+        stable_sort(characteristics.begin(), characteristics.end(), [](const pair<Uuid128, WarbleGattChar_Blepp*>& a, const pair<Uuid128, WarbleGattChar_Blepp*>& b) {
+            return a.first < b.first;
+        });
+    }
+
+    // only the io thread changes service_infos, no need to hold the lock to read it
+    if ((!from_cache || cache_outdated) && gatt_cache::enabled()) {
+        gatt_cache::store(mac, { db_hash, service_infos });
+    }
+
+    {
+        lock_guard<mutex> lock(op_mutex);
+        att_ready = true;
     }
+    discovering = false;
+
+    // cached tables go stale when the remote device changes its attributes, ask to be told when that happens
+    bool track_service_changed = gatt_cache::enabled() && service_changed_char != nullptr && service_changed_char->cccd_handle != 0;
+    if (track_service_changed) {
+        service_changed_char->write_cccd_async(att::CCCD_INDICATE, WARBLE_GATT_ENABLE_NOTIFY_ERROR, nullptr, 
+                [](void* context, WarbleGattChar* caller, const char* value) { });
+    }
+    // CCCDs are reset when the link drops unless the devices are bonded, queue them ahead of anything the caller sends
+    if (reconnecting) {
+        for(auto& it: characteristics) {
+            if ((!track_service_changed || it.second != service_changed_char) && it.second->cccd_value != 0 && it.second->cccd_handle != 0) {
+                it.second->write_cccd_async(it.second->cccd_value, WARBLE_GATT_ENABLE_NOTIFY_ERROR, nullptr, 
+                        [](void* context, WarbleGattChar* caller, const char* value) { });
+            }
+        }
+    }
+    stats.record(GattStats::DISCOVERY, duration_cast<microseconds>(steady_clock::now() - setup_started));
+    end_connect_attempt(true);
+    connect_handler(connect_context, this, nullptr);
 }
 
-void WarbleGattChar_Blepp::write_without_resp_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
-    stringstream error_stream;
-    string msg;
-    const char* error_msg = nullptr;
+WarbleGattChar_Blepp* WarbleGatt_Blepp::bind_characteristic(const GattCharacteristicInfo& info) {
+    auto it = lower_bound(retired.begin(), retired.end(), info.uuid, [](const pair<Uuid128, WarbleGattChar_Blepp*>& entry, const Uuid128& key) {
+        return entry.first < key;
+    });
+    if (it == retired.end() || it->first != info.uuid) {
+        return new WarbleGattChar_Blepp(this, info);
+    }
 
-    try {
-        ble_char.write_command(value, len);
-    } catch (const std::exception& e) {
-        error_stream << WARBLE_GATT_WRITE_ERROR << "(" << e.what() << ")";
-        msg = error_stream.str();
-        error_msg = msg.c_str();
-    } catch (const BLEDevice::WriteError&) {
-        error_msg = WARBLE_GATT_WRITE_ERROR;
+    auto gatt_char = it->second;
+    retired.erase(it);
+    gatt_char->rebind(&info);
+    return gatt_char;
+}
+
+void WarbleGatt_Blepp::service_changed() {
+    if (!gatt_cache::enabled()) {
+        return;
     }
 
-    handler(context, this, error_msg);
+    gatt_cache::remove(mac);
+    // handles loaded from the cache can no longer be trusted, drop the link so the next connect rediscovers
+    if (from_cache) {
+        if (reconnect_policy.enabled) {
+            // closed like a lost link so auto-reconnect picks it back up
+            shutdown(link->socket(), SHUT_RDWR);
+        } else {
+            disconnect();
+        }
+    }
 }
 
-void WarbleGattChar_Blepp::read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) {
-    try {
-        gatt_op_error_handler = [this, context, handler](const char* msg) {
-            owner->active_char = nullptr;
+bool WarbleGatt_Blepp::handle_events(bool readable, bool writable) {
+    io_thread = this_thread::get_id();
+    if (connect_cancelled && !att_owned) {
+        return fail_connect(WARBLE_CONNECT_CANCELLED);
+    }
+    awaiting_connect = false;
 
-            if (msg != nullptr) {
-                stringstream error_stream;
-                string full_msg;
+    if (!local_dc && !terminate) {
+        if (writable) {
+            if (att_owned) {
+                flush_stream();
+                resume_ops();
+            } else {
+                link->write_and_process_next();
+            }
+        }
 
-                error_stream << WARBLE_GATT_READ_ERROR << "(" << msg << ")";
-                full_msg = error_stream.str();
-                handler(context, this, nullptr, 0, full_msg.c_str());
+        if (readable) {
+            if (att_owned) {
+                process_att();
             } else {
-                handler(context, this, nullptr, 0, msg);
-            }            
-        };
+                link->read_and_process_next();
+            }
+        }
+    }
 
-        owner->active_char = this;
-        read_context = context;
-        read_handler = handler;
+    return local_dc || terminate ? end_session() : true;
+}
 
-        ble_char.read_request();
-    } catch (const std::exception& e) {
-        gatt_op_error_handler(e.what());
-    } catch (const BLEDevice::WriteError&) {
-        gatt_op_error_handler(nullptr);
+bool WarbleGatt_Blepp::handle_timeout() {
+    io_thread = this_thread::get_id();
+    if (!awaiting_connect) {
+        return true;
     }
+    return fail_connect(WARBLE_CONNECT_TIMEOUT);
 }
 
-void WarbleGattChar_Blepp::enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
-    try {
-        gatt_op_error_handler = [this, context, handler](const char* msg) {
-            owner->active_char = nullptr;
+bool WarbleGatt_Blepp::handle_failure() {
+    return awaiting_connect ? fail_connect(WARBLE_GATT_ERROR) : end_session();
+}
 
-            if (msg != nullptr) {
-                stringstream error_stream;
-                string full_msg;
+bool WarbleGatt_Blepp::fail_connect(const char* error) {
+    auto context = connect_context;
+    auto handler = connect_handler;
 
-                error_stream << WARBLE_GATT_ENABLE_NOTIFY_ERROR << "(" << msg << ")";
-                full_msg = error_stream.str();
-                handler(context, this, full_msg.c_str());
-            } else {
-                handler(context, this, msg);
-            }            
-        };
-
-        owner->active_char = this;
-        owner->write_context = context;
-        owner->write_handler = handler;
-        ble_char.set_notify_and_indicate(true, false);
-    } catch (const std::exception& e) {
-        gatt_op_error_handler(e.what());
-    }
+    awaiting_connect = false;
+    close_session();
+    end_connect_attempt(false);
+    release_session();
+    handler(context, this, error);
+    return false;
 }
 
-void WarbleGattChar_Blepp::disable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
-    try {
-        gatt_op_error_handler = [this, context, handler](const char* msg) {
-            owner->active_char = nullptr;
+void WarbleGatt_Blepp::end_connect_attempt(bool succeeded) {
+    if (succeeded) {
+        stats.record(GattStats::CONNECT, duration_cast<microseconds>(steady_clock::now() - connect_started));
+    } else {
+        stats.increment(GattStats::CONNECT_FAILURES);
+    }
 
-            if (msg != nullptr) {
-                stringstream error_stream;
-                string full_msg;
+    lock_guard<mutex> lock(session_mutex);
+    connect_pending = false;
+}
 
-                error_stream << WARBLE_GATT_DISABLE_NOTIFY_ERROR << "(" << msg << ")";
-                full_msg = error_stream.str();
-                handler(context, this, full_msg.c_str());
-            } else {
-                handler(context, this, msg);
-            }            
-        };
-
-        owner->active_char = this;
-        owner->write_context = context;
-        owner->write_handler = handler;
-        ble_char.set_notify_and_indicate(false, false);
-    } catch (const std::exception& e) {
-        gatt_op_error_handler(e.what());
+void WarbleGatt_Blepp::cancel_connect() {
+    lock_guard<mutex> lock(session_mutex);
+    // a reconnect waiting out its backoff is abandoned along with any attempt in progress
+    if (reconnect_pending) {
+        reconnect_cancelled = true;
+        session_ended.notify_all();
+    }
+
+    if (connect_pending && !connect_cancelled) {
+        connect_cancelled = true;
+        // wakes the io thread, which reports the cancellation through the connect handler
+        if (session_active) {
+            shutdown(sock, SHUT_RDWR);
+        }
     }
 }
 
-void WarbleGattChar_Blepp::on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler) {
-    value_changed_context = context;
-    value_changed_handler = handler;
+bool WarbleGatt_Blepp::end_session() {
+    if (!local_dc) {
+        link->on_disconnected = nullptr;
+    }
+    close_session();
+    if (att_owned) {
+        btsnoop::disconnection(hci_handle, local_dc);
+    }
+    fail_pending(local_dc ? WARBLE_GATT_LOCAL_DISCONNECT : WARBLE_GATT_REMOTE_DISCONNECT);
+
+    if (discovering) {
+        // the caller has not been told the connection succeeded, report the failure through the connect handler instead
+        auto context = connect_context;
+        auto handler = connect_handler;
+
+        stringstream error_stream;
+        if (connect_cancelled) {
+            error_stream << WARBLE_CONNECT_CANCELLED;
+        } else {
+            error_stream << WARBLE_GATT_DISCOVERY_ERROR << "(" << 
+                    (!setup_error.empty() ? setup_error.c_str() : (local_dc ? WARBLE_GATT_LOCAL_DISCONNECT : WARBLE_GATT_REMOTE_DISCONNECT)) << ")";
+        }
+        string full_msg = error_stream.str();
+
+        discovering = false;
+        connected = false;
+        end_connect_attempt(false);
+        release_session();
+        handler(context, this, full_msg.c_str());
+        return false;
+    }
+
+    connected = false;
+    if (reconnect_policy.enabled && !local_dc) {
+        {
+            lock_guard<mutex> lock(session_mutex);
+            reconnect_pending = true;
+            reconnect_cancelled = false;
+        }
+        reconnect_attempt = 0;
+        link_lost = steady_clock::now();
+
+        release_session();
+        schedule_reconnect();
+        return false;
+    }
+
+    // the object may be freed as soon as the session is released
+    auto context = on_disconnect_context;
+    auto handler = on_disconnect_handler;
+    auto code = dc_code;
+
+    release_session();
+
+    if (handler != nullptr) {
+        handler(context, this, code);
+    }
+    return false;
+}
+
+void WarbleGatt_Blepp::schedule_reconnect() {
+    auto delay = reconnect_policy.initial_delay * (1LL << min<uint32_t>(reconnect_attempt, 20));
+    if (delay > reconnect_policy.max_delay) {
+        delay = reconnect_policy.max_delay;
+    }
+
+    if (manual_io || use_reactor) {
+        {
+            lock_guard<mutex> lock(session_mutex);
+            reconnect_at = steady_clock::now() + delay;
+        }
+        if (use_reactor) {
+            reconnect_timer = true;
+            blepp_reactor::add(this);
+        }
+        return;
+    }
+
+    thread th([this, delay]() {
+        {
+            unique_lock<mutex> lock(session_mutex);
+            session_ended.wait_for(lock, delay, [this]() { return reconnect_cancelled; });
+        }
+        attempt_reconnect();
+    });
+    th.detach();
+}
+
+void WarbleGatt_Blepp::attempt_reconnect() {
+    bool cancelled;
+    {
+        lock_guard<mutex> lock(session_mutex);
+        if (!(cancelled = reconnect_cancelled)) {
+            reconnect_stats.attempts++;
+        }
+    }
+    if (cancelled) {
+        stop_reconnecting();
+        return;
+    }
+
+    reconnecting = true;
+    reconnect_attempt++;
+    connect_async(this, reconnect_completed);
+}
+
+void WarbleGatt_Blepp::stop_reconnecting() {
+    auto context = on_disconnect_context;
+    auto handler = on_disconnect_handler;
+    auto code = dc_code;
+
+    reconnecting = false;
+    {
+        lock_guard<mutex> lock(session_mutex);
+        reconnect_pending = false;
+        session_ended.notify_all();
+    }
+
+    if (handler != nullptr) {
+        handler(context, this, code);
+    }
+}
+
+void WarbleGatt_Blepp::reconnect_completed(void* context, WarbleGatt* caller, const char* value) {
+    auto gatt = static_cast<WarbleGatt_Blepp*>(context);
+    bool cancelled;
+    {
+        lock_guard<mutex> lock(gatt->session_mutex);
+        cancelled = gatt->reconnect_cancelled;
+    }
+
+    if (value == nullptr) {
+        auto latency = static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now() - gatt->link_lost).count());
+
+        gatt->reconnecting = false;
+        {
+            lock_guard<mutex> lock(gatt->session_mutex);
+            gatt->reconnect_pending = false;
+            gatt->reconnect_stats.reconnects++;
+            gatt->reconnect_stats.last_latency_ms = latency;
+            gatt->reconnect_stats.max_latency_ms = max(gatt->reconnect_stats.max_latency_ms, latency);
+        }
+
+        // disconnect was called while the attempt was in progress
+        if (cancelled) {
+            gatt->disconnect();
+        }
+    } else if (cancelled || (gatt->reconnect_policy.max_attempts != 0 && gatt->reconnect_attempt >= gatt->reconnect_policy.max_attempts)) {
+        gatt->stop_reconnecting();
+    } else {
+        gatt->schedule_reconnect();
+    }
+}
+
+void WarbleGatt_Blepp::update_conn_params(const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    HciConnParams raw;
+    string cause;
+
+    if (!to_hci_params(*params, raw)) {
+        cause = WARBLE_GATT_INVALID_CONN_PARAMS;
+    } else if (!connected) {
+        cause = WARBLE_GATT_NOT_CONNECTED;
+    } else if (!link->on_adapter()) {
+        cause = WARBLE_NOT_SUPPORTED;
+    } else if (manual_io) {
+        // no threads in manual mode, the handler only learns whether the command reached the adapter
+        cause = hci_link::send_params(session_hci, hci_handle, raw);
+    } else {
+        {
+            lock_guard<mutex> lock(session_mutex);
+            param_updates++;
+        }
+
+        // the controller's command status can take a while, neither the caller nor the io thread waits on it
+        auto adapter = session_hci;
+        auto handle = hci_handle;
+        thread th([this, adapter, handle, raw, context, handler]() {
+            updating_params = this;
+            report_conn_params(hci_link::update_params(adapter, handle, raw), context, handler);
+            if (updating_params == nullptr) {
+                return;
+            }
+            updating_params = nullptr;
+
+            lock_guard<mutex> lock(session_mutex);
+            param_updates--;
+            session_ended.notify_all();
+        });
+        th.detach();
+        return;
+    }
+
+    report_conn_params(cause, context, handler);
+}
+
+void WarbleGatt_Blepp::report_conn_params(const string& cause, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    if (cause.empty()) {
+        handler(context, this, nullptr);
+    } else {
+        stringstream error_stream;
+        string full_msg;
+
+        error_stream << WARBLE_GATT_CONN_PARAMS_ERROR << "(" << cause << ")";
+        full_msg = error_stream.str();
+        handler(context, this, full_msg.c_str());
+    }
+}
+
+void WarbleGatt_Blepp::get_reconnect_stats(WarbleReconnectStats* stats) const {
+    lock_guard<mutex> lock(session_mutex);
+    *stats = reconnect_stats;
+}
+
+void WarbleGatt_Blepp::get_stats(WarbleGattStats* stats) const {
+    this->stats.snapshot(stats);
+}
+
+int WarbleGatt_Blepp::io_fd() const {
+    return reconnect_timer ? -1 : sock;
+}
+
+bool WarbleGatt_Blepp::io_wants_write() const {
+    return att_owned ? stream_blocked.load(memory_order_relaxed) || ops_blocked.load(memory_order_relaxed) : link->wait_on_write();
+}
+
+steady_clock::time_point WarbleGatt_Blepp::io_deadline() const {
+    if (reconnect_timer) {
+        // a cancelled reconnect is reported right away
+        lock_guard<mutex> lock(session_mutex);
+        return reconnect_cancelled ? steady_clock::time_point::min() : reconnect_at;
+    }
+    return awaiting_connect ? connect_deadline : steady_clock::time_point::max();
+}
+
+void WarbleGatt_Blepp::io_process(bool readable, bool writable) {
+    handle_events(readable, writable);
+}
+
+void WarbleGatt_Blepp::io_timeout() {
+    if (reconnect_timer) {
+        // the attempt registers its own socket
+        reconnect_timer = false;
+        blepp_reactor::remove(this);
+        attempt_reconnect();
+        return;
+    }
+    handle_timeout();
+}
+
+int32_t WarbleGatt_Blepp::get_fd(uint32_t* events) const {
+    *events = 0;
+    if (!manual_io) {
+        return -1;
+    }
+
+    lock_guard<mutex> lock(session_mutex);
+    if (!session_active) {
+        return -1;
+    }
+    *events = WARBLE_IO_READ | (io_wants_write() ? WARBLE_IO_WRITE : 0);
+    return sock;
+}
+
+int32_t WarbleGatt_Blepp::get_timeout() const {
+    if (!manual_io) {
+        return -1;
+    }
+
+    lock_guard<mutex> lock(session_mutex);
+    if (session_active) {
+        return blepp_io_timeout(io_deadline());
+    }
+    if (reconnect_pending && !reconnecting) {
+        // a cancelled reconnect is reported on the next process call
+        return reconnect_cancelled ? 0 : blepp_io_timeout(reconnect_at);
+    }
+    return -1;
+}
+
+void WarbleGatt_Blepp::process(uint32_t events) {
+    if (!manual_io) {
+        return;
+    }
+
+    bool active, reconnect_due;
+    {
+        lock_guard<mutex> lock(session_mutex);
+        active = session_active;
+        reconnect_due = reconnect_pending && !reconnecting && (reconnect_cancelled || steady_clock::now() >= reconnect_at);
+    }
+
+    if (active) {
+        if (events & (WARBLE_IO_READ | WARBLE_IO_WRITE | WARBLE_IO_ERROR)) {
+            handle_events(events & (WARBLE_IO_READ | WARBLE_IO_ERROR), events & (WARBLE_IO_WRITE | WARBLE_IO_ERROR));
+        } else if (steady_clock::now() >= io_deadline()) {
+            handle_timeout();
+        }
+    } else if (reconnect_due) {
+        attempt_reconnect();
+    }
+}
+
+bool WarbleGatt_Blepp::att_send(const uint8_t* pdu, size_t len, bool wait_on_full) {
+    ssize_t sent;
+    while((sent = send(sock, pdu, len, MSG_NOSIGNAL | MSG_DONTWAIT)) < 0 && wait_on_full && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+        // the controller frees buffers within a few connection events, a second without room means the link is stuck
+        pollfd fds = { sock, POLLOUT, 0 };
+        if (poll(&fds, 1, 1000) <= 0) {
+            errno = EAGAIN;
+            return false;
+        }
+    }
+    if (sent != static_cast<ssize_t>(len)) {
+        return false;
+    }
+
+    btsnoop::att(hci_handle, false, pdu, len);
+    return true;
+}
+
+void WarbleGatt_Blepp::process_att() {
+    uint8_t pdu[att::MAX_PDU_LEN];
+    // room for the SO_TIMESTAMPNS receive time
+    uint8_t control[CMSG_SPACE(sizeof(timespec))];
+    iovec iov = { pdu, sizeof(pdu) };
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t len = recvmsg(sock, &msg, 0);
+
+    if (len <= 0) {
+        if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        dc_code = len < 0 ? errno : 0;
+        terminate = true;
+        return;
+    }
+    btsnoop::att(hci_handle, true, pdu, static_cast<size_t>(len));
+
+    switch(pdu[0]) {
+    case att::MTU_REQ:
+        // the remote side may start its own exchange, answer with what warble was asked to use
+        if (len >= 3) {
+            uint8_t response[3];
+            uint16_t rx_mtu = max(requested_mtu, att::DEFAULT_LE_MTU);
+            if (att_send(response, att::encode_mtu(response, att::MTU_RSP, rx_mtu))) {
+                lock_guard<mutex> lock(op_mutex);
+                mtu = max(att::DEFAULT_LE_MTU, min(rx_mtu, att::get_le16(pdu + 1)));
+            }
+        }
+        break;
+    case att::HANDLE_NOTIFY:
+    case att::HANDLE_IND: {
+        auto now = steady_clock::now();
+        if (last_notification != steady_clock::time_point()) {
+            stats.record(GattStats::NOTIFICATION_INTERVAL, duration_cast<microseconds>(now - last_notification));
+        }
+        last_notification = now;
+        stats.increment(GattStats::NOTIFICATIONS);
+
+        if (len >= 3) {
+            uint16_t handle = att::get_le16(pdu + 1);
+            auto it = value_handles.find(handle);
+            if (it != value_handles.end()) {
+                it->second->notify(pdu + 3, len - 3, receive_timestamp(msg));
+            }
+            if (handle != 0 && handle == service_changed_handle) {
+                service_changed();
+            }
+        }
+        if (pdu[0] == att::HANDLE_IND) {
+            uint8_t confirm = att::HANDLE_CONF;
+            att_send(&confirm, 1);
+        }
+        break;
+    }
+    case att::ERROR_RSP:
+    case att::MTU_RSP:
+    case att::FIND_INFO_RSP:
+    case att::READ_BY_TYPE_RSP:
+    case att::READ_BY_GROUP_RSP:
+    case att::READ_RSP:
+    case att::READ_BLOB_RSP:
+    case att::READ_MULTI_VAR_RSP:
+    case att::WRITE_RSP:
+    case att::PREP_WRITE_RSP:
+    case att::EXEC_WRITE_RSP:
+        if (discovering) {
+            process_setup_response(pdu, len);
+        } else {
+            // a handle the cached table claims exists was rejected, the cache is out of date
+            if (from_cache && pdu[0] == att::ERROR_RSP && len >= 5 && pdu[4] == att::INVALID_HANDLE) {
+                gatt_cache::remove(mac);
+            }
+            process_response(pdu, len);
+        }
+        break;
+    default:
+        if (att::is_request(pdu[0])) {
+            uint8_t response[5];
+            att_send(response, att::encode_error_rsp(response, pdu[0], 0x0000, att::REQUEST_NOT_SUPPORTED));
+        }
+        break;
+    }
+}
+
+void WarbleGatt_Blepp::submit(GattOp* ops, size_t nops) {
+    vector<GattOp> finished;
+    bool blocked = false;
+    {
+        lock_guard<mutex> lock(op_mutex);
+        for(size_t i = 0; i < nops; i++) {
+            if (!att_ready) {
+                ops[i].error = WARBLE_GATT_NOT_CONNECTED;
+                finished.push_back(move(ops[i]));
+            } else if (ops[i].handle == 0 && ops[i].type != GattOp::DISCOVER && ops[i].type != GattOp::READ_MULTIPLE) {
+                // the characteristic was not found again after a reconnect, handle 0 would go nowhere
+                ops[i].error = WARBLE_GATT_CHAR_DETACHED;
+                finished.push_back(move(ops[i]));
+            } else {
+                pending_ops.push_back(move(ops[i]));
+            }
+        }
+
+        if (att_ready && !op_in_flight && !ops_blocked) {
+            pump(finished);
+            blocked = ops_blocked;
+        }
+    }
+
+    if (blocked && this_thread::get_id() != io_thread) {
+        refresh_io_events();
+    }
+    complete_finished(finished);
+}
+
+void WarbleGatt_Blepp::submit_batch(const WarbleGattOp* ops, int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    auto batch = new WarbleGattBatch(this, ops, nops, context, handler);
+    vector<GattOp> queued;
+    queued.reserve(nops);
+
+    // ops that fail before being queued complete immediately, they can never be the last op to complete 
+    // unless nothing was queued so the batch is not touched after the loop in that case
+    for(int32_t i = 0; i < nops; i++) {
+        auto slot = batch->slot(i);
+        auto gattchar = static_cast<WarbleGattChar_Blepp*>(ops[i].gattchar);
+        GattOp op;
+
+        if (ops[i].gattchar->get_gatt() != this) {
+            // its handles come from another connection's attribute table
+            WarbleGattBatch::on_write_completed(slot, ops[i].gattchar, WARBLE_GATT_FOREIGN_CHAR);
+            continue;
+        }
+
+        switch(ops[i].type) {
+        case WARBLE_GATT_OP_READ:
+            queued.push_back(gattchar->read_long_op(slot, WarbleGattBatch::on_read_completed));
+            break;
+        case WARBLE_GATT_OP_WRITE:
+            if (gattchar->write_long_op(ops[i].value, ops[i].len, slot, WarbleGattBatch::on_write_completed, op)) {
+                queued.push_back(move(op));
+            }
+            break;
+        case WARBLE_GATT_OP_WRITE_WITHOUT_RESP:
+            if (ops[i].len > UINT8_MAX) {
+                stringstream error_stream;
+                string full_msg;
+
+                error_stream << WARBLE_GATT_WRITE_ERROR << "(" << WARBLE_GATT_VALUE_TOO_LONG << ")";
+                full_msg = error_stream.str();
+                WarbleGattBatch::on_write_completed(slot, gattchar, full_msg.c_str());
+            } else {
+                queued.push_back(gattchar->write_op(GattOp::WRITE_CMD, ops[i].value, ops[i].len, slot, WarbleGattBatch::on_write_completed));
+            }
+            break;
+        case WARBLE_GATT_OP_ENABLE_NOTIFICATIONS:
+        case WARBLE_GATT_OP_DISABLE_NOTIFICATIONS:
+            if (ops[i].type == WARBLE_GATT_OP_ENABLE_NOTIFICATIONS ? 
+                    gattchar->cccd_op(att::CCCD_NOTIFY, WARBLE_GATT_ENABLE_NOTIFY_ERROR, slot, WarbleGattBatch::on_write_completed, op) :
+                    gattchar->cccd_op(0x0000, WARBLE_GATT_DISABLE_NOTIFY_ERROR, slot, WarbleGattBatch::on_write_completed, op)) {
+                queued.push_back(move(op));
+            }
+            break;
+        default:
+            WarbleGattBatch::on_write_completed(slot, gattchar, WARBLE_GATT_INVALID_OP);
+            break;
+        }
+    }
+
+    submit(queued.data(), queued.size());
+}
+
+void WarbleGatt_Blepp::read_multiple(WarbleGattChar* const* chars, int32_t nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    vector<WarbleGattOp> ops(nchars);
+    for(int32_t i = 0; i < nchars; i++) {
+        ops[i] = { chars[i], WARBLE_GATT_OP_READ, nullptr, 0 };
+    }
+    auto batch = new WarbleGattBatch(this, ops.data(), nchars, context, handler);
+
+    auto op = static_cast<WarbleGattChar_Blepp*>(chars[0])->new_op(GattOp::READ_MULTIPLE, 0, WARBLE_GATT_READ_ERROR, nullptr);
+    op.multiple.reset(new MultiRead());
+    op.multiple->next = 0;
+    op.multiple->requested = 0;
+    op.multiple->partial = false;
+    // characteristics that cannot be read fail right away, as with submit_batch the batch is not touched after the 
+    // loop if none were kept
+    for(int32_t i = 0; i < nchars; i++) {
+        auto gattchar = static_cast<WarbleGattChar_Blepp*>(chars[i]);
+        if (chars[i]->get_gatt() != this || gattchar->value_handle == 0) {
+            // another connection's handles would name unrelated attributes on this device
+            stringstream error_stream;
+            error_stream << WARBLE_GATT_READ_ERROR << "(" << (chars[i]->get_gatt() != this ? WARBLE_GATT_FOREIGN_CHAR : WARBLE_GATT_CHAR_DETACHED) << ")";
+            WarbleGattBatch::on_read_completed(batch->slot(i), chars[i], nullptr, 0, error_stream.str().c_str());
+        } else {
+            op.multiple->entries.push_back({ gattchar, batch->slot(i), gattchar->value_handle, {}, {}, false });
+        }
+    }
+
+    if (!op.multiple->entries.empty()) {
+        // chars[0] may have been one of the rejected characteristics
+        op.source = op.multiple->entries.front().source;
+        submit(&op, 1);
+    }
+}
+
+void WarbleGatt_Blepp::pump(vector<GattOp>& finished) {
+    while(!pending_ops.empty()) {
+        auto& op = pending_ops.front();
+
+        bool sent = send_request(op);
+        if (ops_blocked) {
+            // the op stays at the head, the I/O thread sends it once the socket has room
+            return;
+        }
+        if (sent && op.type != GattOp::WRITE_CMD) {
+            op_in_flight = true;
+            return;
+        }
+        finished.push_back(move(op));
+        pending_ops.pop_front();
+    }
+}
+
+bool WarbleGatt_Blepp::send_request(GattOp& op) {
+    uint8_t pdu[att::MAX_PDU_LEN];
+    size_t len;
+
+    switch(op.type) {
+    case GattOp::DISCOVER:
+        // nothing left to walk, the op is done
+        if ((len = op.discovery->next_request(pdu)) == 0) {
+            return false;
+        }
+        break;
+    case GattOp::READ:
+        len = att::encode_read_req(pdu, op.handle);
+        break;
+    case GattOp::READ_LONG:
+        len = op.offset == 0 ? att::encode_read_req(pdu, op.handle) : att::encode_read_blob_req(pdu, op.handle, op.offset);
+        break;
+    case GattOp::READ_MULTIPLE: {
+        auto& multiple = *op.multiple;
+        auto& entries = multiple.entries;
+        while(multiple.next < entries.size() && entries[multiple.next].done) {
+            multiple.next++;
+        }
+        if (multiple.next == entries.size()) {
+            return false;
+        }
+
+        auto& head = entries[multiple.next];
+        size_t remaining = entries.size() - multiple.next;
+        if (multiple.partial) {
+            multiple.requested = 1;
+            len = att::encode_read_blob_req(pdu, head.handle, static_cast<uint16_t>(head.value.size()));
+        } else if (!read_multi_var || remaining == 1) {
+            multiple.requested = 1;
+            len = att::encode_read_req(pdu, head.handle);
+        } else {
+            // as many handles as fit in one request, the request needs at least two
+            multiple.requested = min(remaining, static_cast<size_t>(mtu - 1) / 2);
+
+            vector<uint16_t> handles;
+            for(size_t i = 0; i < multiple.requested; i++) {
+                handles.push_back(entries[multiple.next + i].handle);
+            }
+            len = att::encode_read_multi_var_req(pdu, handles.data(), handles.size());
+        }
+        break;
+    }
+    case GattOp::WRITE:
+        len = att::encode_write(pdu, att::WRITE_REQ, op.handle, op.value.data(), op.value.size());
+        break;
+    case GattOp::WRITE_CMD:
+        len = att::encode_write(pdu, att::WRITE_CMD, op.handle, op.value.data(), op.value.size());
+        break;
+    case GattOp::WRITE_LONG:
+        if (op.cancelling) {
+            len = att::encode_exec_write_req(pdu, att::EXEC_WRITE_CANCEL);
+        } else if (op.offset == 0 && op.value.size() <= static_cast<size_t>(mtu - 3)) {
+            len = att::encode_write(pdu, att::WRITE_REQ, op.handle, op.value.data(), op.value.size());
+        } else if (op.offset < op.value.size()) {
+            size_t chunk = min(op.value.size() - op.offset, static_cast<size_t>(mtu - 5));
+            len = att::encode_prep_write_req(pdu, op.handle, op.offset, op.value.data() + op.offset, chunk);
+        } else {
+            len = att::encode_exec_write_req(pdu, att::EXEC_WRITE_COMMIT);
+        }
+        break;
+    }
+
+    if (op.sent_opcode == 0) {
+        op.started = steady_clock::now();
+    }
+    op.sent_opcode = pdu[0];
+    if (!att_send(pdu, len, false)) {
+        // a burst of write commands filled the socket, blocking here would hold op_mutex and stall the I/O thread
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR) {
+            op_in_flight = false;
+            ops_blocked = true;
+            return true;
+        }
+        if (!op.cancelling) {
+            op.error = strerror(errno);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool WarbleGatt_Blepp::advance_head(GattOp& op, const uint8_t* pdu, size_t len) {
+    if (op.type == GattOp::DISCOVER) {
+        if (!op.discovery->process_response(pdu, len)) {
+            op.error = op.discovery->error;
+            return true;
+        }
+        return !send_request(op);
+    }
+    if (op.type == GattOp::READ_MULTIPLE) {
+        return advance_read_multiple(op, pdu, len);
+    }
+
+    if (pdu[0] == att::ERROR_RSP) {
+        if (len < 5 || pdu[1] != op.sent_opcode) {
+            op.error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+            return true;
+        }
+
+        switch(op.sent_opcode) {
+        case att::READ_BLOB_REQ:
+            // value length was an exact multiple of the blob size
+            if (pdu[4] == att::ATTRIBUTE_NOT_LONG || pdu[4] == att::INVALID_OFFSET) {
+                return true;
+            }
+            break;
+        case att::PREP_WRITE_REQ:
+            // the remote device may still hold earlier prepared writes, discard them before reporting the error
+            op.error = att::error_to_string(pdu[4]);
+            op.cancelling = true;
+            return !send_request(op);
+        case att::EXEC_WRITE_REQ:
+            if (op.cancelling) {
+                return true;
+            }
+            break;
+        }
+
+        op.error = att::error_to_string(pdu[4]);
+        return true;
+    }
+
+    // every request warble sends is answered by the opcode directly after it
+    if (pdu[0] != op.sent_opcode + 1) {
+        op.error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+        return true;
+    }
+
+    switch(pdu[0]) {
+    case att::READ_RSP:
+    case att::READ_BLOB_RSP:
+        op.value.insert(op.value.end(), pdu + 1, pdu + len);
+        // a full response means there may be more of the value to fetch
+        if (op.type == GattOp::READ_LONG && len == mtu && op.value.size() < att::MAX_ATTR_LEN) {
+            op.offset = static_cast<uint16_t>(op.value.size());
+            return !send_request(op);
+        }
+        return true;
+    case att::PREP_WRITE_RSP: {
+        size_t chunk = min(op.value.size() - op.offset, static_cast<size_t>(mtu - 5));
+        if (len != 5 + chunk || att::get_le16(pdu + 1) != op.handle || att::get_le16(pdu + 3) != op.offset || 
+                memcmp(pdu + 5, op.value.data() + op.offset, chunk)) {
+            op.error = WARBLE_GATT_PREPARE_WRITE_MISMATCH;
+            op.cancelling = true;
+        } else {
+            op.offset = static_cast<uint16_t>(op.offset + chunk);
+        }
+        return !send_request(op);
+    }
+    default:
+        return true;
+    }
+}
+
+bool WarbleGatt_Blepp::advance_read_multiple(GattOp& op, const uint8_t* pdu, size_t len) {
+    auto& multiple = *op.multiple;
+    auto& entries = multiple.entries;
+    auto& head = entries[multiple.next];
+
+    if (pdu[0] == att::ERROR_RSP) {
+        if (len < 5 || pdu[1] != op.sent_opcode) {
+            op.error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+            return true;
+        }
+
+        if (op.sent_opcode == att::READ_MULTI_VAR_REQ && pdu[4] == att::REQUEST_NOT_SUPPORTED) {
+            // remote device predates Bluetooth 5.2, fall back to a read per characteristic
+            read_multi_var = false;
+        } else if (op.sent_opcode == att::READ_BLOB_REQ && (pdu[4] == att::ATTRIBUTE_NOT_LONG || pdu[4] == att::INVALID_OFFSET)) {
+            // value length was an exact multiple of the blob size
+            head.done = true;
+        } else {
+            // the error names the first handle that could not be read, the rest of the request is asked for again
+            auto failed = &head;
+            for(size_t i = multiple.next; i < multiple.next + multiple.requested; i++) {
+                if (entries[i].handle == att::get_le16(pdu + 2)) {
+                    failed = &entries[i];
+                    break;
+                }
+            }
+
+            failed->error = att::error_to_string(pdu[4]);
+            failed->done = true;
+        }
+
+        multiple.partial = false;
+        return !send_request(op);
+    }
+
+    if (pdu[0] != op.sent_opcode + 1) {
+        op.error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+        return true;
+    }
+
+    switch(pdu[0]) {
+    case att::READ_MULTI_VAR_RSP:
+        if (len < 3) {
+            op.error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+            return true;
+        }
+
+        // (length, value) tuples in request order, the response ends wherever the MTU runs out so the last value 
+        // may be cut short and later ones missing entirely
+        for(size_t i = multiple.next, pos = 1; i < multiple.next + multiple.requested && pos + 2 <= len; i++) {
+            size_t value_len = att::get_le16(pdu + pos), available = min(value_len, len - pos - 2);
+            entries[i].value.assign(pdu + pos + 2, pdu + pos + 2 + available);
+            pos += 2 + available;
+
+            if (available < value_len) {
+                multiple.partial = true;
+                break;
+            }
+            entries[i].done = true;
+        }
+        break;
+    case att::READ_RSP:
+        head.value.assign(pdu + 1, pdu + len);
+        multiple.partial = len == mtu && head.value.size() < att::MAX_ATTR_LEN;
+        head.done = !multiple.partial;
+        break;
+    case att::READ_BLOB_RSP:
+        head.value.insert(head.value.end(), pdu + 1, pdu + len);
+        multiple.partial = len == mtu && head.value.size() < att::MAX_ATTR_LEN;
+        head.done = !multiple.partial;
+        break;
+    }
+
+    return !send_request(op);
+}
+
+void WarbleGatt_Blepp::process_response(const uint8_t* pdu, size_t len) {
+    vector<GattOp> finished;
+    {
+        lock_guard<mutex> lock(op_mutex);
+        if (!op_in_flight || pending_ops.empty()) {
+            return;
+        }
+        if (!advance_head(pending_ops.front(), pdu, len)) {
+            return;
+        }
+
+        finished.push_back(move(pending_ops.front()));
+        pending_ops.pop_front();
+        op_in_flight = false;
+
+        // keep the link busy before handing control to the caller
+        pump(finished);
+    }
+
+    complete_finished(finished);
+}
+
+void WarbleGatt_Blepp::resume_ops() {
+    vector<GattOp> finished;
+    {
+        lock_guard<mutex> lock(op_mutex);
+        if (!ops_blocked) {
+            return;
+        }
+
+        ops_blocked = false;
+        if (att_ready && !op_in_flight) {
+            pump(finished);
+        }
+    }
+
+    complete_finished(finished);
+}
+
+void WarbleGatt_Blepp::complete_finished(vector<GattOp>& finished) {
+    for(auto& it: finished) {
+        complete(it);
+    }
+}
+
+void WarbleGatt_Blepp::complete(GattOp& op) {
+    string full_msg;
+    if (!op.error.empty()) {
+        stringstream error_stream;
+
+        error_stream << op.error_prefix << "(" << op.error << ")";
+        full_msg = error_stream.str();
+    }
+
+    const char* msg = op.error.empty() ? nullptr : full_msg.c_str();
+    const uint8_t* value = msg == nullptr ? op.value.data() : nullptr;
+    size_t len = msg == nullptr ? op.value.size() : 0;
+
+    switch(op.type) {
+    case GattOp::READ:
+    case GattOp::READ_LONG:
+    case GattOp::READ_MULTIPLE:
+    case GattOp::WRITE:
+    case GattOp::WRITE_LONG:
+        if (msg != nullptr) {
+            stats.increment(GattStats::OP_FAILURES);
+        } else {
+            bool is_write = op.type == GattOp::WRITE || op.type == GattOp::WRITE_LONG;
+            stats.record(is_write ? GattStats::WRITE : GattStats::READ, duration_cast<microseconds>(steady_clock::now() - op.started));
+        }
+        break;
+    default:
+        // write commands are never acknowledged and discovery is covered by its own histogram
+        break;
+    }
+
+    switch(op.type) {
+    case GattOp::READ:
+        if (len > UINT8_MAX) {
+            // the handler's length is 8 bits, read_long_async reports the full value
+            stringstream error_stream;
+            error_stream << op.error_prefix << "(" << WARBLE_GATT_VALUE_TOO_LONG << ")";
+            op.read_handler(op.context, op.source, nullptr, 0, error_stream.str().c_str());
+        } else {
+            op.read_handler(op.context, op.source, value, static_cast<uint8_t>(len), msg);
+        }
+        break;
+    case GattOp::READ_LONG:
+        op.read_long_handler(op.context, op.source, value, static_cast<uint16_t>(len), msg);
+        break;
+    case GattOp::DISCOVER:
+        if (msg == nullptr) {
+            add_discovered(op.discovery->services.front());
+        }
+        op.write_handler(op.context, op.source, msg);
+        break;
+    case GattOp::READ_MULTIPLE:
+        // the batch frees itself after the last entry is reported
+        for(auto& it: op.multiple->entries) {
+            auto& cause = it.done ? it.error : op.error;
+            if (cause.empty()) {
+                WarbleGattBatch::on_read_completed(it.slot, it.source, it.value.data(), static_cast<uint16_t>(it.value.size()), nullptr);
+            } else {
+                stringstream error_stream;
+                error_stream << op.error_prefix << "(" << cause << ")";
+                WarbleGattBatch::on_read_completed(it.slot, it.source, nullptr, 0, error_stream.str().c_str());
+            }
+        }
+        break;
+    case GattOp::WRITE:
+        // only a CCCD write that went through is restored after auto-reconnect
+        if (msg == nullptr && op.source != nullptr && op.handle == op.source->cccd_handle && op.value.size() == 2) {
+            op.source->cccd_value = att::get_le16(op.value.data());
+        }
+        op.write_handler(op.context, op.source, msg);
+        break;
+    default:
+        op.write_handler(op.context, op.source, msg);
+        break;
+    }
+}
+
+void WarbleGatt_Blepp::fail_pending(const char* error) {
+    fail_stream(error);
+
+    deque<GattOp> aborted;
+    {
+        lock_guard<mutex> lock(op_mutex);
+        att_ready = false;
+        op_in_flight = false;
+        ops_blocked = false;
+        swap(aborted, pending_ops);
+    }
+
+    for(auto& it: aborted) {
+        it.error = error;
+        complete(it);
+    }
+}
+
+bool WarbleGatt_Blepp::stream_enqueue(StreamCommand command, bool windowed) {
+    {
+        lock_guard<mutex> lock(stream_mutex);
+        if (windowed && stream.size() >= stream_window) {
+            stream_full = true;
+            return false;
+        }
+
+        stream_bytes += command.pdu.size() - 3;
+        stream.push_back(move(command));
+    }
+
+    flush_stream();
+    return true;
+}
+
+void WarbleGatt_Blepp::flush_stream() {
+    vector<pair<StreamCommand, string>> finished;
+    bool ready = false, was_blocked, blocked;
+    {
+        lock_guard<mutex> lock(stream_mutex);
+        while(!stream.empty()) {
+            auto& head = stream.front();
+            string error;
+
+            if (!att_send(head.pdu.data(), head.pdu.size(), false)) {
+                // the controller has not freed up buffers yet, the rest goes out once the socket is writable
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR) {
+                    break;
+                }
+                error = strerror(errno);
+            }
+
+            stream_bytes -= head.pdu.size() - 3;
+            if (head.handler != nullptr) {
+                finished.emplace_back(move(head), move(error));
+            }
+            stream.pop_front();
+        }
+
+        if (stream_full && stream.size() <= stream_window / 2) {
+            stream_full = false;
+            ready = true;
+        }
+        blocked = !stream.empty();
+        was_blocked = stream_blocked.exchange(blocked);
+    }
+
+    if (blocked && !was_blocked && this_thread::get_id() != io_thread) {
+        refresh_io_events();
+    }
+
+    for(auto& it: finished) {
+        if (it.second.empty()) {
+            it.first.handler(it.first.context, it.first.source, nullptr);
+        } else {
+            stringstream error_stream;
+            string full_msg;
+
+            error_stream << WARBLE_GATT_WRITE_ERROR << "(" << it.second << ")";
+            full_msg = error_stream.str();
+            it.first.handler(it.first.context, it.first.source, full_msg.c_str());
+        }
+    }
+    if (ready && stream_ready_handler != nullptr) {
+        stream_ready_handler(stream_ready_context, this);
+    }
+}
+
+void WarbleGatt_Blepp::fail_stream(const char* error) {
+    deque<StreamCommand> aborted;
+    {
+        lock_guard<mutex> lock(stream_mutex);
+        swap(aborted, stream);
+        stream_bytes = 0;
+        stream_full = false;
+        stream_blocked = false;
+    }
+
+    stringstream error_stream;
+    error_stream << WARBLE_GATT_WRITE_ERROR << "(" << error << ")";
+    string full_msg = error_stream.str();
+    for(auto& it: aborted) {
+        if (it.handler != nullptr) {
+            it.handler(it.context, it.source, full_msg.c_str());
+        }
+    }
+}
+
+void WarbleGatt_Blepp::refresh_io_events() {
+    if (manual_io) {
+        // the application reads the events again after each call
+        return;
+    }
+    if (use_reactor) {
+        blepp_reactor::update(this);
+    } else {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter is saturated, the thread is already awake
+        }
+    }
+}
+
+void WarbleGatt_Blepp::on_stream_ready(void* context, FnVoid_VoidP_WarbleGattP handler) {
+    stream_ready_context = context;
+    stream_ready_handler = handler;
+}
+
+uint32_t WarbleGatt_Blepp::get_stream_queued() const {
+    lock_guard<mutex> lock(stream_mutex);
+    return static_cast<uint32_t>(stream_bytes);
+}
+
+WarbleL2capChannel* WarbleGatt_Blepp::create_l2cap_channel(uint16_t psm, int32_t nopts, const WarbleOption* opts) {
+    // channels get sockets of their own on the adapter the ACL link went through, the kernel runs them over that link
+    return blepp_l2cap_create(this, [this](BleppL2capTarget& target) -> const char* {
+        if (!is_connected()) {
+            return WARBLE_GATT_NOT_CONNECTED;
+        }
+        if (!link->on_adapter()) {
+            return WARBLE_NOT_SUPPORTED;
+        }
+
+        target.mac = mac;
+        target.public_addr = public_addr;
+        target.adapter = hci_balanced ? session_hci : hci_mac;
+        return nullptr;
+    }, psm, nopts, opts);
+}
+
+int32_t WarbleGatt_Blepp::get_queue_depth() const {
+    lock_guard<mutex> lock(op_mutex);
+    return static_cast<int32_t>(pending_ops.size());
+}
+
+uint16_t WarbleGatt_Blepp::get_mtu() const {
+    lock_guard<mutex> lock(op_mutex);
+    return mtu;
+}
+
+const char* WarbleGatt_Blepp::choose_adapter(const vector<string>& full) {
+    if (!link->on_adapter()) {
+        return "";
+    }
+    if (!hci_balanced) {
+        // same key balanced objects see the adapter under
+        next_hci = hci_pool::key(hci_mac);
+        return next_hci.c_str();
+    }
+
+    // start_session counts the link against this adapter instead of picking again
+    next_hci = hci_pool::least_loaded(hci_candidates, full);
+    return next_hci.empty() ? nullptr : next_hci.c_str();
+}
+
+void WarbleGatt_Blepp::disconnect() {
+    {
+        lock_guard<mutex> lock(session_mutex);
+        reconnect_cancelled = true;
+        session_ended.notify_all();
+    }
+    if (reconnect_timer) {
+        blepp_reactor::update(this);
+    }
+
+    local_dc = true;
+    shutdown(link->socket(), SHUT_RDWR);
+}
+
+void WarbleGatt_Blepp::on_disconnect(void* context, FnVoid_VoidP_WarbleGattP_Int handler) {
+    on_disconnect_context = context;
+    on_disconnect_handler = handler;
+}
+
+bool WarbleGatt_Blepp::is_connected() const {
+    return connected;
+}
+
+WarbleGattChar* WarbleGatt_Blepp::find_characteristic(const char* uuid) const {
+    Uuid128 key;
+    if (!Uuid128::parse(uuid, key)) {
+        return nullptr;
+    }
+
+    WarbleGattChar_Blepp* found;
+    {
+        lock_guard<mutex> lock(attr_mutex);
+        found = lookup_characteristic(key);
+    }
+
+    // the io thread cannot wait on responses it has to read itself
+    if (found != nullptr || discovery_mode != DiscoveryMode::ON_DEMAND || this_thread::get_id() == io_thread) {
+        return found;
+    }
+    // the table only grows, which callers of a const lookup cannot observe beyond the result
+    return const_cast<WarbleGatt_Blepp*>(this)->discover_characteristic(key);
+}
+
+WarbleGattChar_Blepp* WarbleGatt_Blepp::lookup_characteristic(const Uuid128& uuid) const {
+    auto it = lower_bound(characteristics.begin(), characteristics.end(), uuid, [](const pair<Uuid128, WarbleGattChar_Blepp*>& entry, const Uuid128& key) {
+        return entry.first < key;
+    });
+    return it == characteristics.end() || it->first != uuid ? nullptr : it->second;
+}
+
+/**
+ * Lets a thread in discover_characteristic wait on its DISCOVER op
+ */
+struct ServiceWalk {
+    mutex m;
+    condition_variable cv;
+    bool done;
+    string error;
+
+    static void completed(void* context, WarbleGattChar* caller, const char* value) {
+        auto walk = static_cast<ServiceWalk*>(context);
+
+        lock_guard<mutex> lock(walk->m);
+        walk->done = true;
+        if (value != nullptr) {
+            walk->error = value;
+        }
+        walk->cv.notify_all();
+    }
+};
+
+WarbleGattChar_Blepp* WarbleGatt_Blepp::discover_characteristic(const Uuid128& uuid) {
+    lock_guard<mutex> serial(on_demand_mutex);
+
+    while(true) {
+        GattServiceInfo service;
+        {
+            lock_guard<mutex> lock(attr_mutex);
+            auto found = lookup_characteristic(uuid);
+            if (found != nullptr) {
+                return found;
+            }
+
+            auto it = find_if(service_infos.begin(), service_infos.end(), [](const GattServiceInfo& info) { return !info.discovered; });
+            if (it == service_infos.end()) {
+                return nullptr;
+            }
+            service = *it;
+        }
+
+        ServiceWalk walk;
+        walk.done = false;
+
+        GattOp op;
+        op.type = GattOp::DISCOVER;
+        op.source = nullptr;
+        op.handle = service.start_handle;
+        op.error_prefix = WARBLE_GATT_DISCOVERY_ERROR;
+        op.sent_opcode = 0;
+        op.offset = 0;
+        op.cancelling = false;
+        op.discovery.reset(new GattDiscovery({ service }, { 0 }));
+        op.context = &walk;
+        op.write_handler = ServiceWalk::completed;
+        op.read_handler = nullptr;
+        op.read_long_handler = nullptr;
+        submit(&op, 1);
+
+        unique_lock<mutex> lock(walk.m);
+        walk.cv.wait(lock, [&walk]() { return walk.done; });
+        if (!walk.error.empty()) {
+            return nullptr;
+        }
+    }
+}
+
+void WarbleGatt_Blepp::add_discovered(GattServiceInfo& walked) {
+    {
+        lock_guard<mutex> lock(attr_mutex);
+        // the table may have been replaced by a reconnect while the service was walked
+        auto it = find_if(service_infos.begin(), service_infos.end(), [&walked](const GattServiceInfo& info) { 
+            return info.start_handle == walked.start_handle && info.uuid == walked.uuid; 
+        });
+        if (it == service_infos.end() || it->discovered) {
+            return;
+        }
+
+        *it = move(walked);
+        for(auto& info: it->characteristics) {
+            auto gatt_char = bind_characteristic(info);
+            // after any existing entry with the same uuid so earlier services still win
+            auto pos = upper_bound(characteristics.begin(), characteristics.end(), info.uuid, [](const Uuid128& key, const pair<Uuid128, WarbleGattChar_Blepp*>& entry) {
+                return key < entry.first;
+            });
+            characteristics.emplace(pos, info.uuid, gatt_char);
+            value_handles.emplace(gatt_char->value_handle, gatt_char);
+        }
+    }
+
+    if (gatt_cache::enabled()) {
+        gatt_cache::store(mac, { db_hash, service_infos });
+    }
+}
+
+bool WarbleGatt_Blepp::service_exists(const char* uuid) const {
+    Uuid128 key;
+    if (!Uuid128::parse(uuid, key)) {
+        return false;
+    }
+
+    lock_guard<mutex> lock(attr_mutex);
+    return binary_search(services.begin(), services.end(), key);
+}
+
+WarbleGattChar_Blepp::WarbleGattChar_Blepp(WarbleGatt_Blepp* owner, const GattCharacteristicInfo& info) : 
+        owner(owner), value_handle(info.value_handle), cccd_handle(info.cccd_handle), cccd_value(0), 
+        value_changed_context(nullptr), value_changed_handler(nullptr), value_changed_long_handler(nullptr), value_changed_ex_handler(nullptr), 
+        sequence_config(0), sequence_applied(0), last_sequence(0), has_sequence(false), sequence_gaps(0), sequence_missing(0), sequence_out_of_order(0) {
+    info.uuid.to_string(uuid_str);
+
+    if (owner->notification_capacity && (info.properties & (att::PROP_NOTIFY | att::PROP_INDICATE))) {
+        notifications.reset(new NotificationRing(owner->notification_capacity, owner->notification_overflow));
+    }
+}
+
+WarbleGattChar_Blepp::~WarbleGattChar_Blepp() {
+
+}
+
+void WarbleGattChar_Blepp::rebind(const GattCharacteristicInfo* info) {
+    // handle 0 is never valid, requests on a detached object fail before anything is sent
+    value_handle = info == nullptr ? 0 : info->value_handle;
+    cccd_handle = info == nullptr ? 0 : info->cccd_handle;
+}
+
+GattOp WarbleGattChar_Blepp::new_op(GattOp::Type type, uint16_t handle, const char* error_prefix, void* context) {
+    GattOp op;
+    op.type = type;
+    op.source = this;
+    op.handle = handle;
+    op.error_prefix = error_prefix;
+    op.sent_opcode = 0;
+    op.offset = 0;
+    op.cancelling = false;
+    op.context = context;
+    op.write_handler = nullptr;
+    op.read_handler = nullptr;
+    op.read_long_handler = nullptr;
+    return op;
+}
+
+GattOp WarbleGattChar_Blepp::read_op(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) {
+    auto op = new_op(GattOp::READ, value_handle, WARBLE_GATT_READ_ERROR, context);
+    op.read_handler = handler;
+    return op;
+}
+
+GattOp WarbleGattChar_Blepp::read_long_op(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler) {
+    auto op = new_op(GattOp::READ_LONG, value_handle, WARBLE_GATT_READ_ERROR, context);
+    op.read_long_handler = handler;
+    return op;
+}
+
+GattOp WarbleGattChar_Blepp::write_op(GattOp::Type type, const uint8_t* value, size_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    auto op = new_op(type, value_handle, WARBLE_GATT_WRITE_ERROR, context);
+    op.value.assign(value, value + len);
+    op.write_handler = handler;
+    return op;
+}
+
+bool WarbleGattChar_Blepp::write_long_op(const uint8_t* value, size_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler, GattOp& op) {
+    if (len > att::MAX_ATTR_LEN) {
+        stringstream error_stream;
+        string full_msg;
+
+        error_stream << WARBLE_GATT_WRITE_ERROR << "(" << WARBLE_GATT_VALUE_TOO_LONG << ")";
+        full_msg = error_stream.str();
+        handler(context, this, full_msg.c_str());
+        return false;
+    }
+
+    op = write_op(GattOp::WRITE_LONG, value, len, context, handler);
+    return true;
+}
+
+bool WarbleGattChar_Blepp::cccd_op(uint16_t value, const char* error_prefix, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler, GattOp& op) {
+    if (cccd_handle == 0) {
+        stringstream error_stream;
+        string full_msg;
+
+        error_stream << error_prefix << "(" << (value_handle == 0 ? WARBLE_GATT_CHAR_DETACHED : WARBLE_GATT_NO_CCCD) << ")";
+        full_msg = error_stream.str();
+        handler(context, this, full_msg.c_str());
+        return false;
+    }
+
+    op = new_op(GattOp::WRITE, cccd_handle, error_prefix, context);
+    op.value.resize(2);
+    att::put_le16(op.value.data(), value);
+    op.write_handler = handler;
+    return true;
+}
+
+void WarbleGattChar_Blepp::write_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    auto op = write_op(GattOp::WRITE, value, len, context, handler);
+    owner->submit(&op, 1);
+}
+
+void WarbleGattChar_Blepp::write_long_async(const uint8_t* value, uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    GattOp op;
+    if (write_long_op(value, len, context, handler, op)) {
+        owner->submit(&op, 1);
+    }
+}
+
+void WarbleGattChar_Blepp::write_without_resp_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    if (!owner->is_connected() || value_handle == 0) {
+        stringstream error_stream;
+        string msg;
+
+        error_stream << WARBLE_GATT_WRITE_ERROR << "(" << (value_handle == 0 ? WARBLE_GATT_CHAR_DETACHED : WARBLE_GATT_NOT_CONNECTED) << ")";
+        msg = error_stream.str();
+        handler(context, this, msg.c_str());
+        return;
+    }
+
+    // shares the stream queue so a full socket delays the command instead of failing it, the handler runs once it is sent
+    StreamCommand command = { vector<uint8_t>(3 + len), this, context, handler };
+    command.pdu.resize(att::encode_write(command.pdu.data(), att::WRITE_CMD, value_handle, value, len));
+    owner->stream_enqueue(move(command), false);
+}
+
+int32_t WarbleGattChar_Blepp::stream_write(const uint8_t* value, uint16_t len) {
+    if (!owner->is_connected() || value_handle == 0 || len > owner->get_mtu() - 3u) {
+        return -1;
+    }
+
+    StreamCommand command = { vector<uint8_t>(3 + len), this, nullptr, nullptr };
+    command.pdu.resize(att::encode_write(command.pdu.data(), att::WRITE_CMD, value_handle, value, len));
+    return owner->stream_enqueue(move(command), true) ? 1 : 0;
+}
+
+void WarbleGattChar_Blepp::read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) {
+    auto op = read_op(context, handler);
+    owner->submit(&op, 1);
+}
+
+void WarbleGattChar_Blepp::read_long_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler) {
+    auto op = read_long_op(context, handler);
+    owner->submit(&op, 1);
+}
+
+void WarbleGattChar_Blepp::write_cccd_async(uint16_t value, const char* error_prefix, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    GattOp op;
+    if (cccd_op(value, error_prefix, context, handler, op)) {
+        owner->submit(&op, 1);
+    }
+}
+
+void WarbleGattChar_Blepp::enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    write_cccd_async(att::CCCD_NOTIFY, WARBLE_GATT_ENABLE_NOTIFY_ERROR, context, handler);
+}
+
+void WarbleGattChar_Blepp::disable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    write_cccd_async(0x0000, WARBLE_GATT_DISABLE_NOTIFY_ERROR, context, handler);
+}
+
+void WarbleGattChar_Blepp::on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler) {
+    value_changed_context = context;
+    value_changed_handler = handler;
+    value_changed_long_handler = nullptr;
+    value_changed_ex_handler = nullptr;
+}
+
+void WarbleGattChar_Blepp::on_notification_received_long(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler) {
+    value_changed_context = context;
+    value_changed_handler = nullptr;
+    value_changed_long_handler = handler;
+    value_changed_ex_handler = nullptr;
+}
+
+void WarbleGattChar_Blepp::on_notification_received_ex(void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler) {
+    value_changed_context = context;
+    value_changed_handler = nullptr;
+    value_changed_long_handler = nullptr;
+    value_changed_ex_handler = handler;
+}
+
+int32_t WarbleGattChar_Blepp::drain_notifications(WarbleGattNotification* buf, int32_t max) {
+    return notifications == nullptr ? 0 : static_cast<int32_t>(notifications->drain(buf, max));
+}
+
+uint32_t WarbleGattChar_Blepp::get_dropped_notifications() const {
+    return notifications == nullptr ? 0 : notifications->get_dropped();
+}
+
+void WarbleGattChar_Blepp::set_sequence_tracking(const WarbleGattSequenceConfig* config) {
+    uint32_t packed = 0;
+    if (config->size >= 1 && config->size <= 4) {
+        packed = config->offset | (static_cast<uint32_t>(config->size) << 16) | (config->big_endian ? 1u << 24 : 0u);
+    }
+
+    sequence_gaps = 0;
+    sequence_missing = 0;
+    sequence_out_of_order = 0;
+    sequence_config.store(packed, memory_order_relaxed);
+}
+
+void WarbleGattChar_Blepp::get_sequence_stats(WarbleGattSequenceStats* stats) const {
+    stats->gaps = sequence_gaps.load(memory_order_relaxed);
+    stats->missing = sequence_missing.load(memory_order_relaxed);
+    stats->out_of_order = sequence_out_of_order.load(memory_order_relaxed);
+}
+
+uint32_t WarbleGattChar_Blepp::check_sequence(const uint8_t* value, size_t len) {
+    auto config = sequence_config.load(memory_order_relaxed);
+    if (config != sequence_applied) {
+        // counters read with the old layout are meaningless under the new one
+        sequence_applied = config;
+        has_sequence = false;
+    }
+
+    size_t offset = config & 0xffff, size = (config >> 16) & 0xff;
+    if (size == 0 || len < offset + size) {
+        return 0;
+    }
+
+    uint32_t counter = 0;
+    for(size_t i = 0; i < size; i++) {
+        counter = (counter << 8) | value[offset + ((config >> 24) ? i : size - 1 - i)];
+    }
+
+    uint32_t gap = 0;
+    if (has_sequence) {
+        uint64_t range = 1ull << (8 * size);
+        uint64_t delta = (counter + range - last_sequence) % range;
+
+        if (delta == 0 || delta >= range / 2) {
+            sequence_out_of_order.fetch_add(1, memory_order_relaxed);
+        } else if (delta > 1) {
+            gap = static_cast<uint32_t>(delta - 1);
+            sequence_gaps.fetch_add(1, memory_order_relaxed);
+            sequence_missing.fetch_add(gap, memory_order_relaxed);
+        }
+    }
+    last_sequence = counter;
+    has_sequence = true;
+
+    return gap;
+}
+
+void WarbleGattChar_Blepp::notify(const uint8_t* value, size_t len, uint64_t timestamp) {
+    auto gap = check_sequence(value, len);
+
+    if (notifications != nullptr) {
+        notifications->push(value, len, timestamp);
+    } else if (value_changed_ex_handler != nullptr) {
+        WarbleGattNotificationEvent event = { value, static_cast<uint16_t>(len), timestamp, gap };
+        value_changed_ex_handler(value_changed_context, this, &event);
+    } else if (value_changed_long_handler != nullptr) {
+        value_changed_long_handler(value_changed_context, this, value, static_cast<uint16_t>(len));
+    } else if (value_changed_handler != nullptr) {
+        // documented in gattchar.h, the legacy handler only sees the first 255 bytes
+        value_changed_handler(value_changed_context, this, value, static_cast<uint8_t>(min<size_t>(len, UINT8_MAX)));
+    }
 }
 
 const char* WarbleGattChar_Blepp::get_uuid() const {
@@ -0,0 +1,149 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_att.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace att {
+
+bool is_request(uint8_t opcode) {
+    switch(opcode) {
+    case MTU_REQ:
+    case FIND_INFO_REQ:
+    case FIND_BY_TYPE_REQ:
+    case READ_BY_TYPE_REQ:
+    case READ_REQ:
+    case READ_BLOB_REQ:
+    case READ_MULTI_REQ:
+    case READ_BY_GROUP_REQ:
+    case WRITE_REQ:
+    case PREP_WRITE_REQ:
+    case EXEC_WRITE_REQ:
+    case READ_MULTI_VAR_REQ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+string error_to_string(uint8_t code) {
+    static const char* names[] = {
+        "",
+        "Invalid handle",
+        "Read not permitted",
+        "Write not permitted",
+        "Invalid PDU",
+        "Insufficient authentication",
+        "Request not supported",
+        "Invalid offset",
+        "Insufficient authorization",
+        "Prepare queue full",
+        "Attribute not found",
+        "Attribute not long",
+        "Insufficient encryption key size",
+        "Invalid attribute value length",
+        "Unlikely error",
+        "Insufficient encryption",
+        "Unsupported group type",
+        "Insufficient resources",
+        "Database out of sync",
+        "Value not allowed"
+    };
+
+    char buffer[64];
+    if (code > 0 && code < sizeof(names) / sizeof(names[0])) {
+        snprintf(buffer, sizeof(buffer), "ATT error 0x%.2x: %s", code, names[code]);
+    } else {
+        snprintf(buffer, sizeof(buffer), "ATT error 0x%.2x", code);
+    }
+    return buffer;
+}
+
+size_t encode_mtu(uint8_t* pdu, uint8_t opcode, uint16_t mtu) {
+    pdu[0] = opcode;
+    put_le16(pdu + 1, mtu);
+    return 3;
+}
+
+static size_t encode_range(uint8_t* pdu, uint8_t opcode, uint16_t start, uint16_t end) {
+    pdu[0] = opcode;
+    put_le16(pdu + 1, start);
+    put_le16(pdu + 3, end);
+    return 5;
+}
+
+size_t encode_read_by_group_req(uint8_t* pdu, uint16_t start, uint16_t end, uint16_t uuid) {
+    size_t len = encode_range(pdu, READ_BY_GROUP_REQ, start, end);
+    put_le16(pdu + len, uuid);
+    return len + 2;
+}
+
+size_t encode_read_by_type_req(uint8_t* pdu, uint16_t start, uint16_t end, uint16_t uuid) {
+    size_t len = encode_range(pdu, READ_BY_TYPE_REQ, start, end);
+    put_le16(pdu + len, uuid);
+    return len + 2;
+}
+
+size_t encode_find_info_req(uint8_t* pdu, uint16_t start, uint16_t end) {
+    return encode_range(pdu, FIND_INFO_REQ, start, end);
+}
+
+size_t encode_read_req(uint8_t* pdu, uint16_t handle) {
+    pdu[0] = READ_REQ;
+    put_le16(pdu + 1, handle);
+    return 3;
+}
+
+size_t encode_read_blob_req(uint8_t* pdu, uint16_t handle, uint16_t offset) {
+    pdu[0] = READ_BLOB_REQ;
+    put_le16(pdu + 1, handle);
+    put_le16(pdu + 3, offset);
+    return 5;
+}
+
+size_t encode_read_multi_var_req(uint8_t* pdu, const uint16_t* handles, size_t nhandles) {
+    pdu[0] = READ_MULTI_VAR_REQ;
+    for(size_t i = 0; i < nhandles; i++) {
+        put_le16(pdu + 1 + 2 * i, handles[i]);
+    }
+    return 1 + 2 * nhandles;
+}
+
+size_t encode_write(uint8_t* pdu, uint8_t opcode, uint16_t handle, const uint8_t* value, size_t len) {
+    pdu[0] = opcode;
+    put_le16(pdu + 1, handle);
+    memcpy(pdu + 3, value, len);
+    return 3 + len;
+}
+
+size_t encode_prep_write_req(uint8_t* pdu, uint16_t handle, uint16_t offset, const uint8_t* value, size_t len) {
+    pdu[0] = PREP_WRITE_REQ;
+    put_le16(pdu + 1, handle);
+    put_le16(pdu + 3, offset);
+    memcpy(pdu + 5, value, len);
+    return 5 + len;
+}
+
+size_t encode_exec_write_req(uint8_t* pdu, uint8_t flags) {
+    pdu[0] = EXEC_WRITE_REQ;
+    pdu[1] = flags;
+    return 2;
+}
+
+size_t encode_error_rsp(uint8_t* pdu, uint8_t request, uint16_t handle, uint8_t code) {
+    pdu[0] = ERROR_RSP;
+    pdu[1] = request;
+    put_le16(pdu + 2, handle);
+    pdu[4] = code;
+    return 5;
+}
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Encoders and decoders for the ATT PDUs warble issues itself once libblepp has brought up the link
+ */
+namespace att {
+
+enum Opcode : std::uint8_t {
+    ERROR_RSP = 0x01,
+    MTU_REQ = 0x02,
+    MTU_RSP = 0x03,
+    FIND_INFO_REQ = 0x04,
+    FIND_INFO_RSP = 0x05,
+    FIND_BY_TYPE_REQ = 0x06,
+    FIND_BY_TYPE_RSP = 0x07,
+    READ_BY_TYPE_REQ = 0x08,
+    READ_BY_TYPE_RSP = 0x09,
+    READ_REQ = 0x0a,
+    READ_RSP = 0x0b,
+    READ_BLOB_REQ = 0x0c,
+    READ_BLOB_RSP = 0x0d,
+    READ_MULTI_REQ = 0x0e,
+    READ_MULTI_RSP = 0x0f,
+    READ_BY_GROUP_REQ = 0x10,
+    READ_BY_GROUP_RSP = 0x11,
+    WRITE_REQ = 0x12,
+    WRITE_RSP = 0x13,
+    PREP_WRITE_REQ = 0x16,
+    PREP_WRITE_RSP = 0x17,
+    EXEC_WRITE_REQ = 0x18,
+    EXEC_WRITE_RSP = 0x19,
+    HANDLE_NOTIFY = 0x1b,
+    HANDLE_IND = 0x1d,
+    HANDLE_CONF = 0x1e,
+    READ_MULTI_VAR_REQ = 0x20,
+    READ_MULTI_VAR_RSP = 0x21,
+    WRITE_CMD = 0x52,
+};
+
+enum ErrorCode : std::uint8_t {
+    INVALID_HANDLE = 0x01,
+    REQUEST_NOT_SUPPORTED = 0x06,
+    INVALID_OFFSET = 0x07,
+    ATTRIBUTE_NOT_FOUND = 0x0a,
+    ATTRIBUTE_NOT_LONG = 0x0b,
+};
+
+const std::uint16_t DEFAULT_LE_MTU = 23;
+// Largest PDU a peer may send, 512 byte attribute value plus the 5 byte prepare write header
+const std::size_t MAX_PDU_LEN = 517;
+const std::size_t MAX_ATTR_LEN = 512;
+
+const std::uint8_t EXEC_WRITE_CANCEL = 0x00;
+const std::uint8_t EXEC_WRITE_COMMIT = 0x01;
+
+const std::uint16_t PRIMARY_SERVICE_UUID = 0x2800;
+const std::uint16_t CHARACTERISTIC_UUID = 0x2803;
+const std::uint16_t CCCD_UUID = 0x2902;
+const std::uint16_t SERVICE_CHANGED_UUID = 0x2a05;
+const std::uint16_t DATABASE_HASH_UUID = 0x2b2a;
+
+const std::uint8_t PROP_NOTIFY = 0x10;
+const std::uint8_t PROP_INDICATE = 0x20;
+
+const std::uint16_t CCCD_NOTIFY = 0x0001;
+const std::uint16_t CCCD_INDICATE = 0x0002;
+
+inline std::uint16_t get_le16(const std::uint8_t* src) {
+    return static_cast<std::uint16_t>(src[0] | (src[1] << 8));
+}
+
+inline void put_le16(std::uint8_t* dest, std::uint16_t value) {
+    dest[0] = value & 0xff;
+    dest[1] = (value >> 8) & 0xff;
+}
+
+/**
+ * Returns true if the opcode is a request the remote side expects a response for
+ */
+bool is_request(std::uint8_t opcode);
+/**
+ * Human readable form of an ATT error code
+ */
+std::string error_to_string(std::uint8_t code);
+
+// Each encoder writes into `pdu` and returns the PDU length
+std::size_t encode_mtu(std::uint8_t* pdu, std::uint8_t opcode, std::uint16_t mtu);
+std::size_t encode_read_by_group_req(std::uint8_t* pdu, std::uint16_t start, std::uint16_t end, std::uint16_t uuid);
+std::size_t encode_read_by_type_req(std::uint8_t* pdu, std::uint16_t start, std::uint16_t end, std::uint16_t uuid);
+std::size_t encode_find_info_req(std::uint8_t* pdu, std::uint16_t start, std::uint16_t end);
+std::size_t encode_read_req(std::uint8_t* pdu, std::uint16_t handle);
+std::size_t encode_read_blob_req(std::uint8_t* pdu, std::uint16_t handle, std::uint16_t offset);
+std::size_t encode_read_multi_var_req(std::uint8_t* pdu, const std::uint16_t* handles, std::size_t nhandles);
+std::size_t encode_write(std::uint8_t* pdu, std::uint8_t opcode, std::uint16_t handle, const std::uint8_t* value, std::size_t len);
+std::size_t encode_prep_write_req(std::uint8_t* pdu, std::uint16_t handle, std::uint16_t offset, const std::uint8_t* value, std::size_t len);
+std::size_t encode_exec_write_req(std::uint8_t* pdu, std::uint8_t flags);
+std::size_t encode_error_rsp(std::uint8_t* pdu, std::uint8_t request, std::uint16_t handle, std::uint8_t code);
+
+}
+
+#endif
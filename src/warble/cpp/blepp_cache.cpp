@@ -0,0 +1,181 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_cache.h"
+#include "blepp_att.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+const uint8_t MAGIC[] = { 'W', 'G', 'C', 0x02 };
+
+mutex cache_mutex;
+string cache_dir;
+
+string cache_path(const string& mac) {
+    string name;
+    for(char c: mac) {
+        if (c != ':') {
+            name += static_cast<char>(toupper(c));
+        }
+    }
+
+    lock_guard<mutex> lock(cache_mutex);
+    return cache_dir + "/" + name + ".gatt";
+}
+
+void put_uuid(vector<uint8_t>& buffer, const Uuid128& uuid) {
+    uint8_t raw[16];
+    uuid.to_att(raw);
+    buffer.insert(buffer.end(), raw, raw + sizeof(raw));
+}
+
+void put_u16(vector<uint8_t>& buffer, uint16_t value) {
+    uint8_t raw[2];
+    att::put_le16(raw, value);
+    buffer.insert(buffer.end(), raw, raw + sizeof(raw));
+}
+
+/**
+ * Bounds checked reader over the file contents
+ */
+struct Reader {
+    const vector<uint8_t>& buffer;
+    size_t pos;
+
+    bool has(size_t n) const {
+        return buffer.size() - pos >= n;
+    }
+
+    uint8_t u8() {
+        return buffer[pos++];
+    }
+
+    uint16_t u16() {
+        uint16_t value = att::get_le16(buffer.data() + pos);
+        pos += 2;
+        return value;
+    }
+
+    Uuid128 uuid() {
+        auto value = Uuid128::from_att(buffer.data() + pos, 16);
+        pos += 16;
+        return value;
+    }
+};
+
+}
+
+void gatt_cache::configure(const string& directory) {
+    if (!directory.empty()) {
+        // errors surface later as cache misses, e.g. if the parent directory does not exist
+        mkdir(directory.c_str(), 0755);
+    }
+
+    lock_guard<mutex> lock(cache_mutex);
+    cache_dir = directory;
+}
+
+bool gatt_cache::enabled() {
+    lock_guard<mutex> lock(cache_mutex);
+    return !cache_dir.empty();
+}
+
+bool gatt_cache::load(const string& mac, GattCacheEntry& entry) {
+    ifstream file(cache_path(mac), ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    vector<uint8_t> buffer((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    Reader reader = { buffer, 0 };
+
+    // layout: magic, hash length, hash, service count, then each service followed by its characteristics
+    if (!reader.has(sizeof(MAGIC) + 1) || !equal(MAGIC, MAGIC + sizeof(MAGIC), buffer.begin())) {
+        return false;
+    }
+    reader.pos = sizeof(MAGIC);
+
+    size_t hash_len = reader.u8();
+    if (!reader.has(hash_len + 2)) {
+        return false;
+    }
+    entry.db_hash.assign(buffer.begin() + reader.pos, buffer.begin() + reader.pos + hash_len);
+    reader.pos += hash_len;
+
+    entry.services.resize(reader.u16());
+    for(auto& service: entry.services) {
+        if (!reader.has(23)) {
+            return false;
+        }
+        service.start_handle = reader.u16();
+        service.end_handle = reader.u16();
+        service.uuid = reader.uuid();
+        service.discovered = reader.u8() != 0;
+
+        service.characteristics.resize(reader.u16());
+        for(auto& info: service.characteristics) {
+            if (!reader.has(23)) {
+                return false;
+            }
+            info.decl_handle = reader.u16();
+            info.value_handle = reader.u16();
+            info.cccd_handle = reader.u16();
+            info.properties = reader.u8();
+            info.uuid = reader.uuid();
+        }
+    }
+
+    return reader.pos == buffer.size();
+}
+
+void gatt_cache::store(const string& mac, const GattCacheEntry& entry) {
+    vector<uint8_t> buffer(MAGIC, MAGIC + sizeof(MAGIC));
+
+    buffer.push_back(static_cast<uint8_t>(entry.db_hash.size()));
+    buffer.insert(buffer.end(), entry.db_hash.begin(), entry.db_hash.end());
+
+    put_u16(buffer, static_cast<uint16_t>(entry.services.size()));
+    for(auto& service: entry.services) {
+        put_u16(buffer, service.start_handle);
+        put_u16(buffer, service.end_handle);
+        put_uuid(buffer, service.uuid);
+        buffer.push_back(service.discovered ? 1 : 0);
+
+        put_u16(buffer, static_cast<uint16_t>(service.characteristics.size()));
+        for(auto& info: service.characteristics) {
+            put_u16(buffer, info.decl_handle);
+            put_u16(buffer, info.value_handle);
+            put_u16(buffer, info.cccd_handle);
+            buffer.push_back(info.properties);
+            put_uuid(buffer, info.uuid);
+        }
+    }
+
+    // write then rename so a concurrent load never sees a partial file
+    string path = cache_path(mac), tmp_path = path + ".tmp";
+    {
+        ofstream file(tmp_path, ios::binary | ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size())) {
+            return;
+        }
+    }
+    rename(tmp_path.c_str(), path.c_str());
+}
+
+void gatt_cache::remove(const string& mac) {
+    std::remove(cache_path(mac).c_str());
+}
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "blepp_discovery.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Attribute table of a remote device as it was last discovered
+ */
+struct GattCacheEntry {
+    // contents of the Database Hash characteristic, empty if the device does not have one
+    std::vector<std::uint8_t> db_hash;
+    std::vector<GattServiceInfo> services;
+};
+
+/**
+ * On-disk cache of discovered attribute tables, one compact binary file per remote device
+ */
+namespace gatt_cache {
+    /**
+     * Sets the directory cache files are kept in, an empty string disables the cache
+     */
+    void configure(const std::string& directory);
+    bool enabled();
+
+    bool load(const std::string& mac, GattCacheEntry& entry);
+    void store(const std::string& mac, const GattCacheEntry& entry);
+    void remove(const std::string& mac);
+}
+
+#endif
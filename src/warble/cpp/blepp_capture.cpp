@@ -0,0 +1,231 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_capture.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const uint32_t DATALINK_H4 = 1002;
+// btsnoop timestamps count microseconds from midnight, January 1st, 0 AD
+const uint64_t EPOCH_OFFSET_US = 0x00dcddb30f2f8000ULL;
+// packet flags
+const uint32_t FLAG_RECEIVED = 0x1, FLAG_COMMAND_EVENT = 0x2;
+const uint8_t H4_ACL = 0x02, H4_EVENT = 0x04;
+const uint8_t EVT_DISCONN_COMPLETE = 0x05, EVT_LE_META = 0x3e, LE_CONN_COMPLETE = 0x01;
+const uint8_t REMOTE_USER_TERMINATED = 0x13, LOCAL_HOST_TERMINATED = 0x16;
+const uint16_t ATT_CID = 0x0004;
+
+// the writer is woken early once this much is waiting, packets are dropped past the hard limit
+const size_t FLUSH_THRESHOLD = 64 * 1024, MAX_PENDING = 8 * 1024 * 1024;
+const milliseconds FLUSH_INTERVAL(500);
+
+void put_be32(vector<uint8_t>& buffer, uint32_t value) {
+    for(int shift = 24; shift >= 0; shift -= 8) {
+        buffer.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void put_be64(vector<uint8_t>& buffer, uint64_t value) {
+    put_be32(buffer, static_cast<uint32_t>(value >> 32));
+    put_be32(buffer, static_cast<uint32_t>(value));
+}
+
+class Writer {
+public:
+    Writer(FILE* file) : file(file), drops(0), stopping(false) {
+        thread th([this]() { run(); });
+        swap(worker, th);
+    }
+
+    ~Writer() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+
+        fclose(file);
+    }
+
+    // `head` is the H4 framing written ahead of the payload
+    void record(uint32_t flags, const uint8_t* head, size_t head_len, const uint8_t* payload, size_t payload_len) {
+        auto now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+        auto len = static_cast<uint32_t>(head_len + payload_len);
+
+        bool flush;
+        {
+            lock_guard<mutex> lock(m);
+            if (pending.size() + 24 + len > MAX_PENDING) {
+                drops++;
+                return;
+            }
+
+            // original length, included length, flags, cumulative drops, timestamp
+            put_be32(pending, len);
+            put_be32(pending, len);
+            put_be32(pending, flags);
+            put_be32(pending, drops);
+            put_be64(pending, static_cast<uint64_t>(now) + EPOCH_OFFSET_US);
+            pending.insert(pending.end(), head, head + head_len);
+            pending.insert(pending.end(), payload, payload + payload_len);
+
+            flush = pending.size() >= FLUSH_THRESHOLD;
+        }
+
+        if (flush) {
+            wake.notify_one();
+        }
+    }
+
+private:
+    void run() {
+        vector<uint8_t> writing;
+        bool done;
+        do {
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait_for(lock, FLUSH_INTERVAL, [this]() { return stopping || pending.size() >= FLUSH_THRESHOLD; });
+                done = stopping;
+                swap(writing, pending);
+            }
+
+            if (!writing.empty()) {
+                fwrite(writing.data(), 1, writing.size(), file);
+                fflush(file);
+                writing.clear();
+            }
+        } while(!done);
+    }
+
+    FILE* file;
+    thread worker;
+
+    mutex m;
+    condition_variable wake;
+    vector<uint8_t> pending;
+    uint32_t drops;
+    bool stopping;
+};
+
+mutex writer_mutex;
+shared_ptr<Writer> writer;
+// checked before anything else so capturing costs a single load while it is off
+atomic<bool> capturing(false);
+
+shared_ptr<Writer> current() {
+    lock_guard<mutex> lock(writer_mutex);
+    return writer;
+}
+
+}
+
+void btsnoop::configure(const string& path) {
+    shared_ptr<Writer> replacement;
+    if (!path.empty()) {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            throw runtime_error("cannot open capture file '" + path + "' (" + strerror(errno) + ")");
+        }
+
+        vector<uint8_t> header = { 'b', 't', 's', 'n', 'o', 'o', 'p', '\0' };
+        put_be32(header, 1);
+        put_be32(header, DATALINK_H4);
+        fwrite(header.data(), 1, header.size(), file);
+
+        replacement = make_shared<Writer>(file);
+    }
+
+    shared_ptr<Writer> previous;
+    {
+        lock_guard<mutex> lock(writer_mutex);
+        previous = writer;
+        writer = replacement;
+        capturing = replacement != nullptr;
+    }
+    // the old file is flushed and closed once the last thread recording into it lets go
+}
+
+bool btsnoop::enabled() {
+    return capturing.load(memory_order_relaxed);
+}
+
+void btsnoop::att(uint16_t hci_handle, bool received, const uint8_t* pdu, size_t len) {
+    if (!enabled()) {
+        return;
+    }
+
+    auto target = current();
+    if (target != nullptr) {
+        // ACL header (handle and start of packet boundary flag, length), then the L2CAP basic header
+        auto l2cap_len = static_cast<uint16_t>(len), acl_len = static_cast<uint16_t>(len + 4);
+        uint16_t handle_flags = static_cast<uint16_t>((hci_handle & 0x0fff) | (received ? 0x2000 : 0x0000));
+        const uint8_t head[] = {
+            H4_ACL,
+            static_cast<uint8_t>(handle_flags), static_cast<uint8_t>(handle_flags >> 8),
+            static_cast<uint8_t>(acl_len), static_cast<uint8_t>(acl_len >> 8),
+            static_cast<uint8_t>(l2cap_len), static_cast<uint8_t>(l2cap_len >> 8),
+            static_cast<uint8_t>(ATT_CID), static_cast<uint8_t>(ATT_CID >> 8)
+        };
+        target->record(received ? FLAG_RECEIVED : 0, head, sizeof(head), pdu, len);
+    }
+}
+
+void btsnoop::hci_event(const uint8_t* packet, size_t len) {
+    if (!enabled()) {
+        return;
+    }
+
+    auto target = current();
+    if (target != nullptr) {
+        target->record(FLAG_RECEIVED | FLAG_COMMAND_EVENT, nullptr, 0, packet, len);
+    }
+}
+
+void btsnoop::connection(uint16_t hci_handle, const string& mac, bool public_addr) {
+    if (!enabled()) {
+        return;
+    }
+
+    // subevent, status, handle, central role, address type, address, then interval, latency, timeout, and clock accuracy left at 0
+    uint8_t packet[22] = { H4_EVENT, EVT_LE_META, 19, LE_CONN_COMPLETE, 0x00, 
+            static_cast<uint8_t>(hci_handle), static_cast<uint8_t>(hci_handle >> 8), 0x00, static_cast<uint8_t>(public_addr ? 0x00 : 0x01) };
+    // address is sent least significant byte first
+    const char* pos = mac.c_str();
+    for(int i = 5; i >= 0 && *pos != '\0'; i--) {
+        char* end;
+        packet[9 + i] = static_cast<uint8_t>(strtoul(pos, &end, 16));
+        pos = *end == ':' ? end + 1 : end;
+    }
+    hci_event(packet, sizeof(packet));
+}
+
+void btsnoop::disconnection(uint16_t hci_handle, bool local) {
+    if (!enabled()) {
+        return;
+    }
+
+    const uint8_t packet[] = { H4_EVENT, EVT_DISCONN_COMPLETE, 4, 0x00, 
+            static_cast<uint8_t>(hci_handle), static_cast<uint8_t>(hci_handle >> 8), local ? LOCAL_HOST_TERMINATED : REMOTE_USER_TERMINATED };
+    hci_event(packet, sizeof(packet));
+}
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Writes the traffic warble handles to a btsnoop file (H4 datalink) that Wireshark and btmon can open.  Callers 
+ * only copy the packet into a memory buffer, a background thread does the file writes
+ */
+namespace btsnoop {
+    /**
+     * Starts capturing to a new file, an empty path stops capturing.  Throws runtime_error if the file cannot be created
+     */
+    void configure(const std::string& path);
+    bool enabled();
+
+    /**
+     * Records an ATT PDU, framed as an ACL packet on the fixed ATT channel of the given HCI connection handle
+     */
+    void att(std::uint16_t hci_handle, bool received, const std::uint8_t* pdu, std::size_t len);
+    /**
+     * Records an HCI event as read from a raw HCI socket, starting with the packet type byte
+     */
+    void hci_event(const std::uint8_t* packet, std::size_t len);
+    /**
+     * Records an LE Connection Complete event for a link warble brought up, the controller's own event is not 
+     * visible on the L2CAP socket
+     */
+    void connection(std::uint16_t hci_handle, const std::string& mac, bool public_addr);
+    /**
+     * Records a Disconnection Complete event, with the reason set to a local or remote termination
+     */
+    void disconnection(std::uint16_t hci_handle, bool local);
+}
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_discovery.h"
+#include "blepp_att.h"
+#include "error_messages.h"
+
+using namespace std;
+
+GattDiscovery::GattDiscovery(function<bool(const Uuid128&)> walk) : walk(walk), stage(SERVICES), sent_opcode(0), next_handle(0x0001), range_end(0xffff), 
+        pending_idx(0), char_idx(0) {
+}
+
+GattDiscovery::GattDiscovery(vector<GattServiceInfo> services, vector<size_t> pending) : services(move(services)), stage(CHARACTERISTICS), sent_opcode(0), 
+        next_handle(1), range_end(0), pending(move(pending)), pending_idx(0), char_idx(0) {
+    for(auto i: this->pending) {
+        this->services[i].discovered = true;
+        this->services[i].characteristics.clear();
+    }
+    enter_range();
+}
+
+size_t GattDiscovery::next_request(uint8_t* pdu) {
+    while(next_handle > range_end) {
+        if (!next_range()) {
+            return 0;
+        }
+    }
+
+    size_t len;
+    auto start = static_cast<uint16_t>(next_handle), end = static_cast<uint16_t>(range_end);
+    switch(stage) {
+    case SERVICES:
+        len = att::encode_read_by_group_req(pdu, start, end, att::PRIMARY_SERVICE_UUID);
+        break;
+    case CHARACTERISTICS:
+        len = att::encode_read_by_type_req(pdu, start, end, att::CHARACTERISTIC_UUID);
+        break;
+    default:
+        len = att::encode_find_info_req(pdu, start, end);
+        break;
+    }
+
+    sent_opcode = pdu[0];
+    return len;
+}
+
+bool GattDiscovery::next_range() {
+    switch(stage) {
+    case SERVICES:
+        for(size_t i = 0; i < services.size(); i++) {
+            if (services[i].discovered) {
+                pending.push_back(i);
+            }
+        }
+        stage = CHARACTERISTICS;
+        pending_idx = 0;
+        break;
+    case CHARACTERISTICS:
+        pending_idx++;
+        break;
+    case DESCRIPTORS:
+        char_idx++;
+        break;
+    default:
+        return false;
+    }
+
+    return enter_range();
+}
+
+bool GattDiscovery::enter_range() {
+    if (stage == CHARACTERISTICS) {
+        if (pending_idx < pending.size()) {
+            next_handle = services[pending[pending_idx]].start_handle;
+            range_end = services[pending[pending_idx]].end_handle;
+            return true;
+        }
+
+        stage = DESCRIPTORS;
+        pending_idx = 0;
+        char_idx = 0;
+    }
+
+    // descriptors sit between a characteristic's value and the next declaration, only the CCCD is of interest
+    for(; pending_idx < pending.size(); pending_idx++, char_idx = 0) {
+        auto& service = services[pending[pending_idx]];
+        auto& chars = service.characteristics;
+        for(; char_idx < chars.size(); char_idx++) {
+            if (chars[char_idx].properties & (att::PROP_NOTIFY | att::PROP_INDICATE)) {
+                next_handle = chars[char_idx].value_handle + 1u;
+                range_end = char_idx + 1 < chars.size() ? chars[char_idx + 1].decl_handle - 1u : service.end_handle;
+                return true;
+            }
+        }
+    }
+
+    stage = DONE;
+    return false;
+}
+
+bool GattDiscovery::process_response(const uint8_t* pdu, size_t len) {
+    if (pdu[0] == att::ERROR_RSP) {
+        if (len < 5 || pdu[1] != sent_opcode) {
+            error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+            return false;
+        }
+        // nothing left in the range
+        if (pdu[4] == att::ATTRIBUTE_NOT_FOUND) {
+            next_handle = range_end + 1;
+            return true;
+        }
+
+        error = att::error_to_string(pdu[4]);
+        return false;
+    }
+
+    if (pdu[0] != sent_opcode + 1) {
+        error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+        return false;
+    }
+
+    bool valid;
+    switch(stage) {
+    case SERVICES:
+        valid = parse_services(pdu, len);
+        break;
+    case CHARACTERISTICS:
+        valid = parse_characteristics(pdu, len);
+        break;
+    default:
+        valid = parse_descriptors(pdu, len);
+        break;
+    }
+
+    if (!valid) {
+        error = WARBLE_GATT_UNEXPECTED_RESPONSE;
+    }
+    return valid;
+}
+
+bool GattDiscovery::parse_services(const uint8_t* pdu, size_t len) {
+    // opcode, entry length, then (start handle, end handle, uuid) entries
+    size_t entry_len = len >= 2 ? pdu[1] : 0;
+    if ((entry_len != 6 && entry_len != 20) || len < 2 + entry_len || (len - 2) % entry_len) {
+        return false;
+    }
+
+    for(size_t i = 2; i < len; i += entry_len) {
+        GattServiceInfo service;
+        service.start_handle = att::get_le16(pdu + i);
+        service.end_handle = att::get_le16(pdu + i + 2);
+        service.uuid = Uuid128::from_att(pdu + i + 4, entry_len - 4);
+        service.discovered = !walk || walk(service.uuid);
+
+        if (service.start_handle < next_handle || service.end_handle < service.start_handle) {
+            return false;
+        }
+        next_handle = service.end_handle + 1u;
+        services.push_back(move(service));
+    }
+    return true;
+}
+
+bool GattDiscovery::parse_characteristics(const uint8_t* pdu, size_t len) {
+    // opcode, entry length, then (declaration handle, properties, value handle, uuid) entries
+    size_t entry_len = len >= 2 ? pdu[1] : 0;
+    if ((entry_len != 7 && entry_len != 21) || len < 2 + entry_len || (len - 2) % entry_len) {
+        return false;
+    }
+
+    auto& chars = services[pending[pending_idx]].characteristics;
+    for(size_t i = 2; i < len; i += entry_len) {
+        GattCharacteristicInfo info;
+        info.decl_handle = att::get_le16(pdu + i);
+        info.properties = pdu[i + 2];
+        info.value_handle = att::get_le16(pdu + i + 3);
+        info.cccd_handle = 0;
+        info.uuid = Uuid128::from_att(pdu + i + 5, entry_len - 5);
+
+        if (info.decl_handle < next_handle || info.decl_handle > range_end) {
+            return false;
+        }
+        next_handle = info.decl_handle + 1u;
+        chars.push_back(move(info));
+    }
+    return true;
+}
+
+bool GattDiscovery::parse_descriptors(const uint8_t* pdu, size_t len) {
+    // opcode, format (1 = 16-bit uuids, 2 = 128-bit uuids), then (handle, uuid) entries
+    size_t entry_len = len < 2 ? 0 : (pdu[1] == 1 ? 4 : (pdu[1] == 2 ? 18 : 0));
+    if (entry_len == 0 || len < 2 + entry_len || (len - 2) % entry_len) {
+        return false;
+    }
+
+    auto& info = services[pending[pending_idx]].characteristics[char_idx];
+    for(size_t i = 2; i < len; i += entry_len) {
+        uint16_t handle = att::get_le16(pdu + i);
+        if (handle < next_handle) {
+            return false;
+        }
+
+        next_handle = handle + 1u;
+        if (entry_len == 4 && att::get_le16(pdu + i + 2) == att::CCCD_UUID) {
+            info.cccd_handle = handle;
+            // skip any remaining descriptors
+            next_handle = range_end + 1;
+            break;
+        }
+    }
+    return true;
+}
+
+#endif
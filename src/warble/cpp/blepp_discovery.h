@@ -0,0 +1,84 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "uuid128.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct GattCharacteristicInfo {
+    std::uint16_t decl_handle, value_handle, cccd_handle;
+    std::uint8_t properties;
+    Uuid128 uuid;
+};
+
+struct GattServiceInfo {
+    std::uint16_t start_handle, end_handle;
+    Uuid128 uuid;
+    // characteristics have been walked, services skipped by a discovery filter only have their handle range
+    bool discovered;
+    std::vector<GattCharacteristicInfo> characteristics;
+};
+
+/**
+ * Walks the remote attribute table one request at a time: primary services, then the characteristics of each
+ * selected service, then the descriptors of characteristics that can notify or indicate to find their CCCD
+ */
+class GattDiscovery {
+public:
+    /**
+     * Discovers every primary service and walks those `walk` returns true for, or all of them if it is empty
+     */
+    GattDiscovery(std::function<bool(const Uuid128&)> walk = nullptr);
+    /**
+     * Skips service discovery and walks the services at the `pending` indices of an already known service list
+     */
+    GattDiscovery(std::vector<GattServiceInfo> services, std::vector<std::size_t> pending);
+
+    /**
+     * Writes the next request into pdu, returns its length or 0 once every service has been discovered
+     */
+    std::size_t next_request(std::uint8_t* pdu);
+    /**
+     * Consumes the response to the last request.  Returns false and sets `error` if the response was rejected
+     * or malformed
+     */
+    bool process_response(const std::uint8_t* pdu, std::size_t len);
+
+    std::vector<GattServiceInfo> services;
+    std::string error;
+
+private:
+    enum Stage {
+        SERVICES,
+        CHARACTERISTICS,
+        DESCRIPTORS,
+        DONE
+    };
+
+    // Moves to the next handle range to search, returns false once discovery is complete
+    bool next_range();
+    // Sets the range for the current characteristic or descriptor search, skipping services and characteristics with nothing to look for
+    bool enter_range();
+    bool parse_services(const std::uint8_t* pdu, std::size_t len);
+    bool parse_characteristics(const std::uint8_t* pdu, std::size_t len);
+    bool parse_descriptors(const std::uint8_t* pdu, std::size_t len);
+
+    std::function<bool(const Uuid128&)> walk;
+    Stage stage;
+    std::uint8_t sent_opcode;
+    // 32-bit so a range ending at 0xffff terminates instead of wrapping
+    std::uint32_t next_handle, range_end;
+    // indices of the services whose characteristics are walked
+    std::vector<std::size_t> pending;
+    std::size_t pending_idx, char_idx;
+};
+
+#endif
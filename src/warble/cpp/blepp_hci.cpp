@@ -0,0 +1,296 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_hci.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+#include <bluetooth/l2cap.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+#ifndef HCI_CHANNEL_CONTROL
+#define HCI_CHANNEL_CONTROL 3
+#endif
+
+namespace {
+
+// bluetooth management api, see doc/mgmt-api.txt in the bluez tree
+const uint16_t MGMT_EV_CMD_COMPLETE = 0x0001, MGMT_EV_CMD_STATUS = 0x0002, 
+        MGMT_OP_SET_DEF_SYSTEM_CONFIG = 0x004c;
+const uint16_t MGMT_CONFIG_LE_SCAN_INTERVAL_CONN = 0x0015, MGMT_CONFIG_LE_SCAN_WINDOW_CONN = 0x0016;
+const uint8_t MGMT_STATUS_SUCCESS = 0x00;
+const char* const MGMT_STATUS_STRINGS[] = {
+    "Success", "Unknown Command", "Not Connected", "Failed", "Connect Failed", "Authentication Failed", "Not Paired", 
+    "No Resources", "Timeout", "Already Connected", "Busy", "Rejected", "Not Supported", "Invalid Parameters", 
+    "Disconnected", "Not Powered", "Cancelled", "Invalid Index", "RFKilled", "Already Paired", "Permission Denied"
+};
+
+mutex pool_mutex;
+size_t max_links = 0;
+// ordered so ties go to the same adapter every time
+map<string, size_t> counts;
+
+string normalize(const string& mac) {
+    string key(mac);
+    transform(key.begin(), key.end(), key.begin(), [](char c) { return static_cast<char>(toupper(c)); });
+    return key;
+}
+
+inline void put_le16(uint8_t* dest, uint16_t value) {
+    dest[0] = static_cast<uint8_t>(value);
+    dest[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline uint16_t get_le16(const uint8_t* src) {
+    return static_cast<uint16_t>(src[0] | (src[1] << 8));
+}
+
+int resolve_dev_id(const string& adapter) {
+    return adapter.empty() ? hci_get_route(nullptr) : hci_devid(adapter.c_str());
+}
+
+// Sends a command on the management control channel and waits for its command complete or status event
+string mgmt_send(uint16_t opcode, uint16_t index, const uint8_t* params, uint16_t len) {
+    int sock = socket(PF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+    if (sock < 0) {
+        return strerror(errno);
+    }
+
+    sockaddr_hci addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.hci_family = AF_BLUETOOTH;
+    addr.hci_dev = HCI_DEV_NONE;
+    addr.hci_channel = HCI_CHANNEL_CONTROL;
+
+    // header is opcode, controller index, parameter length
+    vector<uint8_t> packet(6 + len);
+    put_le16(&packet[0], opcode);
+    put_le16(&packet[2], index);
+    put_le16(&packet[4], len);
+    copy(params, params + len, packet.begin() + 6);
+
+    string error;
+    if (::bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || 
+            write(sock, packet.data(), packet.size()) != static_cast<ssize_t>(packet.size())) {
+        error = strerror(errno);
+    } else {
+        // the channel carries events for every controller, skip ahead to the reply for this command
+        uint8_t event[512];
+        pollfd fds = { sock, POLLIN, 0 };
+        while(true) {
+            int status = poll(&fds, 1, 1000);
+            if (status <= 0) {
+                error = status == 0 ? strerror(ETIMEDOUT) : strerror(errno);
+                break;
+            }
+
+            ssize_t n = read(sock, event, sizeof(event));
+            if (n < 0) {
+                error = strerror(errno);
+                break;
+            }
+
+            uint16_t code = n >= 9 ? get_le16(event) : 0;
+            if ((code == MGMT_EV_CMD_COMPLETE || code == MGMT_EV_CMD_STATUS) && get_le16(event + 2) == index && 
+                    get_le16(event + 6) == opcode) {
+                uint8_t result = event[8];
+                if (result != MGMT_STATUS_SUCCESS) {
+                    error = result < sizeof(MGMT_STATUS_STRINGS) / sizeof(MGMT_STATUS_STRINGS[0]) ? 
+                            MGMT_STATUS_STRINGS[result] : "Unknown management status";
+                }
+                break;
+            }
+        }
+    }
+
+    close(sock);
+    return error;
+}
+
+// Adapter with the fewest links that is under the limit and not excluded, pool_mutex must be held
+string pick(const vector<string>& adapters, const vector<string>& excluded) {
+    string best;
+    size_t best_count = SIZE_MAX;
+    for(auto& it: adapters) {
+        auto key = normalize(it);
+        auto count = counts[key];
+        if ((max_links == 0 || count < max_links) && count < best_count && find(excluded.begin(), excluded.end(), key) == excluded.end()) {
+            best = key;
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+int collect_adapter(int sock, int dev_id, long arg) {
+    hci_dev_info info;
+    if (hci_devinfo(dev_id, &info) == 0) {
+        char addr[18];
+        ba2str(&info.bdaddr, addr);
+        reinterpret_cast<vector<string>*>(arg)->push_back(addr);
+    }
+    // keep iterating
+    return 0;
+}
+
+}
+
+void hci_pool::configure(size_t limit) {
+    lock_guard<mutex> lock(pool_mutex);
+    max_links = limit;
+}
+
+vector<string> hci_pool::available() {
+    vector<string> adapters;
+    hci_for_each_dev(HCI_UP, collect_adapter, reinterpret_cast<long>(&adapters));
+    return adapters;
+}
+
+string hci_pool::least_loaded(const vector<string>& candidates, const vector<string>& excluded) {
+    auto adapters = candidates.empty() ? available() : candidates;
+
+    lock_guard<mutex> lock(pool_mutex);
+    return pick(adapters, excluded);
+}
+
+string hci_pool::acquire(const vector<string>& candidates) {
+    auto adapters = candidates.empty() ? available() : candidates;
+
+    lock_guard<mutex> lock(pool_mutex);
+    auto best = pick(adapters, {});
+    if (!best.empty()) {
+        counts[best]++;
+    }
+    return best;
+}
+
+string hci_pool::key(const string& mac) {
+    if (!mac.empty()) {
+        return normalize(mac);
+    }
+
+    hci_dev_info info;
+    int dev_id = hci_get_route(nullptr);
+    if (dev_id < 0 || hci_devinfo(dev_id, &info) != 0) {
+        return "";
+    }
+
+    char addr[18];
+    ba2str(&info.bdaddr, addr);
+    return addr;
+}
+
+string hci_pool::retain(const string& mac) {
+    auto key = hci_pool::key(mac);
+
+    lock_guard<mutex> lock(pool_mutex);
+    counts[key]++;
+    return key;
+}
+
+void hci_pool::release(const string& mac) {
+    lock_guard<mutex> lock(pool_mutex);
+    auto it = counts.find(mac);
+    if (it != counts.end() && it->second > 0) {
+        it->second--;
+    }
+}
+
+vector<pair<string, size_t>> hci_pool::links() {
+    auto adapters = available();
+
+    lock_guard<mutex> lock(pool_mutex);
+    for(auto& it: adapters) {
+        counts.emplace(normalize(it), 0);
+    }
+
+    vector<pair<string, size_t>> result;
+    for(auto& it: counts) {
+        if (!it.first.empty()) {
+            result.emplace_back(it.first, it.second);
+        }
+    }
+    return result;
+}
+
+int hci_link::connection_handle(int l2cap_sock) {
+    l2cap_conninfo info;
+    socklen_t len = sizeof(info);
+    return getsockopt(l2cap_sock, SOL_L2CAP, L2CAP_CONNINFO, &info, &len) < 0 ? -1 : info.hci_handle;
+}
+
+string hci_link::update_params(const string& adapter, uint16_t handle, const HciConnParams& params) {
+    int dev_id = resolve_dev_id(adapter);
+    int dd;
+    if (dev_id < 0 || (dd = hci_open_dev(dev_id)) < 0) {
+        return strerror(errno);
+    }
+
+    // returns once the controller reports the command status, the new parameters apply a few connection events later
+    string error;
+    if (hci_le_conn_update(dd, handle, params.min_interval, params.max_interval, params.latency, params.supervision_timeout, 1000) < 0) {
+        error = strerror(errno);
+    }
+    hci_close_dev(dd);
+    return error;
+}
+
+string hci_link::send_params(const string& adapter, uint16_t handle, const HciConnParams& params) {
+    int dev_id = resolve_dev_id(adapter);
+    int dd;
+    if (dev_id < 0 || (dd = hci_open_dev(dev_id)) < 0) {
+        return strerror(errno);
+    }
+
+    // same values hci_le_conn_update sends, without waiting on the command status
+    le_connection_update_cp cp;
+    memset(&cp, 0, sizeof(cp));
+    cp.handle = htobs(handle);
+    cp.min_interval = htobs(params.min_interval);
+    cp.max_interval = htobs(params.max_interval);
+    cp.latency = htobs(params.latency);
+    cp.supervision_timeout = htobs(params.supervision_timeout);
+    cp.min_ce_length = htobs(1);
+    cp.max_ce_length = htobs(1);
+
+    string error;
+    if (hci_send_cmd(dd, OGF_LE_CTL, OCF_LE_CONN_UPDATE, LE_CONNECTION_UPDATE_CP_SIZE, &cp) < 0) {
+        error = strerror(errno);
+    }
+    hci_close_dev(dd);
+    return error;
+}
+
+string hci_link::set_connect_scan(const string& adapter, uint16_t interval, uint16_t window) {
+    int dev_id = resolve_dev_id(adapter);
+    if (dev_id < 0) {
+        return strerror(errno);
+    }
+
+    // two (type, length, value) entries
+    uint8_t params[10];
+    put_le16(params, MGMT_CONFIG_LE_SCAN_INTERVAL_CONN);
+    params[2] = 2;
+    put_le16(params + 3, interval);
+    put_le16(params + 5, MGMT_CONFIG_LE_SCAN_WINDOW_CONN);
+    params[7] = 2;
+    put_le16(params + 8, window);
+
+    return mgmt_send(MGMT_OP_SET_DEF_SYSTEM_CONFIG, static_cast<uint16_t>(dev_id), params, sizeof(params));
+}
+
+#endif
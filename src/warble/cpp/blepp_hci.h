@@ -0,0 +1,92 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Tracks how many links warble holds on each local adapter so connections can be spread across them.  Adapters
+ * are keyed by their upper case mac address
+ */
+namespace hci_pool {
+    /**
+     * Sets how many links a balanced connection may place on one adapter, 0 for no limit
+     */
+    void configure(std::size_t max_links);
+
+    /**
+     * Mac addresses of the adapters that are currently up
+     */
+    std::vector<std::string> available();
+    /**
+     * Picks the candidate with the fewest links and counts a link against it.  An empty candidate list means 
+     * every adapter that is up.  Returns an empty string if every candidate is at the link limit
+     */
+    std::string acquire(const std::vector<std::string>& candidates);
+    /**
+     * Candidate acquire would pick if the excluded adapters, given as returned by this function, were full.  Does not 
+     * count a link, returns an empty string if no candidate qualifies
+     */
+    std::string least_loaded(const std::vector<std::string>& candidates, const std::vector<std::string>& excluded);
+    /**
+     * Key the links of an adapter are counted under, an empty mac resolves to the system default adapter
+     */
+    std::string key(const std::string& mac);
+    /**
+     * Counts a link against an adapter chosen by the caller, an empty mac resolves to the system default adapter.  
+     * Returns the key the link was counted under
+     */
+    std::string retain(const std::string& mac);
+    void release(const std::string& mac);
+
+    /**
+     * Link count of every adapter that is up or holds a link
+     */
+    std::vector<std::pair<std::string, std::size_t>> links();
+}
+
+/**
+ * LE connection parameters in controller units
+ */
+struct HciConnParams {
+    // 1.25ms units
+    std::uint16_t min_interval, max_interval;
+    std::uint16_t latency;
+    // 10ms units
+    std::uint16_t supervision_timeout;
+};
+
+/**
+ * HCI commands for an established link, issued on their own socket to the adapter the link is on
+ */
+namespace hci_link {
+    /**
+     * HCI connection handle of the link behind an L2CAP socket, -1 if it cannot be read
+     */
+    int connection_handle(int l2cap_sock);
+    /**
+     * Sends LE Connection Update for a link and waits up to a second on the controller's command status.  Returns an 
+     * empty string once the controller has accepted the command, otherwise the reason it failed
+     */
+    std::string update_params(const std::string& adapter, std::uint16_t handle, const HciConnParams& params);
+    /**
+     * Sends LE Connection Update for a link without waiting on the controller.  Returns an empty string once the 
+     * command is written to the adapter, otherwise the reason it could not be sent
+     */
+    std::string send_params(const std::string& adapter, std::uint16_t handle, const HciConnParams& params);
+    /**
+     * Sets the scan interval and window, in 0.625ms units, the kernel uses for LE Create Connection on an adapter.  The 
+     * values are adapter wide and apply to every connect started after the call.  Needs CAP_NET_ADMIN and a 5.10+ 
+     * kernel, returns an empty string on success, otherwise the reason it failed
+     */
+    std::string set_connect_scan(const std::string& adapter, std::uint16_t interval, std::uint16_t window);
+}
+
+#endif
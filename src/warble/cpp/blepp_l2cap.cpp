@@ -0,0 +1,653 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_l2cap.h"
+#include "blepp_reactor.h"
+#include "error_messages.h"
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// older BlueZ headers predate the LE credit based channel options
+#ifndef BT_SNDMTU
+#define BT_SNDMTU 12
+#endif
+#ifndef BT_RCVMTU
+#define BT_RCVMTU 13
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// smallest MTU an LE credit based channel may use
+const uint16_t MIN_LE_COC_MTU = 23;
+
+class WarbleL2capChannel_Blepp : public WarbleL2capChannel, public BleppIoSource {
+public:
+    WarbleL2capChannel_Blepp(WarbleGatt* gatt, BleppL2capResolver resolver, uint16_t psm, uint16_t requested_mtu, uint8_t security, milliseconds connect_timeout);
+    virtual ~WarbleL2capChannel_Blepp();
+
+    virtual void connect_async(void* context, FnVoid_VoidP_WarbleL2capChannelP_CharP handler);
+    virtual void close();
+    virtual void on_close(void* context, FnVoid_VoidP_WarbleL2capChannelP_Int handler);
+    virtual bool is_open() const;
+    virtual uint16_t get_send_mtu() const;
+    virtual uint16_t get_receive_mtu() const;
+
+    virtual int32_t send(const uint8_t* value, uint16_t len);
+    virtual void on_send_ready(void* context, FnVoid_VoidP_WarbleL2capChannelP handler);
+    virtual void on_sdu_received(void* context, FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort handler);
+    virtual void on_readable(void* context, FnVoid_VoidP_WarbleL2capChannelP handler);
+    virtual int32_t read(uint8_t* buffer, uint32_t capacity);
+
+    virtual int32_t get_fd(uint32_t* events) const;
+    virtual int32_t get_timeout() const;
+    virtual void process(uint32_t events);
+
+    virtual WarbleGatt* get_gatt() const;
+
+    virtual int io_fd() const;
+    virtual bool io_wants_read() const;
+    virtual bool io_wants_write() const;
+    virtual steady_clock::time_point io_deadline() const;
+    virtual void io_process(bool readable, bool writable);
+    virtual void io_timeout();
+
+private:
+    // Returns false if the socket no longer needs to be monitored, by then the handlers have been called
+    bool handle_events(bool readable, bool writable);
+    bool finish_connect();
+    // Reads SDUs until the socket is empty, returning the errno value that closed the channel or 0 if it is still open
+    int receive_all();
+    // Removes the socket from the I/O thread, calls the handler for how the channel ended, then wakes up the destructor
+    bool fail_connect(const char* cause);
+    bool end_channel(int status, bool keep_socket);
+    void stop_io();
+    void release_io();
+    void close_socket();
+    // Gets the I/O thread to pick up a change in io_wants_read or io_wants_write
+    void refresh_io_events();
+
+    WarbleGatt* gatt;
+    BleppL2capResolver resolver;
+    uint16_t psm, requested_mtu;
+    uint8_t security;
+    milliseconds connect_timeout;
+
+    int sock, wake_fd;
+    bool use_reactor, manual_io, connecting;
+    steady_clock::time_point connect_deadline;
+    uint16_t send_mtu, receive_mtu;
+    vector<uint8_t> sdu;
+
+    // draining is set when the remote device closed the channel with SDUs left for read to return, the socket stays
+    // open without being monitored until read reaches the end
+    atomic<bool> open, local_close, draining, send_blocked, readable_signalled;
+
+    mutable mutex io_mutex;
+    condition_variable io_stopped;
+    bool io_active;
+    thread::id io_thread;
+
+    void *connect_context, *close_context, *send_ready_context, *sdu_received_context, *readable_context;
+    FnVoid_VoidP_WarbleL2capChannelP_CharP connect_handler;
+    FnVoid_VoidP_WarbleL2capChannelP_Int close_handler;
+    FnVoid_VoidP_WarbleL2capChannelP send_ready_handler;
+    FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort sdu_received_handler;
+    FnVoid_VoidP_WarbleL2capChannelP readable_handler;
+};
+
+WarbleL2capChannel_Blepp::WarbleL2capChannel_Blepp(WarbleGatt* gatt, BleppL2capResolver resolver, uint16_t psm, uint16_t requested_mtu, uint8_t security, milliseconds connect_timeout) :
+        gatt(gatt), resolver(move(resolver)), psm(psm), requested_mtu(requested_mtu), security(security), connect_timeout(connect_timeout),
+        sock(-1), use_reactor(false), manual_io(false), connecting(false), send_mtu(0), receive_mtu(0),
+        open(false), local_close(false), draining(false), send_blocked(false), readable_signalled(false), io_active(false),
+        connect_context(nullptr), close_context(nullptr), send_ready_context(nullptr), sdu_received_context(nullptr), readable_context(nullptr),
+        connect_handler(nullptr), close_handler(nullptr), send_ready_handler(nullptr), sdu_received_handler(nullptr), readable_handler(nullptr) {
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+WarbleL2capChannel_Blepp::~WarbleL2capChannel_Blepp() {
+    {
+        unique_lock<mutex> lock(io_mutex);
+        if (io_active) {
+            local_close = true;
+            shutdown(sock, SHUT_RDWR);
+
+            if (manual_io) {
+                // no loop will call process again for this object, report the close from here
+                lock.unlock();
+                handle_events(true, true);
+                lock.lock();
+            }
+            io_stopped.wait(lock, [this]() { return !io_active; });
+        }
+    }
+
+    close_socket();
+    ::close(wake_fd);
+}
+
+void WarbleL2capChannel_Blepp::connect_async(void* context, FnVoid_VoidP_WarbleL2capChannelP_CharP handler) {
+    stringstream error_stream;
+    string full_msg;
+
+    {
+        lock_guard<mutex> lock(io_mutex);
+        if (io_active || open) {
+            error_stream << WARBLE_L2CAP_CONNECT_ERROR << "(channel is already open)";
+            full_msg = error_stream.str();
+        }
+    }
+    if (!full_msg.empty()) {
+        handler(context, this, full_msg.c_str());
+        return;
+    }
+
+    BleppL2capTarget target;
+    const char* unavailable = resolver(target);
+    if (unavailable != nullptr) {
+        error_stream << WARBLE_L2CAP_CONNECT_ERROR << "(" << unavailable << ")";
+        full_msg = error_stream.str();
+        handler(context, this, full_msg.c_str());
+        return;
+    }
+
+    // a channel closed by the remote device may still hold SDUs nobody read, they go with the old socket
+    close_socket();
+
+    sockaddr_l2 local, remote;
+    memset(&local, 0, sizeof(local));
+    local.l2_family = AF_BLUETOOTH;
+    local.l2_bdaddr_type = BDADDR_LE_PUBLIC;
+    if (!target.adapter.empty()) {
+        str2ba(target.adapter.c_str(), &local.l2_bdaddr);
+    }
+
+    memset(&remote, 0, sizeof(remote));
+    remote.l2_family = AF_BLUETOOTH;
+    remote.l2_psm = htobs(psm);
+    remote.l2_bdaddr_type = target.public_addr ? BDADDR_LE_PUBLIC : BDADDR_LE_RANDOM;
+    str2ba(target.mac.c_str(), &remote.l2_bdaddr);
+
+    bt_security sec;
+    memset(&sec, 0, sizeof(sec));
+    sec.level = security;
+    uint16_t rx_mtu = requested_mtu;
+
+    if ((sock = socket(AF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, BTPROTO_L2CAP)) < 0 ||
+            bind(sock, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0 ||
+            setsockopt(sock, SOL_BLUETOOTH, BT_SECURITY, &sec, sizeof(sec)) < 0 ||
+            setsockopt(sock, SOL_BLUETOOTH, BT_RCVMTU, &rx_mtu, sizeof(rx_mtu)) < 0 ||
+            (connect(sock, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) < 0 && errno != EINPROGRESS)) {
+        error_stream << WARBLE_L2CAP_CONNECT_ERROR << "(" << strerror(errno) << ")";
+        full_msg = error_stream.str();
+        close_socket();
+        handler(context, this, full_msg.c_str());
+        return;
+    }
+
+    connect_context = context;
+    connect_handler = handler;
+    connecting = true;
+    connect_deadline = steady_clock::now() + connect_timeout;
+    local_close = false;
+    draining = false;
+    send_blocked = false;
+    readable_signalled = false;
+    {
+        lock_guard<mutex> lock(io_mutex);
+        io_active = true;
+    }
+
+    auto mode = blepp_io_mode();
+    manual_io = mode == BleppIoMode::MANUAL;
+    use_reactor = mode == BleppIoMode::REACTOR;
+
+    if (use_reactor) {
+        blepp_reactor::add(this);
+    } else if (!manual_io) {
+        thread th([this]() {
+            bool active;
+            do {
+                pollfd fds[2] = {
+                    { sock, static_cast<short>((io_wants_read() ? POLLIN : 0) | (io_wants_write() ? POLLOUT : 0)), 0 },
+                    { wake_fd, POLLIN, 0 }
+                };
+                int timeout = -1;
+
+                if (connecting) {
+                    auto remaining = duration_cast<milliseconds>(connect_deadline - steady_clock::now()).count();
+                    timeout = remaining < 0 ? 0 : static_cast<int>(remaining);
+                }
+
+                int status = poll(fds, 2, timeout);
+                if (status > 0 && (fds[1].revents & POLLIN)) {
+                    uint64_t value;
+                    while(::read(wake_fd, &value, sizeof(value)) > 0) {
+                    }
+                }
+
+                if (status == 0) {
+                    io_thread = this_thread::get_id();
+                    active = connecting ? fail_connect(WARBLE_CONNECT_TIMEOUT) : true;
+                } else if (status < 0) {
+                    active = errno == EINTR ? true : handle_events(true, true);
+                } else if (fds[0].revents) {
+                    active = handle_events(fds[0].revents & (POLLIN | POLLERR | POLLHUP), fds[0].revents & (POLLOUT | POLLERR | POLLHUP));
+                } else {
+                    // woken to recompute the events to wait on
+                    active = true;
+                }
+            } while(active);
+        });
+        th.detach();
+    }
+}
+
+void WarbleL2capChannel_Blepp::close() {
+    lock_guard<mutex> lock(io_mutex);
+    if (io_active) {
+        local_close = true;
+        // the I/O thread sees the hangup and reports the close from there
+        shutdown(sock, SHUT_RDWR);
+    } else if (draining) {
+        draining = false;
+        open = false;
+        ::close(sock);
+        sock = -1;
+    }
+}
+
+void WarbleL2capChannel_Blepp::on_close(void* context, FnVoid_VoidP_WarbleL2capChannelP_Int handler) {
+    close_context = context;
+    close_handler = handler;
+}
+
+bool WarbleL2capChannel_Blepp::is_open() const {
+    return open;
+}
+
+uint16_t WarbleL2capChannel_Blepp::get_send_mtu() const {
+    return send_mtu;
+}
+
+uint16_t WarbleL2capChannel_Blepp::get_receive_mtu() const {
+    return receive_mtu;
+}
+
+int32_t WarbleL2capChannel_Blepp::send(const uint8_t* value, uint16_t len) {
+    if (!open || draining || len > send_mtu) {
+        return -1;
+    }
+
+    ssize_t sent = ::send(sock, value, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent == static_cast<ssize_t>(len)) {
+        return 1;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+        // out of credits or socket buffer, wait on the socket becoming writable
+        if (!send_blocked.exchange(true)) {
+            refresh_io_events();
+        }
+        return 0;
+    }
+    return -1;
+}
+
+void WarbleL2capChannel_Blepp::on_send_ready(void* context, FnVoid_VoidP_WarbleL2capChannelP handler) {
+    send_ready_context = context;
+    send_ready_handler = handler;
+}
+
+void WarbleL2capChannel_Blepp::on_sdu_received(void* context, FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort handler) {
+    sdu_received_context = context;
+    sdu_received_handler = handler;
+    refresh_io_events();
+}
+
+void WarbleL2capChannel_Blepp::on_readable(void* context, FnVoid_VoidP_WarbleL2capChannelP handler) {
+    readable_context = context;
+    readable_handler = handler;
+    refresh_io_events();
+}
+
+int32_t WarbleL2capChannel_Blepp::read(uint8_t* buffer, uint32_t capacity) {
+    if (!open) {
+        return -1;
+    }
+
+    // SOCK_SEQPACKET hands back one SDU per call, dropping whatever does not fit
+    ssize_t len = recv(sock, buffer, capacity, MSG_DONTWAIT);
+    if (len > 0) {
+        return static_cast<int32_t>(len);
+    }
+
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        if (readable_signalled.exchange(false)) {
+            refresh_io_events();
+        }
+        return 0;
+    }
+
+    bool drained;
+    {
+        lock_guard<mutex> lock(io_mutex);
+        if ((drained = draining.exchange(false))) {
+            open = false;
+            ::close(sock);
+            sock = -1;
+        }
+    }
+    if (drained) {
+        if (close_handler != nullptr) {
+            close_handler(close_context, this, len < 0 ? errno : ECONNRESET);
+        }
+        return -1;
+    }
+    // an empty SDU, or the end of the channel which the I/O thread reports
+    return len == 0 ? 0 : -1;
+}
+
+WarbleGatt* WarbleL2capChannel_Blepp::get_gatt() const {
+    return gatt;
+}
+
+int WarbleL2capChannel_Blepp::io_fd() const {
+    return sock;
+}
+
+bool WarbleL2capChannel_Blepp::io_wants_read() const {
+    return connecting || sdu_received_handler != nullptr || (readable_handler != nullptr && !readable_signalled);
+}
+
+bool WarbleL2capChannel_Blepp::io_wants_write() const {
+    return connecting || send_blocked;
+}
+
+steady_clock::time_point WarbleL2capChannel_Blepp::io_deadline() const {
+    return connecting ? connect_deadline : steady_clock::time_point::max();
+}
+
+void WarbleL2capChannel_Blepp::io_process(bool readable, bool writable) {
+    handle_events(readable, writable);
+}
+
+void WarbleL2capChannel_Blepp::io_timeout() {
+    io_thread = this_thread::get_id();
+    if (connecting) {
+        fail_connect(WARBLE_CONNECT_TIMEOUT);
+    }
+}
+
+int32_t WarbleL2capChannel_Blepp::get_fd(uint32_t* events) const {
+    *events = 0;
+    if (!manual_io) {
+        return -1;
+    }
+
+    lock_guard<mutex> lock(io_mutex);
+    if (!io_active) {
+        return -1;
+    }
+    *events = (io_wants_read() ? WARBLE_IO_READ : 0) | (io_wants_write() ? WARBLE_IO_WRITE : 0);
+    return sock;
+}
+
+int32_t WarbleL2capChannel_Blepp::get_timeout() const {
+    return manual_io ? blepp_io_timeout(io_deadline()) : -1;
+}
+
+void WarbleL2capChannel_Blepp::process(uint32_t events) {
+    {
+        lock_guard<mutex> lock(io_mutex);
+        if (!manual_io || !io_active) {
+            return;
+        }
+    }
+
+    if (events & (WARBLE_IO_READ | WARBLE_IO_WRITE | WARBLE_IO_ERROR)) {
+        handle_events(events & (WARBLE_IO_READ | WARBLE_IO_ERROR), events & (WARBLE_IO_WRITE | WARBLE_IO_ERROR));
+    } else if (steady_clock::now() >= io_deadline()) {
+        io_timeout();
+    }
+}
+
+bool WarbleL2capChannel_Blepp::handle_events(bool readable, bool writable) {
+    io_thread = this_thread::get_id();
+
+    if (connecting) {
+        if (local_close) {
+            return fail_connect(WARBLE_CONNECT_CANCELLED);
+        }
+        return readable || writable ? finish_connect() : true;
+    }
+    if (local_close) {
+        return end_channel(0, false);
+    }
+
+    if (writable && send_blocked.exchange(false) && send_ready_handler != nullptr) {
+        send_ready_handler(send_ready_context, this);
+    }
+
+    if (readable) {
+        if (sdu_received_handler != nullptr) {
+            int status = receive_all();
+            if (status != 0) {
+                return end_channel(status, false);
+            }
+        } else {
+            // data is left for read, peek to tell it apart from a hangup
+            uint8_t peek;
+            ssize_t len = recv(sock, &peek, sizeof(peek), MSG_PEEK | MSG_DONTWAIT);
+
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                return true;
+            }
+            if (len <= 0) {
+                return end_channel(len < 0 ? errno : ECONNRESET, false);
+            }
+            if (readable_signalled.exchange(true)) {
+                // readability was already reported, the wakeup is a hangup with SDUs still waiting to be read
+                int error = 0;
+                socklen_t error_len = sizeof(error);
+                getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len);
+                return end_channel(error != 0 ? error : ECONNRESET, true);
+            }
+            if (readable_handler != nullptr) {
+                readable_handler(readable_context, this);
+            }
+        }
+    }
+
+    return !local_close || end_channel(0, false);
+}
+
+bool WarbleL2capChannel_Blepp::finish_connect() {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        return fail_connect(strerror(error));
+    }
+
+    uint16_t mtu;
+    len = sizeof(mtu);
+    send_mtu = getsockopt(sock, SOL_BLUETOOTH, BT_SNDMTU, &mtu, &len) == 0 ? mtu : MIN_LE_COC_MTU;
+    len = sizeof(mtu);
+    receive_mtu = getsockopt(sock, SOL_BLUETOOTH, BT_RCVMTU, &mtu, &len) == 0 ? mtu : requested_mtu;
+    sdu.resize(receive_mtu);
+
+    connecting = false;
+    open = true;
+    connect_handler(connect_context, this, nullptr);
+    return true;
+}
+
+int WarbleL2capChannel_Blepp::receive_all() {
+    while(true) {
+        ssize_t len = recv(sock, sdu.data(), sdu.size(), MSG_DONTWAIT);
+        if (len < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : errno;
+        }
+        if (len == 0) {
+            // a SOCK_SEQPACKET socket returns 0 for an empty SDU as well as the end of the channel
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            pollfd fds = { sock, 0, 0 };
+            if (poll(&fds, 1, 0) > 0 && (fds.revents & (POLLHUP | POLLERR))) {
+                getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len);
+                return error != 0 ? error : ECONNRESET;
+            }
+        }
+
+        sdu_received_handler(sdu_received_context, this, sdu.data(), static_cast<uint16_t>(len));
+        if (local_close) {
+            return 0;
+        }
+    }
+}
+
+bool WarbleL2capChannel_Blepp::fail_connect(const char* cause) {
+    stringstream error_stream;
+    string full_msg;
+
+    error_stream << WARBLE_L2CAP_CONNECT_ERROR << "(" << cause << ")";
+    full_msg = error_stream.str();
+
+    connecting = false;
+    stop_io();
+    close_socket();
+    connect_handler(connect_context, this, full_msg.c_str());
+    release_io();
+    return false;
+}
+
+bool WarbleL2capChannel_Blepp::end_channel(int status, bool keep_socket) {
+    stop_io();
+    if (keep_socket && !local_close) {
+        draining = true;
+    } else {
+        close_socket();
+    }
+    send_blocked = false;
+
+    // a draining channel is reported closed once read reaches the end
+    if (!draining && close_handler != nullptr) {
+        close_handler(close_context, this, local_close ? 0 : status);
+    }
+    release_io();
+    return false;
+}
+
+void WarbleL2capChannel_Blepp::stop_io() {
+    if (use_reactor) {
+        blepp_reactor::remove(this);
+    }
+}
+
+void WarbleL2capChannel_Blepp::release_io() {
+    lock_guard<mutex> lock(io_mutex);
+    io_active = false;
+    io_stopped.notify_all();
+}
+
+void WarbleL2capChannel_Blepp::close_socket() {
+    lock_guard<mutex> lock(io_mutex);
+    open = false;
+    if (sock >= 0) {
+        ::close(sock);
+        sock = -1;
+    }
+}
+
+void WarbleL2capChannel_Blepp::refresh_io_events() {
+    // the I/O thread rereads the wanted events after every wakeup it handles, and the application after every call
+    if (manual_io || this_thread::get_id() == io_thread) {
+        return;
+    }
+
+    if (use_reactor) {
+        blepp_reactor::update(this);
+    } else {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter is saturated, the thread is already awake
+        }
+    }
+}
+
+}
+
+WarbleL2capChannel* blepp_l2cap_create(WarbleGatt* gatt, BleppL2capResolver resolver, uint16_t psm, int32_t nopts, const WarbleOption* opts) {
+    uint16_t mtu = UINT16_MAX;
+    uint8_t security = BT_SECURITY_LOW;
+    milliseconds connect_timeout(10000);
+
+    unordered_map<string, function<void (const char*)>> arg_processors = {
+        {"mtu", [&mtu](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < MIN_LE_COC_MTU || parsed > UINT16_MAX) {
+                throw runtime_error("invalid value for \'mtu\' option (blepp api): must be between 23 and 65535");
+            }
+            mtu = static_cast<uint16_t>(parsed);
+        }},
+        {"security", [&security](const char* value) {
+            if (!strcmp(value, "low")) {
+                security = BT_SECURITY_LOW;
+            } else if (!strcmp(value, "medium")) {
+                security = BT_SECURITY_MEDIUM;
+            } else if (!strcmp(value, "high")) {
+                security = BT_SECURITY_HIGH;
+            } else {
+                throw runtime_error("invalid value for \'security\' option (blepp api): one of [low, medium, high]");
+            }
+        }},
+        {"connect-timeout", [&connect_timeout](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'connect-timeout\' option (blepp api): must be a positive number of milliseconds");
+            }
+            connect_timeout = milliseconds(parsed);
+        }}
+    };
+
+    for(int i = 0; i < nopts; i++) {
+        auto it = arg_processors.find(opts[i].key);
+        if (it == arg_processors.end()) {
+            throw runtime_error(string("invalid l2cap option '") + opts[i].key + "'");
+        }
+        (it->second)(opts[i].value);
+    }
+    if (psm == 0) {
+        throw runtime_error("invalid psm (blepp api): must be non-zero");
+    }
+
+    return new WarbleL2capChannel_Blepp(gatt, move(resolver), psm, mtu, security, connect_timeout);
+}
+
+#endif
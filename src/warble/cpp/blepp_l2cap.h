@@ -0,0 +1,36 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "l2cap_def.h"
+#include "warble/types.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * Remote device and local adapter a channel connects through, read from the WarbleGatt object each time
+ * the channel is opened
+ */
+struct BleppL2capTarget {
+    std::string mac;
+    bool public_addr;
+    // address of the adapter the ACL link runs through, empty for the default adapter
+    std::string adapter;
+};
+
+/**
+ * Fills in the target, returning an error message if the channel cannot be opened right now
+ */
+using BleppL2capResolver = std::function<const char*(BleppL2capTarget&)>;
+
+/**
+ * Creates an LE credit based channel over its own L2CAP socket, throws runtime_error for invalid options
+ */
+WarbleL2capChannel* blepp_l2cap_create(WarbleGatt* gatt, BleppL2capResolver resolver, std::uint16_t psm, std::int32_t nopts, const WarbleOption* opts);
+
+#endif
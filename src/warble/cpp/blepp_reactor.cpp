@@ -0,0 +1,325 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_reactor.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+BleppIoSource::~BleppIoSource() {
+
+}
+
+bool BleppIoSource::io_wants_read() const {
+    return true;
+}
+
+namespace {
+
+const int MAX_EVENTS = 64;
+
+class IoLoop {
+public:
+    IoLoop();
+
+    void add(BleppIoSource* source);
+    void update(BleppIoSource* source);
+    void remove(BleppIoSource* source);
+    size_t size();
+
+private:
+    struct Registration {
+        // fd the source had when it was added, -1 for sources that only wait on a deadline
+        int fd;
+        uint32_t events;
+        steady_clock::time_point deadline;
+    };
+
+    void run();
+    template<typename F>
+    void dispatch(BleppIoSource* source, F fn);
+    // Must be called with the mutex held
+    void rearm(BleppIoSource* source, Registration& reg);
+    void wakeup();
+
+    int epoll_fd, wake_fd;
+    mutex m;
+    condition_variable dispatch_done;
+    unordered_map<BleppIoSource*, Registration> registrations;
+    set<pair<steady_clock::time_point, BleppIoSource*>> deadlines;
+    BleppIoSource* dispatching;
+    thread::id loop_id;
+};
+
+IoLoop::IoLoop() : dispatching(nullptr) {
+    if ((epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        throw runtime_error("failed to create epoll instance for the blepp reactor");
+    }
+    if ((wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        throw runtime_error("failed to create eventfd for the blepp reactor");
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    thread th(&IoLoop::run, this);
+    loop_id = th.get_id();
+    th.detach();
+}
+
+size_t IoLoop::size() {
+    lock_guard<mutex> lock(m);
+    return registrations.size();
+}
+
+void IoLoop::wakeup() {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        // eventfd counter is saturated, loop is already awake
+    }
+}
+
+void IoLoop::rearm(BleppIoSource* source, Registration& reg) {
+    uint32_t events = (source->io_wants_read() ? EPOLLIN : 0u) | (source->io_wants_write() ? EPOLLOUT : 0u);
+    if (reg.fd >= 0 && events != reg.events) {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.ptr = source;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, reg.fd, &ev);
+        reg.events = events;
+    }
+
+    auto deadline = source->io_deadline();
+    if (deadline != reg.deadline) {
+        deadlines.erase({reg.deadline, source});
+        if (deadline != steady_clock::time_point::max()) {
+            deadlines.emplace(deadline, source);
+        }
+        reg.deadline = deadline;
+    }
+}
+
+void IoLoop::add(BleppIoSource* source) {
+    {
+        lock_guard<mutex> lock(m);
+
+        Registration reg = { source->io_fd(), (source->io_wants_read() ? EPOLLIN : 0u) | (source->io_wants_write() ? EPOLLOUT : 0u), source->io_deadline() };
+        if (reg.fd >= 0) {
+            epoll_event ev = {};
+            ev.events = reg.events;
+            ev.data.ptr = source;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, reg.fd, &ev) < 0) {
+                throw runtime_error("failed to register socket with the blepp reactor");
+            }
+        }
+
+        if (reg.deadline != steady_clock::time_point::max()) {
+            deadlines.emplace(reg.deadline, source);
+        }
+        registrations.emplace(source, reg);
+    }
+    wakeup();
+}
+
+void IoLoop::update(BleppIoSource* source) {
+    {
+        lock_guard<mutex> lock(m);
+
+        auto it = registrations.find(source);
+        if (it == registrations.end()) {
+            return;
+        }
+        rearm(source, it->second);
+    }
+    wakeup();
+}
+
+void IoLoop::remove(BleppIoSource* source) {
+    unique_lock<mutex> lock(m);
+    if (this_thread::get_id() != loop_id) {
+        dispatch_done.wait(lock, [this, source]() { return dispatching != source; });
+    }
+
+    auto it = registrations.find(source);
+    if (it != registrations.end()) {
+        if (it->second.fd >= 0) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        }
+        deadlines.erase({it->second.deadline, source});
+        registrations.erase(it);
+    }
+}
+
+template<typename F>
+void IoLoop::dispatch(BleppIoSource* source, F fn) {
+    unique_lock<mutex> lock(m);
+    if (!registrations.count(source)) {
+        return;
+    }
+    dispatching = source;
+    lock.unlock();
+
+    fn();
+
+    lock.lock();
+    dispatching = nullptr;
+
+    auto it = registrations.find(source);
+    if (it != registrations.end()) {
+        rearm(source, it->second);
+    }
+    dispatch_done.notify_all();
+}
+
+void IoLoop::run() {
+    epoll_event events[MAX_EVENTS];
+
+    while(true) {
+        int timeout = -1;
+        {
+            lock_guard<mutex> lock(m);
+            if (!deadlines.empty()) {
+                auto remaining = deadlines.begin()->first - steady_clock::now();
+                // round up so the loop does not wake before the deadline and spin
+                timeout = remaining.count() <= 0 ? 0 : static_cast<int>(duration_cast<milliseconds>(remaining).count() + 1);
+            }
+        }
+
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        for(int i = 0; i < n; i++) {
+            auto source = static_cast<BleppIoSource*>(events[i].data.ptr);
+            if (source == nullptr) {
+                uint64_t value;
+                while(read(wake_fd, &value, sizeof(value)) > 0) {
+                }
+                continue;
+            }
+
+            bool failed = events[i].events & (EPOLLERR | EPOLLHUP);
+            bool readable = failed || (events[i].events & EPOLLIN),
+                writable = failed || (events[i].events & EPOLLOUT);
+            dispatch(source, [source, readable, writable]() {
+                source->io_process(readable, writable && source->io_wants_write());
+            });
+        }
+
+        vector<BleppIoSource*> expired;
+        {
+            lock_guard<mutex> lock(m);
+            auto now = steady_clock::now();
+            while(!deadlines.empty() && deadlines.begin()->first <= now) {
+                auto source = deadlines.begin()->second;
+                registrations[source].deadline = steady_clock::time_point::max();
+                deadlines.erase(deadlines.begin());
+                expired.push_back(source);
+            }
+        }
+        for(auto source: expired) {
+            dispatch(source, [source]() { source->io_timeout(); });
+        }
+    }
+}
+
+mutex reactor_mutex;
+BleppIoMode io_mode = BleppIoMode::THREAD;
+size_t io_nthreads = 1;
+// Loops are never torn down, their threads run until the process exits
+vector<IoLoop*>* loops = nullptr;
+unordered_map<BleppIoSource*, IoLoop*> assignments;
+
+IoLoop* find_loop(BleppIoSource* source) {
+    lock_guard<mutex> lock(reactor_mutex);
+    auto it = assignments.find(source);
+    return it == assignments.end() ? nullptr : it->second;
+}
+
+}
+
+void blepp_io_configure(BleppIoMode mode, size_t nthreads) {
+    lock_guard<mutex> lock(reactor_mutex);
+    if (nthreads == 0) {
+        nthreads = io_nthreads;
+    }
+    if (loops != nullptr && loops->size() != nthreads) {
+        throw runtime_error("reactor I/O thread count cannot be changed once the reactor has started");
+    }
+
+    io_mode = mode;
+    io_nthreads = nthreads;
+}
+
+BleppIoMode blepp_io_mode() {
+    lock_guard<mutex> lock(reactor_mutex);
+    return io_mode;
+}
+
+int blepp_io_timeout(steady_clock::time_point deadline) {
+    if (deadline == steady_clock::time_point::max()) {
+        return -1;
+    }
+
+    auto remaining = deadline - steady_clock::now();
+    return remaining.count() <= 0 ? 0 : static_cast<int>(duration_cast<milliseconds>(remaining).count() + 1);
+}
+
+void blepp_reactor::add(BleppIoSource* source) {
+    IoLoop* target = nullptr;
+    {
+        lock_guard<mutex> lock(reactor_mutex);
+        if (loops == nullptr) {
+            loops = new vector<IoLoop*>();
+            for(size_t i = 0; i < io_nthreads; i++) {
+                loops->push_back(new IoLoop());
+            }
+        }
+
+        size_t min_size = SIZE_MAX;
+        for(auto it: *loops) {
+            size_t current = it->size();
+            if (current < min_size) {
+                min_size = current;
+                target = it;
+            }
+        }
+        assignments[source] = target;
+    }
+    target->add(source);
+}
+
+void blepp_reactor::update(BleppIoSource* source) {
+    auto loop = find_loop(source);
+    if (loop != nullptr) {
+        loop->update(source);
+    }
+}
+
+void blepp_reactor::remove(BleppIoSource* source) {
+    auto loop = find_loop(source);
+    if (loop != nullptr) {
+        loop->remove(source);
+
+        lock_guard<mutex> lock(reactor_mutex);
+        assignments.erase(source);
+    }
+}
+
+#endif
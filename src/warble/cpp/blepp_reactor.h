@@ -0,0 +1,65 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Object that owns a socket driven by a BleppReactor
+ */
+struct BleppIoSource {
+    virtual ~BleppIoSource() = 0;
+
+    // Read once when the source is added, -1 registers a source that only receives io_timeout calls
+    virtual int io_fd() const = 0;
+    // Sources that leave data in the socket for the application to read return false, errors and hangups are still reported
+    virtual bool io_wants_read() const;
+    virtual bool io_wants_write() const = 0;
+    // steady_clock::time_point::max() if there is no pending timeout
+    virtual std::chrono::steady_clock::time_point io_deadline() const = 0;
+
+    virtual void io_process(bool readable, bool writable) = 0;
+    virtual void io_timeout() = 0;
+};
+
+enum class BleppIoMode {
+    THREAD,
+    REACTOR,
+    // no threads, the application polls the sockets and calls the process functions from its own loop
+    MANUAL
+};
+
+/**
+ * Sets how sockets are serviced: one thread per connection, or a fixed pool of epoll threads.  
+ * Passing 0 for nthreads keeps the current thread count
+ */
+void blepp_io_configure(BleppIoMode mode, std::size_t nthreads);
+BleppIoMode blepp_io_mode();
+/**
+ * Milliseconds from now until the deadline, rounded up so a loop waiting on it does not wake early and spin. 
+ * -1 for steady_clock::time_point::max()
+ */
+int blepp_io_timeout(std::chrono::steady_clock::time_point deadline);
+
+namespace blepp_reactor {
+    /**
+     * Starts monitoring the source on the least loaded I/O thread
+     */
+    void add(BleppIoSource* source);
+    /**
+     * Re-reads the source's wanted events and deadline, must be called from outside the I/O thread
+     * if either changes
+     */
+    void update(BleppIoSource* source);
+    /**
+     * Stops monitoring the source.  When called from outside the I/O thread, blocks until any
+     * in-flight callback for the source returns
+     */
+    void remove(BleppIoSource* source);
+}
+
+#endif
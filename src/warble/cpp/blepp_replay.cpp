@@ -0,0 +1,507 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_replay.h"
+#include "blepp_att.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const uint32_t DATALINK_H4 = 1002, DATALINK_MONITOR = 2001;
+const uint32_t FLAG_RECEIVED = 0x1;
+// btmon opcodes carried in the lower half of the flags field
+const uint16_t MONITOR_EVENT = 3, MONITOR_ACL_TX = 4, MONITOR_ACL_RX = 5;
+const uint8_t H4_ACL = 0x02, H4_EVENT = 0x04;
+const uint8_t EVT_DISCONN_COMPLETE = 0x05, EVT_LE_META = 0x3e;
+const uint8_t LE_CONN_COMPLETE = 0x01, LE_ADVERTISING_REPORT = 0x02, LE_ENHANCED_CONN_COMPLETE = 0x0a;
+const uint8_t LOCAL_HOST_TERMINATED = 0x16;
+const uint16_t ATT_CID = 0x0004;
+
+struct AttRecord {
+    uint64_t timestamp;
+    bool from_remote;
+    vector<uint8_t> pdu;
+};
+
+struct Session {
+    // upper case, empty if the capture did not include the connection event
+    string mac;
+    vector<AttRecord> pdus;
+    // remote side ended the link, a link the local side closed is left for the application to close again
+    bool remote_dc;
+    uint64_t dc_timestamp;
+};
+
+struct Recording {
+    vector<Session> sessions;
+    // HCI event packets with the H4 type byte, as a raw HCI socket returns them
+    vector<pair<uint64_t, vector<uint8_t>>> advertisements;
+};
+
+uint32_t get_be32(const uint8_t* src) {
+    return (static_cast<uint32_t>(src[0]) << 24) | (static_cast<uint32_t>(src[1]) << 16) | (static_cast<uint32_t>(src[2]) << 8) | src[3];
+}
+
+uint64_t get_be64(const uint8_t* src) {
+    return (static_cast<uint64_t>(get_be32(src)) << 32) | get_be32(src + 4);
+}
+
+string format_mac(const uint8_t* addr) {
+    char buffer[18];
+    // sent least significant byte first
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", addr[5], addr[4], addr[3], addr[2], addr[1], addr[0]);
+    return buffer;
+}
+
+string to_upper(string value) {
+    transform(value.begin(), value.end(), value.begin(), ::toupper);
+    return value;
+}
+
+class Parser {
+public:
+    Recording recording;
+
+    void event(uint64_t timestamp, const uint8_t* packet, size_t len) {
+        if (len < 2 || len < 2u + packet[1]) {
+            return;
+        }
+
+        const uint8_t* params = packet + 2;
+        size_t params_len = packet[1];
+        if (packet[0] == EVT_LE_META && params_len >= 1) {
+            switch(params[0]) {
+            case LE_ADVERTISING_REPORT: {
+                vector<uint8_t> raw = { H4_EVENT };
+                raw.insert(raw.end(), packet, packet + 2 + params_len);
+                recording.advertisements.emplace_back(timestamp, move(raw));
+                break;
+            }
+            case LE_CONN_COMPLETE:
+            case LE_ENHANCED_CONN_COMPLETE:
+                // subevent, status, handle, role, address type, address
+                if (params_len >= 12 && params[1] == 0) {
+                    open_session(att::get_le16(params + 2) & 0x0fff, format_mac(params + 6));
+                }
+                break;
+            }
+        } else if (packet[0] == EVT_DISCONN_COMPLETE && params_len >= 4 && params[0] == 0) {
+            auto it = open_sessions.find(att::get_le16(params + 1) & 0x0fff);
+            if (it != open_sessions.end()) {
+                auto& session = recording.sessions[it->second];
+                session.remote_dc = params[3] != LOCAL_HOST_TERMINATED;
+                session.dc_timestamp = timestamp;
+                open_sessions.erase(it);
+            }
+        }
+    }
+
+    void acl(uint64_t timestamp, bool received, const uint8_t* packet, size_t len) {
+        if (len < 4) {
+            return;
+        }
+
+        uint16_t header = att::get_le16(packet);
+        uint16_t handle = header & 0x0fff;
+        size_t data_len = min<size_t>(att::get_le16(packet + 2), len - 4);
+        auto& buffer = fragments[(static_cast<uint32_t>(handle) << 1) | (received ? 1 : 0)];
+
+        // packet boundary flag, 1 marks a continuation of the previous L2CAP frame
+        if (((header >> 12) & 0x3) == 0x1) {
+            if (buffer.empty()) {
+                return;
+            }
+        } else {
+            buffer.clear();
+        }
+        buffer.insert(buffer.end(), packet + 4, packet + 4 + data_len);
+
+        if (buffer.size() < 4 || buffer.size() < 4u + att::get_le16(buffer.data())) {
+            return;
+        }
+        if (att::get_le16(buffer.data() + 2) == ATT_CID && att::get_le16(buffer.data()) > 0) {
+            auto it = open_sessions.find(handle);
+            if (it == open_sessions.end()) {
+                it = open_session(handle, "");
+            }
+            recording.sessions[it->second].pdus.push_back({ timestamp, received, vector<uint8_t>(buffer.begin() + 4, buffer.begin() + 4 + att::get_le16(buffer.data())) });
+        }
+        buffer.clear();
+    }
+
+private:
+    unordered_map<uint16_t, size_t>::iterator open_session(uint16_t handle, const string& mac) {
+        recording.sessions.push_back({ mac, {}, false, 0 });
+        open_sessions[handle] = recording.sessions.size() - 1;
+        return open_sessions.find(handle);
+    }
+
+    unordered_map<uint16_t, size_t> open_sessions;
+    unordered_map<uint32_t, vector<uint8_t>> fragments;
+};
+
+shared_ptr<const Recording> load(const string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw runtime_error("cannot open replay file '" + path + "' (" + strerror(errno) + ")");
+    }
+
+    uint8_t header[24];
+    if (fread(header, 1, 16, file) != 16 || memcmp(header, "btsnoop\0", 8) || get_be32(header + 8) != 1) {
+        fclose(file);
+        throw runtime_error("replay file '" + path + "' is not a btsnoop capture");
+    }
+
+    uint32_t datalink = get_be32(header + 12);
+    if (datalink != DATALINK_H4 && datalink != DATALINK_MONITOR) {
+        fclose(file);
+        throw runtime_error("replay file '" + path + "' uses an unsupported datalink, expected H4 (1002) or monitor (2001)");
+    }
+
+    Parser parser;
+    vector<uint8_t> packet;
+    // a truncated last record, from a capture that was still being written, is ignored
+    while(fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        uint32_t included = get_be32(header + 4), flags = get_be32(header + 8);
+        uint64_t timestamp = get_be64(header + 16);
+
+        // no HCI packet is this large, the rest of the file cannot be trusted
+        if (included > 0x10000) {
+            break;
+        }
+        packet.resize(included);
+        if (fread(packet.data(), 1, included, file) != included) {
+            break;
+        }
+
+        if (datalink == DATALINK_H4) {
+            if (packet.empty()) {
+                continue;
+            }
+            if (packet[0] == H4_EVENT) {
+                parser.event(timestamp, packet.data() + 1, packet.size() - 1);
+            } else if (packet[0] == H4_ACL) {
+                parser.acl(timestamp, (flags & FLAG_RECEIVED) != 0, packet.data() + 1, packet.size() - 1);
+            }
+        } else {
+            switch(flags & 0xffff) {
+            case MONITOR_EVENT:
+                parser.event(timestamp, packet.data(), packet.size());
+                break;
+            case MONITOR_ACL_TX:
+            case MONITOR_ACL_RX:
+                parser.acl(timestamp, (flags & 0xffff) == MONITOR_ACL_RX, packet.data(), packet.size());
+                break;
+            }
+        }
+    }
+    fclose(file);
+
+    return make_shared<const Recording>(move(parser.recording));
+}
+
+bool is_write(uint8_t opcode) {
+    return opcode == att::WRITE_REQ || opcode == att::WRITE_CMD || opcode == att::EXEC_WRITE_REQ;
+}
+
+bool send_pdu(int fd, const vector<uint8_t>& pdu) {
+    return send(fd, pdu.data(), pdu.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(pdu.size());
+}
+
+/**
+ * Serves one recorded session over the peer end of a link
+ */
+class LinkReplay {
+public:
+    LinkReplay(int fd, shared_ptr<const Recording> recording, size_t index, replay::Pacing pacing) : fd(fd), recording(recording),
+            pacing(pacing), writes(0) {
+        const auto& session = recording->sessions[index];
+        const AttRecord* request = nullptr;
+        uint32_t recorded_writes = 0;
+
+        for(const auto& it: session.pdus) {
+            uint8_t opcode = it.pdu[0];
+            if (!it.from_remote) {
+                if (is_write(opcode)) {
+                    recorded_writes++;
+                }
+                if (att::is_request(opcode)) {
+                    request = &it;
+                }
+            } else if (opcode == att::HANDLE_NOTIFY || opcode == att::HANDLE_IND) {
+                events.push_back({ it.timestamp, recorded_writes, &it.pdu });
+            } else if (request != nullptr && !att::is_request(opcode)) {
+                Response response = { &it.pdu, it.timestamp - request->timestamp };
+                responses[request->pdu].push_back(response);
+                // writes carry values that may differ between runs, the handle is enough to pick the response
+                if (is_write(request->pdu[0]) && request->pdu.size() >= 3) {
+                    responses[vector<uint8_t>(request->pdu.begin(), request->pdu.begin() + 3)].push_back(response);
+                }
+                request = nullptr;
+            }
+        }
+
+        if (session.remote_dc) {
+            events.push_back({ session.dc_timestamp, recorded_writes, nullptr });
+        }
+    }
+
+    void run() {
+        size_t next = 0;
+        bool rebase = true;
+        steady_clock::time_point base_time;
+        uint64_t base_timestamp = 0;
+
+        while(true) {
+            timespec timeout, *wait = nullptr;
+            if (next < events.size() && writes >= events[next].writes) {
+                auto due = steady_clock::now();
+                if (pacing == replay::Pacing::REALTIME) {
+                    // gaps are kept from the point the event stopped waiting on the application
+                    if (rebase) {
+                        base_time = due;
+                        base_timestamp = events[next].timestamp;
+                        rebase = false;
+                    }
+                    due = base_time + microseconds(events[next].timestamp - base_timestamp);
+                }
+
+                auto remaining = duration_cast<nanoseconds>(due - steady_clock::now()).count();
+                if (remaining <= 0) {
+                    if (events[next].pdu == nullptr || !send_pdu(fd, *events[next].pdu)) {
+                        break;
+                    }
+                    next++;
+                    continue;
+                }
+
+                timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+                timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+                wait = &timeout;
+            } else {
+                rebase = true;
+            }
+
+            pollfd fds = { fd, POLLIN, 0 };
+            int status = ppoll(&fds, 1, wait, nullptr);
+            if (status < 0 && errno != EINTR) {
+                break;
+            }
+            if (status > 0 && !process_request()) {
+                break;
+            }
+        }
+
+        close(fd);
+    }
+
+private:
+    struct Event {
+        uint64_t timestamp;
+        // writes the application had issued when the event was recorded
+        uint32_t writes;
+        // nullptr for the remote side closing the link
+        const vector<uint8_t>* pdu;
+    };
+
+    struct Response {
+        const vector<uint8_t>* pdu;
+        uint64_t latency;
+    };
+
+    struct Responses {
+        vector<Response> recorded;
+        // repeats the last one once the recorded responses run out
+        size_t next;
+
+        Responses() : next(0) {
+        }
+
+        void push_back(const Response& response) {
+            recorded.push_back(response);
+        }
+    };
+
+    // returns false once the application closed its end
+    bool process_request() {
+        uint8_t pdu[att::MAX_PDU_LEN];
+        ssize_t len = recv(fd, pdu, sizeof(pdu), 0);
+        if (len <= 0) {
+            return len < 0 && errno == EINTR;
+        }
+
+        if (is_write(pdu[0])) {
+            writes++;
+        }
+        if (!att::is_request(pdu[0])) {
+            return true;
+        }
+
+        auto it = responses.find(vector<uint8_t>(pdu, pdu + len));
+        if (it == responses.end() && is_write(pdu[0]) && len >= 3) {
+            it = responses.find(vector<uint8_t>(pdu, pdu + 3));
+        }
+
+        if (it == responses.end()) {
+            return send_pdu(fd, fallback(pdu, static_cast<size_t>(len)));
+        }
+
+        auto& response = it->second.recorded[it->second.next];
+        it->second.next = min(it->second.next + 1, it->second.recorded.size() - 1);
+        if (pacing == replay::Pacing::REALTIME) {
+            this_thread::sleep_for(microseconds(response.latency));
+        }
+        return send_pdu(fd, *response.pdu);
+    }
+
+    // answers a request the capture has no response for
+    static vector<uint8_t> fallback(const uint8_t* pdu, size_t len) {
+        vector<uint8_t> response(att::MAX_PDU_LEN);
+        uint16_t handle = len >= 3 ? att::get_le16(pdu + 1) : 0;
+
+        switch(pdu[0]) {
+        case att::MTU_REQ:
+            // agrees to the client's MTU
+            response.resize(att::encode_mtu(response.data(), att::MTU_RSP, len >= 3 ? handle : att::DEFAULT_LE_MTU));
+            break;
+        case att::WRITE_REQ:
+            response.resize(1);
+            response[0] = att::WRITE_RSP;
+            break;
+        case att::PREP_WRITE_REQ:
+            response.assign(pdu, pdu + len);
+            response[0] = att::PREP_WRITE_RSP;
+            break;
+        case att::EXEC_WRITE_REQ:
+            response.resize(1);
+            response[0] = att::EXEC_WRITE_RSP;
+            break;
+        case att::FIND_INFO_REQ:
+        case att::FIND_BY_TYPE_REQ:
+        case att::READ_BY_TYPE_REQ:
+        case att::READ_BY_GROUP_REQ:
+            // ends the discovery walk of the range
+            response.resize(att::encode_error_rsp(response.data(), pdu[0], handle, att::ATTRIBUTE_NOT_FOUND));
+            break;
+        case att::READ_MULTI_REQ:
+        case att::READ_MULTI_VAR_REQ:
+            response.resize(att::encode_error_rsp(response.data(), pdu[0], handle, att::REQUEST_NOT_SUPPORTED));
+            break;
+        default:
+            response.resize(att::encode_error_rsp(response.data(), pdu[0], handle, att::INVALID_HANDLE));
+            break;
+        }
+        return response;
+    }
+
+    int fd;
+    shared_ptr<const Recording> recording;
+    replay::Pacing pacing;
+    vector<Event> events;
+    map<vector<uint8_t>, Responses> responses;
+    uint32_t writes;
+};
+
+class ReplayPeer : public BleppPeer {
+public:
+    ReplayPeer(shared_ptr<const Recording> recording, replay::Pacing pacing) : recording(recording), pacing(pacing),
+            claimed(recording->sessions.size(), false) {
+    }
+
+    virtual void serve_link(int fd, const string& mac) {
+        size_t index = recording->sessions.size();
+        {
+            lock_guard<mutex> lock(m);
+            // sessions not yet played before played ones, and ones recorded for the device before ones of unknown devices
+            auto upper = to_upper(mac);
+            for(int pass = 0; pass < 4 && index == recording->sessions.size(); pass++) {
+                const string& wanted = pass % 2 ? string() : upper;
+                for(size_t i = 0; i < recording->sessions.size(); i++) {
+                    if (recording->sessions[i].mac == wanted && (pass >= 2 || !claimed[i])) {
+                        index = i;
+                        break;
+                    }
+                }
+            }
+
+            if (index < claimed.size()) {
+                claimed[index] = true;
+            }
+        }
+
+        // the link fails like a connect to a device that is not around
+        if (index == recording->sessions.size()) {
+            close(fd);
+            return;
+        }
+
+        auto recording = this->recording;
+        auto pacing = this->pacing;
+        thread th([fd, recording, index, pacing]() {
+            LinkReplay(fd, recording, index, pacing).run();
+        });
+        th.detach();
+    }
+
+    virtual void serve_scan(int fd) {
+        auto recording = this->recording;
+        auto pacing = this->pacing;
+        thread th([fd, recording, pacing]() {
+            const auto& advertisements = recording->advertisements;
+            auto start = steady_clock::now();
+
+            for(const auto& it: advertisements) {
+                if (pacing == replay::Pacing::REALTIME) {
+                    this_thread::sleep_until(start + microseconds(it.first - advertisements.front().first));
+                }
+                if (!send_pdu(fd, it.second)) {
+                    break;
+                }
+            }
+
+            // held open until the scanner stops, a closed socket reads as a scan failure
+            uint8_t discard[1];
+            ssize_t len;
+            do {
+                len = recv(fd, discard, sizeof(discard), 0);
+            } while(len > 0 || (len < 0 && errno == EINTR));
+            close(fd);
+        });
+        th.detach();
+    }
+
+private:
+    shared_ptr<const Recording> recording;
+    replay::Pacing pacing;
+
+    mutex m;
+    vector<bool> claimed;
+};
+
+}
+
+shared_ptr<BleppPeer> replay::open(const string& path, Pacing pacing) {
+    return make_shared<ReplayPeer>(load(path), pacing);
+}
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "blepp_transport.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Plays a btsnoop capture back as the remote side of warble's links and scans.  Requests are answered with the
+ * responses recorded for them, and notifications are held back until the application has issued as many writes
+ * as it had when they were recorded, so streams start once the application turns them on
+ */
+namespace replay {
+    enum class Pacing {
+        // keeps the recorded gaps between notifications, advertising reports, and responses
+        REALTIME,
+        // sends everything as soon as it is due
+        FAST
+    };
+
+    /**
+     * Loads a capture with the H4 (1002) or monitor (2001) datalink, as written by the 'capture-file' option or btmon.
+     * Throws runtime_error if the file cannot be read
+     */
+    std::shared_ptr<BleppPeer> open(const std::string& path, Pacing pacing);
+}
+
+#endif
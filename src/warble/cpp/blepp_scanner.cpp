@@ -5,18 +5,24 @@
 
 #include "scanner_def.h"
 
+#include "blepp_reactor.h"
+#include "blepp_transport.h"
 #include "blepp_utils.h"
 #include "blepp/blestatemachine.h"
 #include "blepp/lescan.h"
 
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <locale>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace BLEPP;
@@ -39,21 +45,30 @@ public:
     virtual void set_handler(void* context, FnVoid_VoidP_WarbleScanResultP handler);
     virtual void start(WARBLE_INT nopts, const WarbleOption* opts);
     virtual void stop();
+    virtual int32_t get_fd() const;
+    virtual void process();
 
 private:
-    BLEPP::HCIScanner* scanner;
+    // Reads one batch of advertisements and dispatches them, returns false if the scan can no longer continue
+    bool process_advertisements();
+
+    unique_ptr<BleppScanSource> scanner;
+    unordered_map<string, WarbleScanPrivateData> seen_devices;
+    unordered_map<string, string> device_names;
+    HCIScanner::ScanType scan_type;
 
     void* scan_result_context;
     FnVoid_VoidP_WarbleScanResultP scan_result_handler;
     std::thread scan_thread;
-    bool terminate_scan;
+    bool terminate_scan, manual_io;
 };
 
 WarbleScanner* warble_scanner_create() {
     return new WarbleScanner_Blepp();
 }
 
-WarbleScanner_Blepp::WarbleScanner_Blepp() : scanner(nullptr), scan_result_context(nullptr), scan_result_handler(nullptr) {
+WarbleScanner_Blepp::WarbleScanner_Blepp() : scan_type(HCIScanner::ScanType::Active), scan_result_context(nullptr), scan_result_handler(nullptr),
+        manual_io(false) {
 }
 
 WarbleScanner_Blepp::~WarbleScanner_Blepp() {
@@ -90,12 +105,18 @@ void WarbleScanner_Blepp::start(int32_t nopts, const WarbleOption* opts) {
         (it->second)(opts[i].value);
     }
 
-    thread th([this, device, scanType]() {
-        unordered_map<string, WarbleScanPrivateData> seen_devices;
-        unordered_map<string, string> device_names;
+    scan_type = scanType;
+    terminate_scan = false;
+    manual_io = blepp_io_mode() == BleppIoMode::MANUAL;
 
-        terminate_scan = false;
-        scanner = new HCIScanner(true, HCIScanner::FilterDuplicates::Off, scanType, device);
+    if (manual_io) {
+        // the application polls the fd and calls process, nothing runs in the background
+        scanner = blepp_transport::create_scan_source(scanType, device);
+        return;
+    }
+
+    thread th([this, device, scanType]() {
+        scanner = blepp_transport::create_scan_source(scanType, device);
 
         while (!terminate_scan) {
             timeval timeout = { 0, 300000 };
@@ -106,72 +127,12 @@ void WarbleScanner_Blepp::start(int32_t nopts, const WarbleOption* opts) {
             if (select(scanner->get_fd() + 1, &fds, NULL, NULL, &timeout) < 0 && errno == EINTR) {
                 break;
             }
-            if (FD_ISSET(scanner->get_fd(), &fds)) {
-                try {
-                    for (const auto& ad : scanner->get_advertisements()) {
-                        auto addr = to_upper(ad.address);
-                        auto it = seen_devices.find(addr);
-                        if (it == seen_devices.end()) {
-                            WarbleScanPrivateData private_data;
-                            seen_devices.emplace(addr, private_data);
-                            it = seen_devices.find(addr);
-                        }
-
-                        if (ad.type != LeAdvertisingEventType::SCAN_RSP && ad.local_name) {
-                            if (scanType == HCIScanner::ScanType::Passive) {
-                                WarbleScanPrivateData private_data;
-                                for(const auto& uuid: ad.UUIDs) {
-                                    private_data.service_uuids.insert(uuid_to_string(uuid));
-                                }
-
-                                WarbleScanResult result = {
-                                    addr.c_str(),
-                                    ad.local_name ? ad.local_name->name.c_str() : "",
-                                    (int32_t) ad.rssi,
-                                    &private_data
-                                };
-                                scan_result_handler(scan_result_context, &result);
-                            } else {
-                                device_names.emplace(addr, ad.local_name->name);
-
-                                it->second.service_uuids.clear();
-                                for(const auto& uuid: ad.UUIDs) {
-                                    it->second.service_uuids.insert(uuid_to_string(uuid));
-                                }
-                            }
-                        } else if (ad.type == LeAdvertisingEventType::SCAN_RSP) {
-                            it->second.manufacturer_data.clear();
-
-                            if (!ad.manufacturer_specific_data.empty()) {
-                                for (const auto& data_it : ad.manufacturer_specific_data) {
-                                    WarbleScanMftData data = {
-                                        data_it.data() + 2,
-                                        static_cast<uint32_t>(data_it.size() - 2)
-                                    };
-                                    it->second.manufacturer_data.emplace(*((uint16_t*) data_it.data()), data);
-                                }
-                            }
-
-                            if (scan_result_handler != nullptr) {
-                                auto name_it = device_names.find(addr);
-                                WarbleScanResult result = {
-                                    addr.c_str(),
-                                    ad.local_name ? ad.local_name->name.c_str() : (name_it == device_names.end() ? "unknown" : name_it->second.c_str()),
-                                    (int32_t) ad.rssi,
-                                    &it->second
-                                };
-                                scan_result_handler(scan_result_context, &result);
-                            }
-                        }
-                    }
-                } catch (...) {
-                    terminate_scan = true;
-                }
+            if (FD_ISSET(scanner->get_fd(), &fds) && !process_advertisements()) {
+                terminate_scan = true;
             }
         }
 
-        delete scanner;
-        scanner = nullptr;
+        scanner.reset();
 
         seen_devices.clear();
         device_names.clear();
@@ -181,7 +142,93 @@ void WarbleScanner_Blepp::start(int32_t nopts, const WarbleOption* opts) {
 
 void WarbleScanner_Blepp::stop() {
     terminate_scan = true;
-    scan_thread.join();
+
+    if (manual_io) {
+        scanner.reset();
+
+        seen_devices.clear();
+        device_names.clear();
+    } else if (scan_thread.joinable()) {
+        scan_thread.join();
+    }
+}
+
+int32_t WarbleScanner_Blepp::get_fd() const {
+    return manual_io && scanner != nullptr ? scanner->get_fd() : -1;
+}
+
+void WarbleScanner_Blepp::process() {
+    if (!manual_io || scanner == nullptr) {
+        return;
+    }
+
+    if (!process_advertisements()) {
+        stop();
+    }
+}
+
+bool WarbleScanner_Blepp::process_advertisements() {
+    try {
+        for (const auto& ad : scanner->get_advertisements()) {
+            auto addr = to_upper(ad.address);
+            auto it = seen_devices.find(addr);
+            if (it == seen_devices.end()) {
+                WarbleScanPrivateData private_data;
+                seen_devices.emplace(addr, private_data);
+                it = seen_devices.find(addr);
+            }
+
+            if (ad.type != LeAdvertisingEventType::SCAN_RSP && ad.local_name) {
+                if (scan_type == HCIScanner::ScanType::Passive) {
+                    WarbleScanPrivateData private_data;
+                    for(const auto& uuid: ad.UUIDs) {
+                        private_data.service_uuids.insert(uuid_to_string(uuid));
+                    }
+
+                    WarbleScanResult result = {
+                        addr.c_str(),
+                        ad.local_name ? ad.local_name->name.c_str() : "",
+                        (int32_t) ad.rssi,
+                        &private_data
+                    };
+                    scan_result_handler(scan_result_context, &result);
+                } else {
+                    device_names.emplace(addr, ad.local_name->name);
+
+                    it->second.service_uuids.clear();
+                    for(const auto& uuid: ad.UUIDs) {
+                        it->second.service_uuids.insert(uuid_to_string(uuid));
+                    }
+                }
+            } else if (ad.type == LeAdvertisingEventType::SCAN_RSP) {
+                it->second.manufacturer_data.clear();
+
+                if (!ad.manufacturer_specific_data.empty()) {
+                    for (const auto& data_it : ad.manufacturer_specific_data) {
+                        WarbleScanMftData data = {
+                            data_it.data() + 2,
+                            static_cast<uint32_t>(data_it.size() - 2)
+                        };
+                        it->second.manufacturer_data.emplace(*((uint16_t*) data_it.data()), data);
+                    }
+                }
+
+                if (scan_result_handler != nullptr) {
+                    auto name_it = device_names.find(addr);
+                    WarbleScanResult result = {
+                        addr.c_str(),
+                        ad.local_name ? ad.local_name->name.c_str() : (name_it == device_names.end() ? "unknown" : name_it->second.c_str()),
+                        (int32_t) ad.rssi,
+                        &it->second
+                    };
+                    scan_result_handler(scan_result_context, &result);
+                }
+            }
+        }
+    } catch (...) {
+        return false;
+    }
+    return true;
 }
 
 #endif
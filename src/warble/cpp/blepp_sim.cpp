@@ -0,0 +1,897 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_sim.h"
+#include "blepp_att.h"
+#include "uuid128.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+const uint8_t H4_EVENT = 0x04, EVT_LE_META = 0x3e, LE_ADVERTISING_REPORT = 0x02;
+const uint8_t ADV_IND = 0x00, SCAN_RSP = 0x04;
+const uint8_t AD_FLAGS = 0x01, AD_UUID16_ALL = 0x03, AD_UUID128_ALL = 0x07, AD_NAME_COMPLETE = 0x09, AD_MFT_DATA = 0xff;
+// LE General Discoverable, BR/EDR not supported
+const uint8_t AD_FLAGS_VALUE = 0x06;
+const size_t MAX_AD_LEN = 31;
+
+const uint8_t PROP_READ = 0x02, PROP_WRITE_CMD = 0x04, PROP_WRITE = 0x08;
+// ATT error codes blepp_att.h has no use for on the client side
+const uint8_t READ_NOT_PERMITTED = 0x02, WRITE_NOT_PERMITTED = 0x03, INVALID_PDU = 0x04, INVALID_ATTRIBUTE_VALUE_LENGTH = 0x0d,
+        UNSUPPORTED_GROUP_TYPE = 0x10;
+const uint64_t BASE_UUID_LO = 0x800000805f9b34fbULL;
+
+struct Characteristic {
+    Uuid128 uuid;
+    uint8_t properties;
+    vector<uint8_t> value;
+    double notify_rate;
+    size_t notify_len;
+    // only in the tables of the device's first max_links links, 0 for every link
+    size_t max_links;
+};
+
+struct Service {
+    Uuid128 uuid;
+    vector<Characteristic> characteristics;
+};
+
+struct Device {
+    // upper case
+    string mac;
+    string name;
+    bool public_addr;
+    int8_t rssi;
+    uint32_t adv_interval;
+    uint16_t mtu;
+    uint32_t latency;
+    vector<uint8_t> mft_data;
+    vector<Service> services;
+};
+
+using Devices = vector<Device>;
+
+Uuid128 short_uuid(uint16_t value) {
+    return { (static_cast<uint64_t>(value) << 32) | 0x1000, BASE_UUID_LO };
+}
+
+bool is_short(const Uuid128& uuid) {
+    return uuid.lo == BASE_UUID_LO && (uuid.hi & 0xffff0000ffffffffULL) == 0x1000;
+}
+
+// writes the uuid the way ATT carries it, 16-bit if it is built on the base uuid, returns the length
+size_t put_uuid(uint8_t* dest, const Uuid128& uuid) {
+    if (is_short(uuid)) {
+        att::put_le16(dest, static_cast<uint16_t>(uuid.hi >> 32));
+        return 2;
+    }
+    uuid.to_att(dest);
+    return 16;
+}
+
+bool send_packet(int fd, const vector<uint8_t>& packet) {
+    return send(fd, packet.data(), packet.size(), MSG_NOSIGNAL | MSG_DONTWAIT) == static_cast<ssize_t>(packet.size());
+}
+
+/**
+ * Reads the device table, each line is a keyword followed by key=value fields
+ */
+class Parser {
+public:
+    Parser(const string& path) : path(path), line_no(0) {
+    }
+
+    Devices parse() {
+        ifstream file(path);
+        if (!file.is_open()) {
+            throw runtime_error("cannot open sim file '" + path + "' (" + strerror(errno) + ")");
+        }
+
+        string line;
+        while(getline(file, line)) {
+            line_no++;
+
+            istringstream tokens(line);
+            string keyword;
+            if (!(tokens >> keyword) || keyword[0] == '#') {
+                continue;
+            }
+
+            unordered_map<string, string> fields;
+            string token;
+            while(tokens >> token) {
+                auto split = token.find('=');
+                if (split == string::npos || split == 0) {
+                    fail("expected key=value, got '" + token + "'");
+                }
+                fields[token.substr(0, split)] = token.substr(split + 1);
+            }
+
+            if (keyword == "device") {
+                add_device(fields);
+            } else if (keyword == "service") {
+                add_service(fields);
+            } else if (keyword == "char") {
+                add_characteristic(fields);
+            } else {
+                fail("unknown entry '" + keyword + "', one of [device, service, char]");
+            }
+        }
+
+        if (devices.empty()) {
+            fail("no devices defined");
+        }
+        return move(devices);
+    }
+
+private:
+    void add_device(unordered_map<string, string>& fields) {
+        Device device = { "", "", true, -60, 100, att::DEFAULT_LE_MTU, 0, {}, {} };
+
+        device.mac = required(fields, "mac");
+        transform(device.mac.begin(), device.mac.end(), device.mac.begin(), ::toupper);
+        unsigned octets[6];
+        char end;
+        if (sscanf(device.mac.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x%c", &octets[0], &octets[1], &octets[2], &octets[3], &octets[4], &octets[5], &end) != 6 ||
+                device.mac.size() != 17) {
+            fail("invalid mac address '" + device.mac + "'");
+        }
+
+        process(fields, {
+            { "name", [&device](const string& value) { device.name = value; } },
+            { "address-type", [this, &device](const string& value) {
+                if (value == "random") {
+                    device.public_addr = false;
+                } else if (value != "public") {
+                    fail("invalid value for 'address-type': one of [public, random]");
+                }
+            }},
+            { "rssi", [this, &device](const string& value) { device.rssi = static_cast<int8_t>(integer("rssi", value, -127, 20)); } },
+            { "adv-interval", [this, &device](const string& value) { device.adv_interval = static_cast<uint32_t>(integer("adv-interval", value, 0, 10240)); } },
+            { "mtu", [this, &device](const string& value) { device.mtu = static_cast<uint16_t>(integer("mtu", value, att::DEFAULT_LE_MTU, att::MAX_PDU_LEN)); } },
+            { "latency", [this, &device](const string& value) { device.latency = static_cast<uint32_t>(integer("latency", value, 0, 10000000)); } },
+            { "mft-data", [this, &device](const string& value) {
+                device.mft_data = hex("mft-data", value);
+                if (device.mft_data.size() < 2) {
+                    fail("invalid value for 'mft-data': must start with the 2 byte company id");
+                }
+            }}
+        });
+
+        devices.push_back(move(device));
+    }
+
+    void add_service(unordered_map<string, string>& fields) {
+        if (devices.empty()) {
+            fail("service defined before any device");
+        }
+
+        Service service = { uuid(required(fields, "uuid")), {} };
+        process(fields, {});
+        devices.back().services.push_back(move(service));
+    }
+
+    void add_characteristic(unordered_map<string, string>& fields) {
+        if (devices.empty() || devices.back().services.empty()) {
+            fail("characteristic defined before any service");
+        }
+
+        Characteristic characteristic = { uuid(required(fields, "uuid")), 0, {}, 0.0, 20, 0 };
+        istringstream props(required(fields, "props"));
+        string prop;
+        while(getline(props, prop, ',')) {
+            if (prop == "read") {
+                characteristic.properties |= PROP_READ;
+            } else if (prop == "write") {
+                characteristic.properties |= PROP_WRITE;
+            } else if (prop == "write-without-response") {
+                characteristic.properties |= PROP_WRITE_CMD;
+            } else if (prop == "notify") {
+                characteristic.properties |= att::PROP_NOTIFY;
+            } else if (prop == "indicate") {
+                characteristic.properties |= att::PROP_INDICATE;
+            } else {
+                fail("invalid value for 'props': comma separated list of [read, write, write-without-response, notify, indicate]");
+            }
+        }
+
+        process(fields, {
+            { "value", [this, &characteristic](const string& value) {
+                characteristic.value = hex("value", value);
+                if (characteristic.value.size() > att::MAX_ATTR_LEN) {
+                    fail("invalid value for 'value': longer than 512 bytes");
+                }
+            }},
+            { "notify-rate", [this, &characteristic](const string& value) {
+                char* end;
+                characteristic.notify_rate = strtod(value.c_str(), &end);
+                if (value.empty() || *end != '\0' || !(characteristic.notify_rate >= 0.0 && characteristic.notify_rate <= 1000000.0)) {
+                    fail("invalid value for 'notify-rate': must be a non-negative number");
+                }
+            }},
+            { "notify-len", [this, &characteristic](const string& value) { characteristic.notify_len = static_cast<size_t>(integer("notify-len", value, 1, att::MAX_ATTR_LEN)); } },
+            { "links", [this, &characteristic](const string& value) { characteristic.max_links = static_cast<size_t>(integer("links", value, 1, 65535)); } }
+        });
+
+        devices.back().services.back().characteristics.push_back(move(characteristic));
+    }
+
+    // takes the field out of the line so process() does not see it
+    string required(unordered_map<string, string>& fields, const string& key) {
+        auto it = fields.find(key);
+        if (it == fields.end()) {
+            fail("missing '" + key + "'");
+        }
+
+        auto value = move(it->second);
+        fields.erase(it);
+        return value;
+    }
+
+    // runs the processor of every remaining field
+    void process(const unordered_map<string, string>& fields, const unordered_map<string, function<void(const string&)>>& processors) {
+        for(const auto& it: fields) {
+            auto processor = processors.find(it.first);
+            if (processor == processors.end()) {
+                fail("unknown field '" + it.first + "'");
+            }
+            processor->second(it.second);
+        }
+    }
+
+    long integer(const string& key, const string& value, long min, long max) {
+        char* end;
+        long parsed = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || parsed < min || parsed > max) {
+            fail("invalid value for '" + key + "': must be an integer in [" + to_string(min) + ", " + to_string(max) + "]");
+        }
+        return parsed;
+    }
+
+    vector<uint8_t> hex(const string& key, const string& value) {
+        vector<uint8_t> bytes;
+        if (value.size() % 2) {
+            fail("invalid value for '" + key + "': must be an even number of hex digits");
+        }
+        for(size_t i = 0; i < value.size(); i += 2) {
+            char* end;
+            string digits = value.substr(i, 2);
+            auto byte = strtoul(digits.c_str(), &end, 16);
+            if (*end != '\0' || !isxdigit(digits[0])) {
+                fail("invalid value for '" + key + "': must be an even number of hex digits");
+            }
+            bytes.push_back(static_cast<uint8_t>(byte));
+        }
+        return bytes;
+    }
+
+    Uuid128 uuid(const string& value) {
+        Uuid128 parsed;
+        if (value.size() == 4 && all_of(value.begin(), value.end(), ::isxdigit)) {
+            return short_uuid(static_cast<uint16_t>(strtoul(value.c_str(), nullptr, 16)));
+        }
+        if (!Uuid128::parse(value.c_str(), parsed)) {
+            fail("invalid uuid '" + value + "'");
+        }
+        return parsed;
+    }
+
+    [[noreturn]] void fail(const string& reason) {
+        throw runtime_error("sim file '" + path + "' line " + to_string(line_no) + ": " + reason);
+    }
+
+    string path;
+    size_t line_no;
+    Devices devices;
+};
+
+/**
+ * ATT server for one link, built from the device's table when the link is opened
+ */
+class LinkServer {
+public:
+    LinkServer(int fd, shared_ptr<const Devices> devices, size_t index, size_t link) : fd(fd), devices(devices), device((*devices)[index]),
+            mtu(att::DEFAULT_LE_MTU), indication_pending(false) {
+        // declarations, values, and CCCDs get consecutive handles starting from 0x0001
+        for(const auto& service: device.services) {
+            uint8_t raw[16];
+            size_t service_idx = attributes.size();
+            attributes.push_back({ short_uuid(att::PRIMARY_SERVICE_UUID), vector<uint8_t>(raw, raw + put_uuid(raw, service.uuid)), PROP_READ, 0, -1 });
+
+            for(const auto& characteristic: service.characteristics) {
+                // gone from later links, like a firmware update that dropped it
+                if (characteristic.max_links != 0 && link > characteristic.max_links) {
+                    continue;
+                }
+
+                auto value_handle = static_cast<uint16_t>(attributes.size() + 2);
+                uint8_t decl[19] = { characteristic.properties };
+                att::put_le16(decl + 1, value_handle);
+                attributes.push_back({ short_uuid(att::CHARACTERISTIC_UUID), vector<uint8_t>(decl, decl + 3 + put_uuid(decl + 3, characteristic.uuid)), PROP_READ, 0, -1 });
+                attributes.push_back({ characteristic.uuid, characteristic.value, characteristic.properties, 0, -1 });
+
+                if (characteristic.properties & (att::PROP_NOTIFY | att::PROP_INDICATE)) {
+                    attributes.push_back({ short_uuid(att::CCCD_UUID), { 0, 0 }, PROP_READ | PROP_WRITE, 0, static_cast<int>(notifiers.size()) });
+                    notifiers.push_back({ &characteristic, value_handle, 0, 0, steady_clock::time_point() });
+                }
+            }
+            attributes[service_idx].group_end = static_cast<uint16_t>(attributes.size());
+        }
+    }
+
+    void run() {
+        while(true) {
+            auto now = steady_clock::now();
+            while(!delayed.empty() && delayed.front().first <= now) {
+                outgoing.push_back(move(delayed.front().second));
+                delayed.pop_front();
+            }
+            // nothing new is queued while the client is not reading, like a controller out of buffers
+            if (outgoing.empty()) {
+                queue_notifications(now);
+            }
+            if (!flush()) {
+                break;
+            }
+
+            auto deadline = steady_clock::time_point::max();
+            if (!delayed.empty()) {
+                deadline = delayed.front().first;
+            }
+            if (outgoing.empty()) {
+                for(const auto& it: notifiers) {
+                    if (can_send(it)) {
+                        deadline = min(deadline, it.next);
+                    }
+                }
+            }
+
+            timespec timeout, *wait = nullptr;
+            if (deadline != steady_clock::time_point::max()) {
+                auto remaining = max<int64_t>(0, duration_cast<nanoseconds>(deadline - steady_clock::now()).count());
+                timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+                timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+                wait = &timeout;
+            }
+
+            pollfd fds = { fd, static_cast<short>(POLLIN | (outgoing.empty() ? 0 : POLLOUT)), 0 };
+            int status = ppoll(&fds, 1, wait, nullptr);
+            if (status < 0 && errno != EINTR) {
+                break;
+            }
+            if (status > 0 && (fds.revents & (POLLIN | POLLERR | POLLHUP)) && !process_request()) {
+                break;
+            }
+        }
+
+        close(fd);
+    }
+
+private:
+    struct Attribute {
+        Uuid128 type;
+        vector<uint8_t> value;
+        uint8_t properties;
+        // last handle of the service, only set on service declarations
+        uint16_t group_end;
+        // notifier the attribute is the CCCD of, -1 for other attributes
+        int notifier;
+    };
+
+    struct Notifier {
+        const Characteristic* characteristic;
+        uint16_t value_handle, cccd;
+        uint32_t counter;
+        steady_clock::time_point next;
+    };
+
+    bool can_send(const Notifier& notifier) const {
+        return notifier.characteristic->notify_rate > 0.0 && ((notifier.cccd & att::CCCD_NOTIFY) ||
+                ((notifier.cccd & att::CCCD_INDICATE) && !indication_pending));
+    }
+
+    void queue_notifications(steady_clock::time_point now) {
+        for(auto& it: notifiers) {
+            if (!can_send(it) || it.next > now) {
+                continue;
+            }
+
+            auto len = min(it.characteristic->notify_len, static_cast<size_t>(mtu - 3));
+            vector<uint8_t> pdu(3 + len);
+            for(size_t i = 0; i < 4 && i < len; i++) {
+                pdu[3 + i] = static_cast<uint8_t>(it.counter >> (8 * i));
+            }
+            if (len > 4) {
+                const auto& value = it.characteristic->value;
+                copy(value.begin(), value.begin() + min(value.size(), len - 4), pdu.begin() + 3 + 4);
+            }
+
+            bool notify = (it.cccd & att::CCCD_NOTIFY) != 0;
+            pdu[0] = notify ? att::HANDLE_NOTIFY : att::HANDLE_IND;
+            att::put_le16(pdu.data() + 1, it.value_handle);
+            outgoing.push_back(move(pdu));
+            indication_pending |= !notify;
+            it.counter++;
+
+            // a client that fell far behind gets the current rate rather than a burst of everything it missed
+            it.next += duration_cast<steady_clock::duration>(duration<double>(1.0 / it.characteristic->notify_rate));
+            if (it.next + seconds(1) < now) {
+                it.next = now;
+            }
+        }
+    }
+
+    // returns false once the client closed its end
+    bool flush() {
+        while(!outgoing.empty()) {
+            if (!send_packet(fd, outgoing.front())) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+            outgoing.pop_front();
+        }
+        return true;
+    }
+
+    // returns false once the client closed its end
+    bool process_request() {
+        uint8_t pdu[att::MAX_PDU_LEN];
+        ssize_t len = recv(fd, pdu, sizeof(pdu), MSG_DONTWAIT);
+        if (len < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        if (len == 0) {
+            return false;
+        }
+
+        auto response = respond(pdu, static_cast<size_t>(len));
+        if (!response.empty()) {
+            if (device.latency == 0 && delayed.empty()) {
+                outgoing.push_back(move(response));
+            } else {
+                delayed.emplace_back(steady_clock::now() + microseconds(device.latency), move(response));
+            }
+        }
+        return true;
+    }
+
+    static vector<uint8_t> error(uint8_t request, uint16_t handle, uint8_t code) {
+        vector<uint8_t> response(5);
+        att::encode_error_rsp(response.data(), request, handle, code);
+        return response;
+    }
+
+    Attribute* find(uint16_t handle) {
+        return handle == 0 || handle > attributes.size() ? nullptr : &attributes[handle - 1];
+    }
+
+    // returns an empty vector for PDUs that are not answered
+    vector<uint8_t> respond(const uint8_t* pdu, size_t len) {
+        uint8_t opcode = pdu[0];
+        uint16_t handle = len >= 3 ? att::get_le16(pdu + 1) : 0;
+
+        switch(opcode) {
+        case att::MTU_REQ: {
+            if (len != 3) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+            mtu = max(att::DEFAULT_LE_MTU, min(handle, device.mtu));
+
+            vector<uint8_t> response(3);
+            att::encode_mtu(response.data(), att::MTU_RSP, device.mtu);
+            return response;
+        }
+        case att::FIND_INFO_REQ:
+        case att::READ_BY_TYPE_REQ:
+        case att::READ_BY_GROUP_REQ: {
+            uint16_t end = len >= 5 ? att::get_le16(pdu + 3) : 0;
+            if (len < 5 || (opcode != att::FIND_INFO_REQ && len != 7 && len != 21)) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+            if (handle == 0 || handle > end) {
+                return error(opcode, handle, att::INVALID_HANDLE);
+            }
+
+            if (opcode == att::FIND_INFO_REQ) {
+                return find_information(handle, end);
+            }
+
+            auto type = Uuid128::from_att(pdu + 5, len - 5);
+            if (opcode == att::READ_BY_GROUP_REQ && type != short_uuid(att::PRIMARY_SERVICE_UUID)) {
+                return error(opcode, handle, UNSUPPORTED_GROUP_TYPE);
+            }
+            return read_by_type(opcode, handle, end, type);
+        }
+        case att::READ_REQ:
+        case att::READ_BLOB_REQ: {
+            if (len != (opcode == att::READ_REQ ? 3u : 5u)) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+
+            auto attribute = find(handle);
+            if (attribute == nullptr) {
+                return error(opcode, handle, att::INVALID_HANDLE);
+            }
+            if (!(attribute->properties & PROP_READ)) {
+                return error(opcode, handle, READ_NOT_PERMITTED);
+            }
+
+            size_t offset = opcode == att::READ_BLOB_REQ ? att::get_le16(pdu + 3) : 0;
+            if (offset > attribute->value.size()) {
+                return error(opcode, handle, att::INVALID_OFFSET);
+            }
+
+            vector<uint8_t> response = { static_cast<uint8_t>(opcode + 1) };
+            response.insert(response.end(), attribute->value.begin() + offset, attribute->value.begin() + min(attribute->value.size(), offset + mtu - 1));
+            return response;
+        }
+        case att::READ_MULTI_VAR_REQ: {
+            if (len < 5 || (len - 1) % 2) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+
+            vector<uint8_t> response = { att::READ_MULTI_VAR_RSP };
+            for(size_t i = 1; i < len; i += 2) {
+                handle = att::get_le16(pdu + i);
+                auto attribute = find(handle);
+                if (attribute == nullptr) {
+                    return error(opcode, handle, att::INVALID_HANDLE);
+                }
+                if (!(attribute->properties & PROP_READ)) {
+                    return error(opcode, handle, READ_NOT_PERMITTED);
+                }
+
+                // the length is always complete, the value is cut once the response is full
+                uint8_t value_len[2];
+                att::put_le16(value_len, static_cast<uint16_t>(attribute->value.size()));
+                response.insert(response.end(), value_len, value_len + 2);
+                response.insert(response.end(), attribute->value.begin(), attribute->value.end());
+            }
+            response.resize(min(response.size(), static_cast<size_t>(mtu)));
+            return response;
+        }
+        case att::WRITE_REQ:
+        case att::WRITE_CMD: {
+            bool with_response = opcode == att::WRITE_REQ;
+            auto code = len < 3 ? INVALID_PDU : write(handle, pdu + 3, len - 3, with_response ? PROP_WRITE : PROP_WRITE_CMD);
+            if (!with_response) {
+                return {};
+            }
+            return code ? error(opcode, handle, code) : vector<uint8_t>{ att::WRITE_RSP };
+        }
+        case att::PREP_WRITE_REQ: {
+            if (len < 5) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+
+            auto attribute = find(handle);
+            if (attribute == nullptr) {
+                return error(opcode, handle, att::INVALID_HANDLE);
+            }
+            if (!(attribute->properties & PROP_WRITE)) {
+                return error(opcode, handle, WRITE_NOT_PERMITTED);
+            }
+
+            prepared.push_back({ handle, att::get_le16(pdu + 3), vector<uint8_t>(pdu + 5, pdu + len) });
+            vector<uint8_t> response(pdu, pdu + len);
+            response[0] = att::PREP_WRITE_RSP;
+            return response;
+        }
+        case att::EXEC_WRITE_REQ: {
+            if (len != 2) {
+                return error(opcode, 0, INVALID_PDU);
+            }
+
+            auto writes = move(prepared);
+            prepared.clear();
+            if (pdu[1] == att::EXEC_WRITE_COMMIT) {
+                // builds every value before writing any of them, a bad offset leaves the attributes untouched
+                unordered_map<uint16_t, vector<uint8_t>> values;
+                for(const auto& it: writes) {
+                    auto& value = values.emplace(it.handle, vector<uint8_t>()).first->second;
+                    if (it.offset > value.size()) {
+                        return error(opcode, it.handle, att::INVALID_OFFSET);
+                    }
+                    value.resize(max(value.size(), it.offset + it.value.size()));
+                    copy(it.value.begin(), it.value.end(), value.begin() + it.offset);
+                }
+                for(const auto& it: values) {
+                    if (auto code = write(it.first, it.second.data(), it.second.size(), PROP_WRITE)) {
+                        return error(opcode, it.first, code);
+                    }
+                }
+            }
+            return { att::EXEC_WRITE_RSP };
+        }
+        case att::HANDLE_CONF:
+            indication_pending = false;
+            return {};
+        default:
+            return att::is_request(opcode) ? error(opcode, 0, att::REQUEST_NOT_SUPPORTED) : vector<uint8_t>();
+        }
+    }
+
+    // returns the ATT error code, 0 if the value was written
+    uint8_t write(uint16_t handle, const uint8_t* value, size_t len, uint8_t permission) {
+        auto attribute = find(handle);
+        if (attribute == nullptr) {
+            return att::INVALID_HANDLE;
+        }
+        if (!(attribute->properties & permission)) {
+            return WRITE_NOT_PERMITTED;
+        }
+        if (len > att::MAX_ATTR_LEN || (attribute->notifier >= 0 && len != 2)) {
+            return INVALID_ATTRIBUTE_VALUE_LENGTH;
+        }
+
+        attribute->value.assign(value, value + len);
+        if (attribute->notifier >= 0) {
+            auto& notifier = notifiers[attribute->notifier];
+            notifier.cccd = att::get_le16(value) & ((notifier.characteristic->properties & att::PROP_NOTIFY ? att::CCCD_NOTIFY : 0) |
+                    (notifier.characteristic->properties & att::PROP_INDICATE ? att::CCCD_INDICATE : 0));
+            notifier.next = steady_clock::now();
+        }
+        return 0;
+    }
+
+    vector<uint8_t> find_information(uint16_t start, uint16_t end) {
+        vector<uint8_t> response = { att::FIND_INFO_RSP, 0 };
+        for(uint32_t handle = start; handle <= end && handle <= attributes.size(); handle++) {
+            uint8_t raw[16];
+            size_t uuid_len = put_uuid(raw, attributes[handle - 1].type);
+            uint8_t format = uuid_len == 2 ? 1 : 2;
+
+            // every entry uses the format of the first one
+            if ((response[1] != 0 && response[1] != format) || response.size() + 2 + uuid_len > mtu) {
+                break;
+            }
+            response[1] = format;
+            response.push_back(handle & 0xff);
+            response.push_back((handle >> 8) & 0xff);
+            response.insert(response.end(), raw, raw + uuid_len);
+        }
+
+        return response[1] ? response : error(att::FIND_INFO_REQ, start, att::ATTRIBUTE_NOT_FOUND);
+    }
+
+    vector<uint8_t> read_by_type(uint8_t opcode, uint16_t start, uint16_t end, const Uuid128& type) {
+        bool group = opcode == att::READ_BY_GROUP_REQ;
+        size_t header_len = group ? 4 : 2;
+        vector<uint8_t> response = { static_cast<uint8_t>(opcode + 1), 0 };
+
+        for(uint32_t handle = start; handle <= end && handle <= attributes.size(); handle++) {
+            const auto& attribute = attributes[handle - 1];
+            if (attribute.type != type) {
+                continue;
+            }
+            if (!(attribute.properties & PROP_READ)) {
+                if (response[1] == 0) {
+                    return error(opcode, static_cast<uint16_t>(handle), READ_NOT_PERMITTED);
+                }
+                break;
+            }
+
+            // every entry has the length of the first one, values too long for it are cut
+            size_t value_len = min(attribute.value.size(), min<size_t>(mtu - 2, 255) - header_len);
+            if (response[1] == 0) {
+                response[1] = static_cast<uint8_t>(header_len + value_len);
+            } else if (response[1] != header_len + value_len || response.size() + response[1] > mtu) {
+                break;
+            }
+
+            response.push_back(handle & 0xff);
+            response.push_back((handle >> 8) & 0xff);
+            if (group) {
+                response.push_back(attribute.group_end & 0xff);
+                response.push_back((attribute.group_end >> 8) & 0xff);
+            }
+            response.insert(response.end(), attribute.value.begin(), attribute.value.begin() + value_len);
+        }
+
+        return response[1] ? response : error(opcode, start, att::ATTRIBUTE_NOT_FOUND);
+    }
+
+    struct PreparedWrite {
+        uint16_t handle;
+        size_t offset;
+        vector<uint8_t> value;
+    };
+
+    int fd;
+    // keeps the characteristics the notifiers point to alive
+    shared_ptr<const Devices> devices;
+    const Device& device;
+    uint16_t mtu;
+    bool indication_pending;
+    vector<Attribute> attributes;
+    vector<Notifier> notifiers;
+    vector<PreparedWrite> prepared;
+    deque<vector<uint8_t>> outgoing;
+    deque<pair<steady_clock::time_point, vector<uint8_t>>> delayed;
+};
+
+// appends an AD structure if there is room left in the 31 byte payload
+void add_ad(vector<uint8_t>& data, uint8_t type, const uint8_t* value, size_t len) {
+    if (data.size() + 2 + len <= MAX_AD_LEN) {
+        data.push_back(static_cast<uint8_t>(len + 1));
+        data.push_back(type);
+        data.insert(data.end(), value, value + len);
+    }
+}
+
+vector<uint8_t> advertising_report(const Device& device, uint8_t event_type, const vector<uint8_t>& data) {
+    // event code, parameter length, subevent, report count, event type, address type, address, data length, data, rssi
+    vector<uint8_t> packet = { H4_EVENT, EVT_LE_META, static_cast<uint8_t>(12 + data.size()), LE_ADVERTISING_REPORT, 1, event_type,
+            static_cast<uint8_t>(device.public_addr ? 0 : 1) };
+
+    unsigned octets[6];
+    sscanf(device.mac.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x", &octets[0], &octets[1], &octets[2], &octets[3], &octets[4], &octets[5]);
+    // sent least significant byte first
+    for(int i = 5; i >= 0; i--) {
+        packet.push_back(static_cast<uint8_t>(octets[i]));
+    }
+
+    packet.push_back(static_cast<uint8_t>(data.size()));
+    packet.insert(packet.end(), data.begin(), data.end());
+    packet.push_back(static_cast<uint8_t>(device.rssi));
+    return packet;
+}
+
+/**
+ * Advertising data and scan response of a device, both sent every advertising interval
+ */
+pair<vector<uint8_t>, vector<uint8_t>> advertisement(const Device& device) {
+    vector<uint8_t> adv_data, scan_rsp_data;
+    add_ad(adv_data, AD_FLAGS, &AD_FLAGS_VALUE, 1);
+
+    vector<uint8_t> uuids16, uuids128;
+    for(const auto& service: device.services) {
+        uint8_t raw[16];
+        auto& uuids = is_short(service.uuid) ? uuids16 : uuids128;
+        uuids.insert(uuids.end(), raw, raw + put_uuid(raw, service.uuid));
+    }
+    if (!uuids16.empty()) {
+        add_ad(adv_data, AD_UUID16_ALL, uuids16.data(), uuids16.size());
+    }
+    if (!uuids128.empty()) {
+        add_ad(adv_data, AD_UUID128_ALL, uuids128.data(), uuids128.size());
+    }
+
+    auto name = reinterpret_cast<const uint8_t*>(device.name.data());
+    if (!device.name.empty()) {
+        // the name goes wherever it still fits, the scan response if the service uuids filled the advertisement
+        auto before = adv_data.size();
+        add_ad(adv_data, AD_NAME_COMPLETE, name, device.name.size());
+        if (adv_data.size() == before) {
+            add_ad(scan_rsp_data, AD_NAME_COMPLETE, name, min(device.name.size(), MAX_AD_LEN - 2));
+        }
+    }
+    if (!device.mft_data.empty()) {
+        add_ad(scan_rsp_data, AD_MFT_DATA, device.mft_data.data(), min(device.mft_data.size(), MAX_AD_LEN - 2 - scan_rsp_data.size()));
+    }
+
+    return { advertising_report(device, ADV_IND, adv_data), advertising_report(device, SCAN_RSP, scan_rsp_data) };
+}
+
+class SimPeer : public BleppPeer {
+public:
+    SimPeer(shared_ptr<const Devices> devices) : devices(devices), links(devices->size(), 0) {
+    }
+
+    virtual void serve_link(int fd, const string& mac) {
+        string upper(mac);
+        transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+        size_t index = 0;
+        while(index < devices->size() && (*devices)[index].mac != upper) {
+            index++;
+        }
+
+        // the link fails like a connect to a device that is not around
+        if (index == devices->size()) {
+            close(fd);
+            return;
+        }
+
+        size_t link;
+        {
+            lock_guard<mutex> lock(links_mutex);
+            link = ++links[index];
+        }
+
+        auto devices = this->devices;
+        thread th([fd, devices, index, link]() {
+            LinkServer(fd, devices, index, link).run();
+        });
+        th.detach();
+    }
+
+    virtual void serve_scan(int fd) {
+        auto devices = this->devices;
+        thread th([fd, devices]() {
+            struct Advertiser {
+                pair<vector<uint8_t>, vector<uint8_t>> packets;
+                milliseconds interval;
+                steady_clock::time_point next;
+            };
+
+            vector<Advertiser> advertisers;
+            auto start = steady_clock::now();
+            for(const auto& it: *devices) {
+                if (it.adv_interval) {
+                    advertisers.push_back({ advertisement(it), milliseconds(it.adv_interval), start });
+                }
+            }
+
+            // runs until the scanner closes its end, a report the scanner has no room for is dropped like an over the air collision
+            while(true) {
+                auto now = steady_clock::now();
+                auto deadline = steady_clock::time_point::max();
+                for(auto& it: advertisers) {
+                    if (it.next <= now) {
+                        send_packet(fd, it.packets.first);
+                        send_packet(fd, it.packets.second);
+                        it.next = max(it.next + it.interval, now);
+                    }
+                    deadline = min(deadline, it.next);
+                }
+
+                int timeout = deadline == steady_clock::time_point::max() ? -1 :
+                        max(0, static_cast<int>(duration_cast<milliseconds>(deadline - steady_clock::now() + milliseconds(1)).count()));
+                pollfd fds = { fd, POLLIN, 0 };
+                int status = poll(&fds, 1, timeout < 0 ? -1 : timeout);
+                if (status < 0 && errno != EINTR) {
+                    break;
+                }
+
+                if (status > 0) {
+                    uint8_t discard[1];
+                    ssize_t len = recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+                    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+                        break;
+                    }
+                }
+            }
+            close(fd);
+        });
+        th.detach();
+    }
+
+private:
+    shared_ptr<const Devices> devices;
+    mutex links_mutex;
+    // links served so far for each device
+    vector<size_t> links;
+};
+
+}
+
+shared_ptr<BleppPeer> sim::open(const string& path) {
+    return make_shared<SimPeer>(make_shared<const Devices>(Parser(path).parse()));
+}
+
+#endif
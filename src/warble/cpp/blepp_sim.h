@@ -0,0 +1,41 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "blepp_transport.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Simulated peripherals that play the remote side of warble's links and scans, so the library can run without a
+ * Bluetooth controller.  Each link gets a fresh copy of its device's attribute table and an ATT server of its own,
+ * writes only last for the connection.  Scans receive an advertising report and a scan response from every device
+ * once per advertising interval.
+ *
+ * Devices are described in a text file, one entry per line with whitespace separated key=value fields.  Lines
+ * starting with '#' are comments.  Services belong to the device above them, and characteristics to the service
+ * above them:
+ *
+ *     device mac=<address> [name=<local name>] [address-type=public|random] [rssi=<dBm>] [adv-interval=<ms, 0 to not advertise>]
+ *            [mtu=<largest ATT MTU>] [latency=<us before each response>] [mft-data=<hex, company id first>]
+ *     service uuid=<uuid>
+ *     char uuid=<uuid> props=<comma separated read, write, write-without-response, notify, indicate> [value=<hex>]
+ *          [notify-rate=<notifications per second>] [notify-len=<bytes>] [links=<only served on the device's first n links>]
+ *
+ * Uuids are either the 36 character form or 4 hex digits for 16-bit uuids.  Once the client turns them on,
+ * notifications or indications are sent at notify-rate.  Their value is a 32-bit little endian counter followed by
+ * the characteristic's value, cut or zero padded to notify-len bytes.  Notifications are held back while the
+ * client is not reading.
+ */
+namespace sim {
+    /**
+     * Loads the devices from a file in the format above, throws runtime_error if it cannot be read or has an invalid line
+     */
+    std::shared_ptr<BleppPeer> open(const std::string& path);
+}
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ * @copyright MbientLab License
+ */
+#ifdef API_BLEPP
+
+#include "blepp_transport.h"
+#include "blepp_capture.h"
+#include "blepp/blestatemachine.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace BLEPP;
+
+BleppLink::~BleppLink() {
+}
+
+BleppScanSource::~BleppScanSource() {
+}
+
+BleppPeer::~BleppPeer() {
+}
+
+namespace {
+
+class L2capLink : public BleppLink {
+public:
+    L2capLink() {
+        gatt.cb_connected = [this]() {
+            on_connected();
+        };
+        gatt.cb_disconnected = [this](BLEGATTStateMachine::Disconnect d) {
+            if (on_disconnected) {
+                on_disconnected(d.error_code);
+            }
+        };
+    }
+
+    virtual void connect(const string& mac, bool public_addr, const string& device) {
+        gatt.connect(mac, false, public_addr, device);
+    }
+
+    virtual void close() {
+        gatt.close();
+    }
+
+    virtual int socket() const {
+        return const_cast<BLEGATTStateMachine&>(gatt).socket();
+    }
+
+    virtual bool wait_on_write() const {
+        return const_cast<BLEGATTStateMachine&>(gatt).wait_on_write();
+    }
+
+    virtual void write_and_process_next() {
+        gatt.write_and_process_next();
+    }
+
+    virtual void read_and_process_next() {
+        gatt.read_and_process_next();
+    }
+
+    virtual bool on_adapter() const {
+        return true;
+    }
+
+private:
+    BLEGATTStateMachine gatt;
+};
+
+class PeerLink : public BleppLink {
+public:
+    PeerLink(shared_ptr<BleppPeer> peer) : peer(peer), sock(-1), connecting(false) {
+    }
+
+    virtual ~PeerLink() {
+        close();
+    }
+
+    virtual void connect(const string& mac, bool public_addr, const string& device) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0) {
+            throw runtime_error(strerror(errno));
+        }
+
+        // the peer's end blocks, it runs on a thread of its own
+        int flags = fcntl(fds[1], F_GETFL);
+        fcntl(fds[1], F_SETFL, flags & ~O_NONBLOCK);
+
+        sock = fds[0];
+        connecting = true;
+        peer->serve_link(fds[1], mac);
+    }
+
+    virtual void close() {
+        if (sock >= 0) {
+            ::close(sock);
+            sock = -1;
+        }
+        connecting = false;
+    }
+
+    virtual int socket() const {
+        return sock;
+    }
+
+    virtual bool wait_on_write() const {
+        return connecting;
+    }
+
+    virtual void write_and_process_next() {
+        // a socket pair is connected as soon as it exists, report it on the first wakeup like an L2CAP connect
+        if (connecting) {
+            connecting = false;
+            on_connected();
+        }
+    }
+
+    virtual void read_and_process_next() {
+        // only reached before on_connected, a readable socket at that point means the peer closed its end
+        uint8_t pdu[1];
+        ssize_t len = recv(sock, pdu, sizeof(pdu), MSG_DONTWAIT);
+        if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        if (on_disconnected) {
+            on_disconnected(len < 0 ? errno : ECONNREFUSED);
+        }
+    }
+
+    virtual bool on_adapter() const {
+        return false;
+    }
+
+private:
+    shared_ptr<BleppPeer> peer;
+    int sock;
+    bool connecting;
+};
+
+class HciScanSource : public BleppScanSource {
+public:
+    HciScanSource(HCIScanner::ScanType type, const string& device) : scanner(true, HCIScanner::FilterDuplicates::Off, type, device) {
+    }
+
+    virtual int get_fd() const {
+        return scanner.get_fd();
+    }
+
+    virtual vector<AdvertisingResponse> get_advertisements() {
+        if (!btsnoop::enabled()) {
+            return scanner.get_advertisements();
+        }
+
+        // reads the event like HCIScanner::get_advertisements does, keeping a copy of the raw packet for the capture file
+        vector<uint8_t> packet(258);
+        ssize_t len;
+        do {
+            len = read(scanner.get_fd(), packet.data(), packet.size());
+        } while(len < 0 && (errno == EINTR || errno == EAGAIN));
+
+        if (len < 0) {
+            throw runtime_error(strerror(errno));
+        }
+        packet.resize(static_cast<size_t>(len));
+
+        btsnoop::hci_event(packet.data(), packet.size());
+        return HCIScanner::parse_packet(packet);
+    }
+
+private:
+    HCIScanner scanner;
+};
+
+class PeerScanSource : public BleppScanSource {
+public:
+    PeerScanSource(BleppPeer& peer) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+            throw runtime_error(strerror(errno));
+        }
+
+        sock = fds[0];
+        peer.serve_scan(fds[1]);
+    }
+
+    virtual ~PeerScanSource() {
+        ::close(sock);
+    }
+
+    virtual int get_fd() const {
+        return sock;
+    }
+
+    virtual vector<AdvertisingResponse> get_advertisements() {
+        vector<uint8_t> packet(258);
+        ssize_t len;
+        do {
+            len = recv(sock, packet.data(), packet.size(), 0);
+        } while(len < 0 && errno == EINTR);
+
+        if (len <= 0) {
+            throw runtime_error(len < 0 ? strerror(errno) : "scan source closed");
+        }
+        packet.resize(static_cast<size_t>(len));
+
+        return HCIScanner::parse_packet(packet);
+    }
+
+private:
+    int sock;
+};
+
+mutex peer_mutex;
+shared_ptr<BleppPeer> active_peer;
+
+shared_ptr<BleppPeer> current_peer() {
+    lock_guard<mutex> lock(peer_mutex);
+    return active_peer;
+}
+
+}
+
+void blepp_transport::set_peer(shared_ptr<BleppPeer> peer) {
+    lock_guard<mutex> lock(peer_mutex);
+    active_peer = peer;
+}
+
+unique_ptr<BleppLink> blepp_transport::create_link() {
+    auto peer = current_peer();
+    if (peer != nullptr) {
+        return unique_ptr<BleppLink>(new PeerLink(peer));
+    }
+    return unique_ptr<BleppLink>(new L2capLink());
+}
+
+unique_ptr<BleppScanSource> blepp_transport::create_scan_source(HCIScanner::ScanType type, const string& device) {
+    auto peer = current_peer();
+    if (peer != nullptr) {
+        return unique_ptr<BleppScanSource>(new PeerScanSource(*peer));
+    }
+    return unique_ptr<BleppScanSource>(new HciScanSource(type, device));
+}
+
+#endif
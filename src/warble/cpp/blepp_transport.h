@@ -0,0 +1,93 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#ifdef API_BLEPP
+
+#include "blepp/lescan.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Socket that carries a WarbleGatt object's ATT bearer.  Usually an L2CAP socket libblepp connects to a remote
+ * device through a local adapter, but it can also be one end of a socket pair whose other end is served in process
+ */
+class BleppLink {
+public:
+    virtual ~BleppLink() = 0;
+
+    /**
+     * Starts a non-blocking connect, throws std::exception if it cannot be started
+     */
+    virtual void connect(const std::string& mac, bool public_addr, const std::string& device) = 0;
+    virtual void close() = 0;
+    virtual int socket() const = 0;
+
+    /**
+     * Whether the socket has to be polled for write while the link is coming up
+     */
+    virtual bool wait_on_write() const = 0;
+    // Advance the connect once the socket is ready, on_connected or on_disconnected is called from these
+    virtual void write_and_process_next() = 0;
+    virtual void read_and_process_next() = 0;
+
+    /**
+     * False if the link does not go through a local adapter, HCI commands do not apply to it
+     */
+    virtual bool on_adapter() const = 0;
+
+    std::function<void()> on_connected;
+    std::function<void(int)> on_disconnected;
+};
+
+/**
+ * Source of advertising reports for the scanner
+ */
+class BleppScanSource {
+public:
+    virtual ~BleppScanSource() = 0;
+
+    virtual int get_fd() const = 0;
+    /**
+     * Reads the next packet from the fd, throws std::exception if it cannot be read
+     */
+    virtual std::vector<BLEPP::AdvertisingResponse> get_advertisements() = 0;
+};
+
+/**
+ * Plays the remote side of links and scans in process, in place of the local adapters.  Each call hands over one
+ * end of a socket pair which the peer serves from its own thread, closing it when done.  The warble side closing
+ * its end tells the peer to stop
+ */
+class BleppPeer {
+public:
+    virtual ~BleppPeer() = 0;
+
+    /**
+     * Serves the ATT bearer of a link to the given mac address, one ATT PDU per packet
+     */
+    virtual void serve_link(int fd, const std::string& mac) = 0;
+    /**
+     * Serves HCI events to a scanner, one packet per event in the form a raw HCI socket returns them
+     */
+    virtual void serve_scan(int fd) = 0;
+};
+
+namespace blepp_transport {
+    /**
+     * Routes links and scans created from here on to the peer, nullptr restores the local adapters
+     */
+    void set_peer(std::shared_ptr<BleppPeer> peer);
+
+    std::unique_ptr<BleppLink> create_link();
+    /**
+     * Throws std::exception if scanning cannot be started
+     */
+    std::unique_ptr<BleppScanSource> create_scan_source(BLEPP::HCIScanner::ScanType type, const std::string& device);
+}
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "warble/connmgr.h"
+#include "error_messages.h"
+#include "gatt_def.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct WarbleConnMgr {
+    WarbleConnMgr(size_t connects_per_adapter, size_t retries);
+    ~WarbleConnMgr();
+
+    void connect_async(WarbleGatt* const* gatts, int32_t ngatts, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+    int32_t get_pending() const;
+
+private:
+    struct Attempt {
+        WarbleConnMgr* owner;
+        WarbleGatt* gatt;
+        // adapter whose slot the attempt holds while it runs
+        string adapter;
+        // number of times connect_async has been called for the gatt
+        size_t tries;
+
+        void* context;
+        FnVoid_VoidP_WarbleGattP_CharP handler;
+    };
+
+    static void on_connected(void* context, WarbleGatt* caller, const char* value);
+
+    // Starts queued attempts in order, each on the adapter its gatt picks from those with a free slot
+    void dispatch();
+
+    size_t connects_per_adapter, retries;
+
+    mutable mutex m;
+    condition_variable idle;
+    // the adapter is only known once an attempt starts, balanced gatts pick one each time
+    deque<Attempt*> queued;
+    unordered_map<string, size_t> active;
+    size_t pending;
+};
+
+WarbleConnMgr::WarbleConnMgr(size_t connects_per_adapter, size_t retries) : connects_per_adapter(connects_per_adapter), retries(retries), pending(0) {
+}
+
+WarbleConnMgr::~WarbleConnMgr() {
+    vector<Attempt*> cancelled;
+    {
+        unique_lock<mutex> lock(m);
+        cancelled.assign(queued.begin(), queued.end());
+        pending -= queued.size();
+        queued.clear();
+    }
+
+    for(auto it: cancelled) {
+        it->handler(it->context, it->gatt, WARBLE_CONNMGR_CANCELLED);
+        delete it;
+    }
+
+    unique_lock<mutex> lock(m);
+    idle.wait(lock, [this]() { return pending == 0; });
+}
+
+void WarbleConnMgr::connect_async(WarbleGatt* const* gatts, int32_t ngatts, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    {
+        lock_guard<mutex> lock(m);
+        for(int32_t i = 0; i < ngatts; i++) {
+            queued.push_back(new Attempt { this, gatts[i], "", 0, context, handler });
+            pending++;
+        }
+    }
+
+    dispatch();
+}
+
+int32_t WarbleConnMgr::get_pending() const {
+    lock_guard<mutex> lock(m);
+    return static_cast<int32_t>(pending);
+}
+
+void WarbleConnMgr::dispatch() {
+    vector<Attempt*> starting;
+    {
+        lock_guard<mutex> lock(m);
+        vector<string> full;
+        for(auto& it: active) {
+            if (it.second >= connects_per_adapter) {
+                full.push_back(it.first);
+            }
+        }
+
+        // an attempt waiting on a busy adapter does not hold up the ones behind it
+        for(auto it = queued.begin(); it != queued.end();) {
+            auto adapter = (*it)->gatt->choose_adapter(full);
+            if (adapter == nullptr || active[adapter] >= connects_per_adapter) {
+                it++;
+                continue;
+            }
+
+            (*it)->adapter = adapter;
+            if (++active[adapter] >= connects_per_adapter) {
+                full.push_back(adapter);
+            }
+            starting.push_back(*it);
+            it = queued.erase(it);
+        }
+    }
+
+    // connect_async may report a failure before returning, which re-enters dispatch
+    for(auto it: starting) {
+        it->tries++;
+        it->gatt->connect_async(it, on_connected);
+    }
+}
+
+void WarbleConnMgr::on_connected(void* context, WarbleGatt* caller, const char* value) {
+    auto attempt = static_cast<Attempt*>(context);
+    auto owner = attempt->owner;
+    bool done;
+    {
+        lock_guard<mutex> lock(owner->m);
+        owner->active[attempt->adapter]--;
+        // an attempt the caller cancelled is not retried
+        done = value == nullptr || attempt->tries > owner->retries || !strcmp(value, WARBLE_CONNECT_CANCELLED);
+        if (!done) {
+            // back of the line so one unreachable device does not hold up the rest
+            owner->queued.push_back(attempt);
+        }
+    }
+
+    // free the slot for the next device before handing control to the caller
+    owner->dispatch();
+
+    if (done) {
+        attempt->handler(attempt->context, caller, value);
+        delete attempt;
+
+        lock_guard<mutex> lock(owner->m);
+        if (--owner->pending == 0) {
+            owner->idle.notify_all();
+        }
+    }
+}
+
+WarbleConnMgr* warble_connmgr_create(int32_t nopts, const WarbleOption* opts) {
+    size_t connects_per_adapter = 1, retries = 2;
+    unordered_map<string, function<void(const char*)>> arg_processors = {
+        {"connects-per-adapter", [&connects_per_adapter](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'connects-per-adapter\' option: must be a positive integer");
+            }
+            connects_per_adapter = static_cast<size_t>(parsed);
+        }},
+        {"retries", [&retries](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < 0) {
+                throw runtime_error("invalid value for \'retries\' option: must be a non-negative integer");
+            }
+            retries = static_cast<size_t>(parsed);
+        }},
+    };
+
+    for(int i = 0; i < nopts; i++) {
+        auto it = arg_processors.find(opts[i].key);
+        if (it == arg_processors.end()) {
+            throw runtime_error(string("invalid connection manager option '") + opts[i].key + "'");
+        }
+        (it->second)(opts[i].value);
+    }
+
+    return new WarbleConnMgr(connects_per_adapter, retries);
+}
+
+void warble_connmgr_delete(WarbleConnMgr* obj) {
+    delete obj;
+}
+
+void warble_connmgr_connect_async(WarbleConnMgr* obj, WarbleGatt* const* gatts, int32_t ngatts, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    obj->connect_async(gatts, ngatts, context, handler);
+}
+
+int32_t warble_connmgr_get_pending(const WarbleConnMgr* obj) {
+    return obj->get_pending();
+}
@@ -3,9 +3,28 @@
  */
 #pragma once
 
-const char* WARBLE_CONNECT_TIMEOUT = "Timed out while trying to connect to remote device";
-const char* WARBLE_GATT_ERROR = "Gatt error";
-const char* WARBLE_GATT_WRITE_ERROR = "Failed to write value to characteristic";
-const char* WARBLE_GATT_READ_ERROR = "Failed to read value from characteristic";
-const char* WARBLE_GATT_ENABLE_NOTIFY_ERROR = "Failed to enable notifications";
-const char* WARBLE_GATT_DISABLE_NOTIFY_ERROR = "Failed to disable notifications";
\ No newline at end of file
+const char* const WARBLE_CONNECT_TIMEOUT = "Timed out while trying to connect to remote device";
+const char* const WARBLE_CONNECT_CANCELLED = "Connect attempt was cancelled";
+const char* const WARBLE_GATT_ERROR = "Gatt error";
+const char* const WARBLE_GATT_WRITE_ERROR = "Failed to write value to characteristic";
+const char* const WARBLE_GATT_READ_ERROR = "Failed to read value from characteristic";
+const char* const WARBLE_GATT_ENABLE_NOTIFY_ERROR = "Failed to enable notifications";
+const char* const WARBLE_GATT_DISABLE_NOTIFY_ERROR = "Failed to disable notifications";
+const char* const WARBLE_GATT_NOT_CONNECTED = "Not connected to the remote device";
+const char* const WARBLE_GATT_LOCAL_DISCONNECT = "Connection closed by the local device";
+const char* const WARBLE_GATT_REMOTE_DISCONNECT = "Connection lost to the remote device";
+const char* const WARBLE_GATT_UNEXPECTED_RESPONSE = "Received unexpected response from the remote device";
+const char* const WARBLE_GATT_CHAR_DETACHED = "Characteristic is no longer present on the remote device";
+const char* const WARBLE_GATT_FOREIGN_CHAR = "Characteristic belongs to a different gatt connection";
+const char* const WARBLE_GATT_NO_CCCD = "Characteristic does not have a client characteristic configuration descriptor";
+const char* const WARBLE_GATT_INVALID_OP = "Invalid gatt operation type";
+const char* const WARBLE_GATT_VALUE_TOO_LONG = "Value is too long for the requested operation";
+const char* const WARBLE_GATT_PREPARE_WRITE_MISMATCH = "Remote device did not echo the prepared value correctly";
+const char* const WARBLE_GATT_DISCOVERY_ERROR = "Failed to discover gatt services";
+const char* const WARBLE_GATT_CONN_PARAMS_ERROR = "Failed to update connection parameters";
+const char* const WARBLE_GATT_INVALID_CONN_PARAMS = "Connection parameters are out of range";
+const char* const WARBLE_NOT_SUPPORTED = "Operation is not supported by this backend";
+const char* const WARBLE_NO_FREE_ADAPTER = "No adapter has room for another connection";
+const char* const WARBLE_L2CAP_CONNECT_ERROR = "Failed to open L2CAP channel";
+const char* const WARBLE_L2CAP_CLOSED = "L2CAP channel was closed";
+const char* const WARBLE_CONNMGR_CANCELLED = "Connect attempt cancelled before it started";
\ No newline at end of file
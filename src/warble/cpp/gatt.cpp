@@ -3,14 +3,129 @@
  */
 
 #include "warble/gatt.h"
+#include "error_messages.h"
+#include "gatt_batch.h"
 #include "gatt_def.h"
+#include "gattchar_def.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
 
 using std::int32_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::string;
+using std::stringstream;
+using std::vector;
 
 WarbleGatt::~WarbleGatt() {
 
 }
 
+int32_t WarbleGatt::get_queue_depth() const {
+    return 0;
+}
+
+uint16_t WarbleGatt::get_mtu() const {
+    return 23;
+}
+
+const char* WarbleGatt::choose_adapter(const vector<string>& full) {
+    return "";
+}
+
+void WarbleGatt::cancel_connect() {
+}
+
+void WarbleGatt::get_reconnect_stats(WarbleReconnectStats* stats) const {
+    *stats = WarbleReconnectStats();
+}
+
+void WarbleGatt::get_stats(WarbleGattStats* stats) const {
+    *stats = WarbleGattStats();
+}
+
+void WarbleGatt::on_stream_ready(void* context, FnVoid_VoidP_WarbleGattP handler) {
+}
+
+uint32_t WarbleGatt::get_stream_queued() const {
+    return 0;
+}
+
+int32_t WarbleGatt::get_fd(uint32_t* events) const {
+    *events = 0;
+    return -1;
+}
+
+int32_t WarbleGatt::get_timeout() const {
+    return -1;
+}
+
+void WarbleGatt::process(uint32_t events) {
+}
+
+void WarbleGatt::update_conn_params(const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    stringstream error_stream;
+    string full_msg;
+
+    error_stream << WARBLE_GATT_CONN_PARAMS_ERROR << "(" << WARBLE_NOT_SUPPORTED << ")";
+    full_msg = error_stream.str();
+    handler(context, this, full_msg.c_str());
+}
+
+WarbleL2capChannel* WarbleGatt::create_l2cap_channel(uint16_t psm, int32_t nopts, const WarbleOption* opts) {
+    return nullptr;
+}
+
+void WarbleGatt::read_multiple(WarbleGattChar* const* chars, int32_t nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    vector<WarbleGattOp> ops(nchars);
+    for(int32_t i = 0; i < nchars; i++) {
+        ops[i] = { chars[i], WARBLE_GATT_OP_READ, nullptr, 0 };
+    }
+    submit_batch(ops.data(), nchars, context, handler);
+}
+
+void WarbleGatt::submit_batch(const WarbleGattOp* ops, int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    auto batch = new WarbleGattBatch(this, ops, nops, context, handler);
+
+    // the batch frees itself once the last op completes so it must not be touched after issuing the last op
+    for(int32_t i = 0; i < nops; i++) {
+        auto slot = batch->slot(i);
+        auto gattchar = ops[i].gattchar;
+
+        switch(ops[i].type) {
+        case WARBLE_GATT_OP_READ:
+            gattchar->read_long_async(slot, WarbleGattBatch::on_read_completed);
+            break;
+        case WARBLE_GATT_OP_WRITE:
+            gattchar->write_long_async(ops[i].value, ops[i].len, slot, WarbleGattBatch::on_write_completed);
+            break;
+        case WARBLE_GATT_OP_WRITE_WITHOUT_RESP:
+            if (ops[i].len > UINT8_MAX) {
+                stringstream error_stream;
+                string full_msg;
+
+                error_stream << WARBLE_GATT_WRITE_ERROR << "(" << WARBLE_GATT_VALUE_TOO_LONG << ")";
+                full_msg = error_stream.str();
+                WarbleGattBatch::on_write_completed(slot, gattchar, full_msg.c_str());
+            } else {
+                gattchar->write_without_resp_async(ops[i].value, static_cast<uint8_t>(ops[i].len), slot, WarbleGattBatch::on_write_completed);
+            }
+            break;
+        case WARBLE_GATT_OP_ENABLE_NOTIFICATIONS:
+            gattchar->enable_notifications_async(slot, WarbleGattBatch::on_write_completed);
+            break;
+        case WARBLE_GATT_OP_DISABLE_NOTIFICATIONS:
+            gattchar->disable_notifications_async(slot, WarbleGattBatch::on_write_completed);
+            break;
+        default:
+            WarbleGattBatch::on_write_completed(slot, gattchar, WARBLE_GATT_INVALID_OP);
+            break;
+        }
+    }
+}
+
 WarbleGatt* warble_gatt_create(const char* mac) {
     WarbleOption opts[] = {
         {"mac", mac}
@@ -30,6 +145,10 @@ void warble_gatt_connect_async(WarbleGatt* obj, void* context, FnVoid_VoidP_Warb
     obj->connect_async(context, handler);
 }
 
+void warble_gatt_cancel_connect(WarbleGatt* obj) {
+    obj->cancel_connect();
+}
+
 void warble_gatt_disconnect(WarbleGatt* obj) {
     obj->disconnect();
 }
@@ -48,4 +167,60 @@ WarbleGattChar* warble_gatt_find_characteristic(const WarbleGatt* obj, const cha
 
 int32_t warble_gatt_has_service(const WarbleGatt* obj, const char* uuid) {
     return obj->service_exists(uuid);
+}
+
+int32_t warble_gatt_get_queue_depth(const WarbleGatt* obj) {
+    return obj->get_queue_depth();
+}
+
+uint16_t warble_gatt_get_mtu(const WarbleGatt* obj) {
+    return obj->get_mtu();
+}
+
+void warble_gatt_update_conn_params(WarbleGatt* obj, const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler) {
+    obj->update_conn_params(params, context, handler);
+}
+
+void warble_gatt_get_reconnect_stats(const WarbleGatt* obj, WarbleReconnectStats* stats) {
+    obj->get_reconnect_stats(stats);
+}
+
+void warble_gatt_read_multiple(WarbleGatt* obj, WarbleGattChar* const* chars, int32_t nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    if (nchars <= 0) {
+        handler(context, obj, nullptr, 0, 0);
+    } else {
+        obj->read_multiple(chars, nchars, context, handler);
+    }
+}
+
+void warble_gatt_get_stats(const WarbleGatt* obj, WarbleGattStats* stats) {
+    obj->get_stats(stats);
+}
+
+void warble_gatt_on_stream_ready(WarbleGatt* obj, void* context, FnVoid_VoidP_WarbleGattP handler) {
+    obj->on_stream_ready(context, handler);
+}
+
+uint32_t warble_gatt_get_stream_queued(const WarbleGatt* obj) {
+    return obj->get_stream_queued();
+}
+
+int32_t warble_gatt_get_fd(const WarbleGatt* obj, uint32_t* events) {
+    return obj->get_fd(events);
+}
+
+int32_t warble_gatt_get_timeout(const WarbleGatt* obj) {
+    return obj->get_timeout();
+}
+
+void warble_gatt_process(WarbleGatt* obj, uint32_t events) {
+    obj->process(events);
+}
+
+void warble_gatt_submit_batch(WarbleGatt* obj, const WarbleGattOp* ops, int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) {
+    if (nops <= 0) {
+        handler(context, obj, nullptr, 0, 0);
+    } else {
+        obj->submit_batch(ops, nops, context, handler);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "gatt_batch.h"
+
+using namespace std;
+using namespace std::chrono;
+
+WarbleGattBatch::WarbleGattBatch(WarbleGatt* owner, const WarbleGattOp* ops, int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler) : 
+        owner(owner), context(context), handler(handler), slots(nops), results(nops), values(nops), errors(nops), remaining(nops), start(steady_clock::now()) {
+    for(int32_t i = 0; i < nops; i++) {
+        slots[i] = { this, static_cast<size_t>(i) };
+        results[i] = { ops[i].gattchar, nullptr, 0, nullptr };
+    }
+}
+
+void* WarbleGattBatch::slot(size_t i) {
+    return &slots[i];
+}
+
+void WarbleGattBatch::on_write_completed(void* context, WarbleGattChar* caller, const char* error) {
+    auto slot = static_cast<Slot*>(context);
+    slot->batch->completed(slot->index, nullptr, 0, error);
+}
+
+void WarbleGattBatch::on_read_completed(void* context, WarbleGattChar* caller, const uint8_t* value, uint16_t len, const char* error) {
+    auto slot = static_cast<Slot*>(context);
+    slot->batch->completed(slot->index, value, len, error);
+}
+
+void WarbleGattBatch::completed(size_t index, const uint8_t* value, size_t len, const char* error) {
+    auto& result = results[index];
+    if (error != nullptr) {
+        errors[index] = error;
+        result.error = errors[index].c_str();
+    } else if (value != nullptr) {
+        values[index].assign(value, value + len);
+        result.value = values[index].data();
+        result.len = static_cast<uint16_t>(len);
+    }
+
+    if (--remaining == 0) {
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+        handler(context, owner, results.data(), static_cast<int32_t>(results.size()), static_cast<uint32_t>(elapsed));
+        delete this;
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#include "warble/gatt_fwd.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Collects the results of a warble_gatt_submit_batch call.  Backends issue each op with slot(i) as the 
+ * callback context and one of the static completion functions as the handler.  The object deletes itself 
+ * after the last op completes and the user's handler has returned.
+ */
+class WarbleGattBatch {
+public:
+    WarbleGattBatch(WarbleGatt* owner, const WarbleGattOp* ops, std::int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
+
+    void* slot(std::size_t i);
+
+    static void on_write_completed(void* context, WarbleGattChar* caller, const char* error);
+    static void on_read_completed(void* context, WarbleGattChar* caller, const std::uint8_t* value, std::uint16_t len, const char* error);
+
+private:
+    struct Slot {
+        WarbleGattBatch* batch;
+        std::size_t index;
+    };
+
+    void completed(std::size_t index, const std::uint8_t* value, std::size_t len, const char* error);
+
+    WarbleGatt* owner;
+    void* context;
+    FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler;
+
+    std::vector<Slot> slots;
+    std::vector<WarbleGattOpResult> results;
+    std::vector<std::vector<std::uint8_t>> values;
+    std::vector<std::string> errors;
+    std::atomic<std::size_t> remaining;
+    std::chrono::steady_clock::time_point start;
+};
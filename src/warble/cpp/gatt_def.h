@@ -5,19 +5,40 @@
 
 #include "warble/gatt_fwd.h"
 #include "warble/gattchar_fwd.h"
+#include "warble/l2cap_fwd.h"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
+// gatt.cpp implements the non-pure functions for backends without the feature, reporting zeros or failing the handler
 struct WarbleGatt {
     virtual ~WarbleGatt() = 0;
 
     virtual void connect_async(void* context, FnVoid_VoidP_WarbleGattP_CharP handler) = 0;
+    virtual void cancel_connect();
     virtual void disconnect() = 0;
     virtual void on_disconnect(void* context, FnVoid_VoidP_WarbleGattP_Int handler) = 0;
     virtual bool is_connected() const = 0;
 
-    virtual WarbleGattChar* find_characteristic(const std::string& uuid) const = 0;
-    virtual bool service_exists(const std::string& uuid) const = 0;
+    virtual WarbleGattChar* find_characteristic(const char* uuid) const = 0;
+    virtual bool service_exists(const char* uuid) const = 0;
+    virtual std::int32_t get_queue_depth() const;
+    virtual std::uint16_t get_mtu() const;
+    // Adapter the next connect attempt runs on, the key the connection manager limits attempts by.  Objects balancing 
+    // links over several adapters pick one not in full and keep it for that attempt, nullptr if every candidate is full
+    virtual const char* choose_adapter(const std::vector<std::string>& full);
+    virtual void get_reconnect_stats(WarbleReconnectStats* stats) const;
+    virtual void get_stats(WarbleGattStats* stats) const;
+    virtual void on_stream_ready(void* context, FnVoid_VoidP_WarbleGattP handler);
+    virtual std::uint32_t get_stream_queued() const;
+    virtual std::int32_t get_fd(std::uint32_t* events) const;
+    virtual std::int32_t get_timeout() const;
+    virtual void process(std::uint32_t events);
+    virtual void update_conn_params(const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+    virtual WarbleL2capChannel* create_l2cap_channel(std::uint16_t psm, std::int32_t nopts, const WarbleOption* opts);
+    virtual void read_multiple(WarbleGattChar* const* chars, std::int32_t nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
+    virtual void submit_batch(const WarbleGattOp* ops, std::int32_t nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
 };
 
 WarbleGatt* warblegatt_create(std::int32_t nopts, const WarbleOption* opts);
\ No newline at end of file
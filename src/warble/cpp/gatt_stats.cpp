@@ -0,0 +1,81 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "gatt_stats.h"
+
+using namespace std;
+using namespace std::chrono;
+
+LatencyHistogram::LatencyHistogram() : count(0), max_us(0), total_us(0) {
+    for(auto& it: buckets) {
+        it.store(0, memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(microseconds elapsed) {
+    uint64_t us = elapsed.count() < 0 ? 0 : static_cast<uint64_t>(elapsed.count());
+    auto clamped = static_cast<uint32_t>(us > UINT32_MAX ? UINT32_MAX : us);
+
+    // bucket i holds [2^(i-1), 2^i) microseconds, i.e. the bit length of the sample
+    size_t bucket = 0;
+    while(bucket < WARBLE_HISTOGRAM_BUCKETS - 1 && (us >> bucket) != 0) {
+        bucket++;
+    }
+
+    buckets[bucket].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    total_us.fetch_add(us, memory_order_relaxed);
+
+    auto current = max_us.load(memory_order_relaxed);
+    while(clamped > current && !max_us.compare_exchange_weak(current, clamped, memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::snapshot(WarbleHistogram* dest) const {
+    dest->count = count.load(memory_order_relaxed);
+    dest->max_us = max_us.load(memory_order_relaxed);
+    dest->total_us = total_us.load(memory_order_relaxed);
+    for(size_t i = 0; i < WARBLE_HISTOGRAM_BUCKETS; i++) {
+        dest->buckets[i] = buckets[i].load(memory_order_relaxed);
+    }
+}
+
+GattStats::GattStats() : GattStats(&library()) {
+}
+
+GattStats::GattStats(GattStats* parent) : parent(parent) {
+    for(auto& it: counters) {
+        it.store(0, memory_order_relaxed);
+    }
+}
+
+GattStats& GattStats::library() {
+    static GattStats totals(nullptr);
+    return totals;
+}
+
+void GattStats::record(Histogram type, microseconds elapsed) {
+    histograms[type].record(elapsed);
+    if (parent != nullptr) {
+        parent->histograms[type].record(elapsed);
+    }
+}
+
+void GattStats::increment(Counter type) {
+    counters[type].fetch_add(1, memory_order_relaxed);
+    if (parent != nullptr) {
+        parent->counters[type].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void GattStats::snapshot(WarbleGattStats* dest) const {
+    histograms[CONNECT].snapshot(&dest->connect);
+    histograms[DISCOVERY].snapshot(&dest->discovery);
+    histograms[READ].snapshot(&dest->read);
+    histograms[WRITE].snapshot(&dest->write);
+    histograms[NOTIFICATION_INTERVAL].snapshot(&dest->notification_interval);
+    dest->connect_failures = counters[CONNECT_FAILURES].load(memory_order_relaxed);
+    dest->op_failures = counters[OP_FAILURES].load(memory_order_relaxed);
+    dest->notifications = counters[NOTIFICATIONS].load(memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#include "warble/gatt_fwd.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Latency distribution with power of 2 bucket bounds.  Every field is updated with relaxed atomics so the I/O 
+ * thread never blocks on a reader, a snapshot taken while samples are being recorded may be off by those samples
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(std::chrono::microseconds elapsed);
+    void snapshot(WarbleHistogram* dest) const;
+
+private:
+    std::atomic<std::uint32_t> count, max_us;
+    std::atomic<std::uint64_t> total_us;
+    std::atomic<std::uint32_t> buckets[WARBLE_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Timings and counters for one WarbleGatt object.  Every sample is also added to the library wide totals
+ */
+class GattStats {
+public:
+    enum Histogram {
+        CONNECT,
+        DISCOVERY,
+        READ,
+        WRITE,
+        NOTIFICATION_INTERVAL,
+        HISTOGRAM_COUNT
+    };
+
+    enum Counter {
+        CONNECT_FAILURES,
+        OP_FAILURES,
+        NOTIFICATIONS,
+        COUNTER_COUNT
+    };
+
+    GattStats();
+
+    /**
+     * Totals of every WarbleGatt object created by the library
+     */
+    static GattStats& library();
+
+    void record(Histogram type, std::chrono::microseconds elapsed);
+    void increment(Counter type);
+    void snapshot(WarbleGattStats* dest) const;
+
+private:
+    explicit GattStats(GattStats* parent);
+
+    GattStats* parent;
+    LatencyHistogram histograms[HISTOGRAM_COUNT];
+    std::atomic<std::uint32_t> counters[COUNTER_COUNT];
+};
@@ -5,12 +5,42 @@
 #include "warble/gattchar.h"
 #include "gattchar_def.h"
 
+using std::int32_t;
 using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
 
 WarbleGattChar::~WarbleGattChar() {
 
 }
 
+int32_t WarbleGattChar::stream_write(const uint8_t* value, uint16_t len) {
+    if (len > UINT8_MAX) {
+        return -1;
+    }
+
+    write_without_resp_async(value, static_cast<uint8_t>(len), nullptr, [](void* context, WarbleGattChar* caller, const char* value) { });
+    return 1;
+}
+
+int32_t WarbleGattChar::drain_notifications(WarbleGattNotification* buf, int32_t max) {
+    return 0;
+}
+
+uint32_t WarbleGattChar::get_dropped_notifications() const {
+    return 0;
+}
+
+void WarbleGattChar::on_notification_received_ex(void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler) {
+}
+
+void WarbleGattChar::set_sequence_tracking(const WarbleGattSequenceConfig* config) {
+}
+
+void WarbleGattChar::get_sequence_stats(WarbleGattSequenceStats* stats) const {
+    *stats = WarbleGattSequenceStats();
+}
+
 void warble_gattchar_write_async(WarbleGattChar* obj, const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
     obj->write_async(value, len, context, handler);
 }
@@ -19,10 +49,22 @@ void warble_gattchar_write_without_resp_async(WarbleGattChar* obj, const uint8_t
     obj->write_without_resp_async(value, len, context, handler);
 }
 
+void warble_gattchar_write_long_async(WarbleGattChar* obj, const uint8_t* value, uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    obj->write_long_async(value, len, context, handler);
+}
+
+int32_t warble_gattchar_stream_write(WarbleGattChar* obj, const uint8_t* value, uint16_t len) {
+    return obj->stream_write(value, len);
+}
+
 void warble_gattchar_read_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) {
     obj->read_async(context, handler);
 }
 
+void warble_gattchar_read_long_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler) {
+    obj->read_long_async(context, handler);
+}
+
 void warble_gattchar_enable_notifications_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
     obj->enable_notifications_async(context, handler);
 }
@@ -35,6 +77,30 @@ void warble_gattchar_on_notification_received(WarbleGattChar* obj, void* context
     obj->on_notification_received(context, handler);
 }
 
+void warble_gattchar_on_notification_received_long(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler) {
+    obj->on_notification_received_long(context, handler);
+}
+
+int32_t warble_gattchar_drain_notifications(WarbleGattChar* obj, WarbleGattNotification* buf, int32_t max) {
+    return max <= 0 ? 0 : obj->drain_notifications(buf, max);
+}
+
+uint32_t warble_gattchar_get_dropped_notifications(const WarbleGattChar* obj) {
+    return obj->get_dropped_notifications();
+}
+
+void warble_gattchar_on_notification_received_ex(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler) {
+    obj->on_notification_received_ex(context, handler);
+}
+
+void warble_gattchar_set_sequence_tracking(WarbleGattChar* obj, const WarbleGattSequenceConfig* config) {
+    obj->set_sequence_tracking(config);
+}
+
+void warble_gattchar_get_sequence_stats(const WarbleGattChar* obj, WarbleGattSequenceStats* stats) {
+    obj->get_sequence_stats(stats);
+}
+
 const char* warble_gattchar_get_uuid(const WarbleGattChar* obj) {
     return obj->get_uuid();
 }
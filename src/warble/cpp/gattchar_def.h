@@ -5,17 +5,27 @@
 
 #include "warble/gattchar_fwd.h"
 
+// Defaults for the non-pure functions are in gattchar.cpp, stream_write falls back to write_without_resp_async
 struct WarbleGattChar {
     virtual ~WarbleGattChar() = 0;
 
     virtual void write_async(const std::uint8_t* value, std::uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) = 0;
     virtual void write_without_resp_async(const std::uint8_t* value, std::uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) = 0;
+    virtual void write_long_async(const std::uint8_t* value, std::uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) = 0;
+    virtual std::int32_t stream_write(const std::uint8_t* value, std::uint16_t len);
 
     virtual void read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) = 0;
+    virtual void read_long_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler) = 0;
 
     virtual void enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) = 0;
     virtual void disable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) = 0;
     virtual void on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler) = 0;
+    virtual void on_notification_received_long(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler) = 0;
+    virtual std::int32_t drain_notifications(WarbleGattNotification* buf, std::int32_t max);
+    virtual std::uint32_t get_dropped_notifications() const;
+    virtual void on_notification_received_ex(void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler);
+    virtual void set_sequence_tracking(const WarbleGattSequenceConfig* config);
+    virtual void get_sequence_stats(WarbleGattSequenceStats* stats) const;
 
     virtual const char* get_uuid() const = 0;
     virtual WarbleGatt* get_gatt() const = 0;
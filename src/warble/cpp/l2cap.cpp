@@ -0,0 +1,84 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "warble/l2cap.h"
+#include "gatt_def.h"
+#include "l2cap_def.h"
+
+using std::int32_t;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+
+WarbleL2capChannel::~WarbleL2capChannel() {
+
+}
+
+WarbleL2capChannel* warble_l2cap_create(WarbleGatt* gatt, uint16_t psm, int32_t nopts, const WarbleOption* opts) {
+    return gatt->create_l2cap_channel(psm, nopts, opts);
+}
+
+void warble_l2cap_delete(WarbleL2capChannel* obj) {
+    delete obj;
+}
+
+void warble_l2cap_connect_async(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_CharP handler) {
+    obj->connect_async(context, handler);
+}
+
+void warble_l2cap_close(WarbleL2capChannel* obj) {
+    obj->close();
+}
+
+void warble_l2cap_on_close(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_Int handler) {
+    obj->on_close(context, handler);
+}
+
+int32_t warble_l2cap_is_open(const WarbleL2capChannel* obj) {
+    return obj->is_open();
+}
+
+uint16_t warble_l2cap_get_send_mtu(const WarbleL2capChannel* obj) {
+    return obj->get_send_mtu();
+}
+
+uint16_t warble_l2cap_get_receive_mtu(const WarbleL2capChannel* obj) {
+    return obj->get_receive_mtu();
+}
+
+int32_t warble_l2cap_send(WarbleL2capChannel* obj, const uint8_t* value, uint16_t len) {
+    return obj->send(value, len);
+}
+
+void warble_l2cap_on_send_ready(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP handler) {
+    obj->on_send_ready(context, handler);
+}
+
+void warble_l2cap_on_sdu_received(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort handler) {
+    obj->on_sdu_received(context, handler);
+}
+
+void warble_l2cap_on_readable(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP handler) {
+    obj->on_readable(context, handler);
+}
+
+int32_t warble_l2cap_read(WarbleL2capChannel* obj, uint8_t* buffer, uint32_t capacity) {
+    return obj->read(buffer, capacity);
+}
+
+int32_t warble_l2cap_get_fd(const WarbleL2capChannel* obj, uint32_t* events) {
+    return obj->get_fd(events);
+}
+
+int32_t warble_l2cap_get_timeout(const WarbleL2capChannel* obj) {
+    return obj->get_timeout();
+}
+
+void warble_l2cap_process(WarbleL2capChannel* obj, uint32_t events) {
+    obj->process(events);
+}
+
+WarbleGatt* warble_l2cap_get_gatt(const WarbleL2capChannel* obj) {
+    return obj->get_gatt();
+}
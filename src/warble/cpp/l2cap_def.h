@@ -0,0 +1,32 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#include "warble/gatt_fwd.h"
+#include "warble/l2cap_fwd.h"
+
+#include <cstdint>
+
+struct WarbleL2capChannel {
+    virtual ~WarbleL2capChannel() = 0;
+
+    virtual void connect_async(void* context, FnVoid_VoidP_WarbleL2capChannelP_CharP handler) = 0;
+    virtual void close() = 0;
+    virtual void on_close(void* context, FnVoid_VoidP_WarbleL2capChannelP_Int handler) = 0;
+    virtual bool is_open() const = 0;
+    virtual std::uint16_t get_send_mtu() const = 0;
+    virtual std::uint16_t get_receive_mtu() const = 0;
+
+    virtual std::int32_t send(const std::uint8_t* value, std::uint16_t len) = 0;
+    virtual void on_send_ready(void* context, FnVoid_VoidP_WarbleL2capChannelP handler) = 0;
+    virtual void on_sdu_received(void* context, FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort handler) = 0;
+    virtual void on_readable(void* context, FnVoid_VoidP_WarbleL2capChannelP handler) = 0;
+    virtual std::int32_t read(std::uint8_t* buffer, std::uint32_t capacity) = 0;
+
+    virtual std::int32_t get_fd(std::uint32_t* events) const = 0;
+    virtual std::int32_t get_timeout() const = 0;
+    virtual void process(std::uint32_t events) = 0;
+
+    virtual WarbleGatt* get_gatt() const = 0;
+};
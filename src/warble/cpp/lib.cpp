@@ -3,11 +3,21 @@
  */
 
 #include "warble/lib.h"
+#include "gatt_stats.h"
 #include "lib_def.h"
 
 #ifdef API_BLEPP
+#include "blepp_cache.h"
+#include "blepp_capture.h"
+#include "blepp_hci.h"
+#include "blepp_reactor.h"
+#include "blepp_replay.h"
+#include "blepp_sim.h"
+#include "blepp_transport.h"
 #include "blepp/blestatemachine.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <stdexcept>
 #include <string>
@@ -33,6 +43,15 @@ const char* warble_lib_config() {
 
 void warble_lib_init(int32_t nopts, const WarbleOption* opts) {
 #ifdef API_BLEPP
+    bool configure_io = false;
+    auto io_mode = blepp_io_mode();
+    size_t io_threads = 0;
+    bool configure_replay = false;
+    string replay_file;
+    auto replay_pacing = replay::Pacing::REALTIME;
+    bool configure_sim = false;
+    string sim_file;
+
     unordered_map<string, function<void(const char*)>> arg_processors = {
         {"log-level", [](const char* value) {
             if (!strcmp(value, "error")) {
@@ -46,6 +65,58 @@ void warble_lib_init(int32_t nopts, const WarbleOption* opts) {
             } else if (!strcmp(value, "trace")) {
                 log_level = Trace;
             }
+        }},
+        {"io-mode", [&configure_io, &io_mode](const char* value) {
+            if (!strcmp(value, "reactor")) {
+                io_mode = BleppIoMode::REACTOR;
+            } else if (!strcmp(value, "thread")) {
+                io_mode = BleppIoMode::THREAD;
+            } else if (!strcmp(value, "manual")) {
+                io_mode = BleppIoMode::MANUAL;
+            } else {
+                throw runtime_error("invalid value for \'io-mode\' option (blepp api): one of [thread, reactor, manual]");
+            }
+            configure_io = true;
+        }},
+        {"io-threads", [&configure_io, &io_threads](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed <= 0) {
+                throw runtime_error("invalid value for \'io-threads\' option (blepp api): must be a positive integer");
+            }
+            io_threads = static_cast<size_t>(parsed);
+            configure_io = true;
+        }},
+        {"cache-dir", [](const char* value) {
+            gatt_cache::configure(value);
+        }},
+        {"capture-file", [](const char* value) {
+            btsnoop::configure(value);
+        }},
+        {"replay-file", [&configure_replay, &replay_file](const char* value) {
+            replay_file = value;
+            configure_replay = true;
+        }},
+        {"replay-pacing", [&replay_pacing](const char* value) {
+            if (!strcmp(value, "realtime")) {
+                replay_pacing = replay::Pacing::REALTIME;
+            } else if (!strcmp(value, "fast")) {
+                replay_pacing = replay::Pacing::FAST;
+            } else {
+                throw runtime_error("invalid value for \'replay-pacing\' option (blepp api): one of [realtime, fast]");
+            }
+        }},
+        {"sim-file", [&configure_sim, &sim_file](const char* value) {
+            sim_file = value;
+            configure_sim = true;
+        }},
+        {"hci-max-links", [](const char* value) {
+            char* end;
+            long parsed = strtol(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || parsed < 0) {
+                throw runtime_error("invalid value for \'hci-max-links\' option (blepp api): must be a non-negative integer");
+            }
+            hci_pool::configure(static_cast<size_t>(parsed));
         }}
     };
 
@@ -56,5 +127,35 @@ void warble_lib_init(int32_t nopts, const WarbleOption* opts) {
         }
         (it->second)(opts[i].value);
     }
+
+    if (configure_io) {
+        blepp_io_configure(io_mode, io_threads);
+    }
+    // objects created from here on are served by the capture, an empty path goes back to the local adapters
+    if (configure_replay) {
+        blepp_transport::set_peer(replay_file.empty() ? nullptr : replay::open(replay_file, replay_pacing));
+    }
+    // same for the simulated devices, set after the replay so it wins if both are given
+    if (configure_sim) {
+        blepp_transport::set_peer(sim_file.empty() ? nullptr : sim::open(sim_file));
+    }
+#endif
+}
+
+int32_t warble_lib_get_adapter_links(WarbleAdapterLinks* links, int32_t max) {
+#ifdef API_BLEPP
+    auto counts = hci_pool::links();
+    for(int32_t i = 0; i < max && static_cast<size_t>(i) < counts.size(); i++) {
+        strncpy(links[i].mac, counts[i].first.c_str(), sizeof(links[i].mac) - 1);
+        links[i].mac[sizeof(links[i].mac) - 1] = '\0';
+        links[i].links = static_cast<int32_t>(counts[i].second);
+    }
+    return static_cast<int32_t>(counts.size());
+#else
+    return 0;
 #endif
+}
+
+void warble_lib_get_stats(WarbleGattStats* stats) {
+    GattStats::library().snapshot(stats);
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "notification_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+NotificationRing::NotificationRing(size_t capacity, Overflow overflow) : overflow(overflow), head(0), tail(0), dropped(0) {
+    size_t rounded = 1;
+    while(rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    slots.resize(rounded);
+    mask = rounded - 1;
+}
+
+void NotificationRing::push(const uint8_t* value, size_t len, uint64_t timestamp) {
+    auto h = head.load(memory_order_relaxed);
+    auto t = tail.load(memory_order_acquire);
+
+    if (h - t >= slots.size()) {
+        if (overflow == DROP_NEWEST) {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        // take the oldest entry away from the consumer, if the CAS fails the consumer just freed a slot
+        if (tail.compare_exchange_strong(t, t + 1, memory_order_acq_rel)) {
+            dropped.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    auto& slot = slots[h & mask];
+    slot.timestamp = timestamp;
+    slot.len = static_cast<uint16_t>(min<size_t>(len, WARBLE_NOTIFICATION_MAX_LEN));
+    memcpy(slot.value, value, slot.len);
+
+    head.store(h + 1, memory_order_release);
+}
+
+size_t NotificationRing::drain(WarbleGattNotification* buf, size_t max) {
+    size_t n = 0;
+
+    while(n < max) {
+        auto t = tail.load(memory_order_acquire);
+        if (t == head.load(memory_order_acquire)) {
+            break;
+        }
+
+        const auto& slot = slots[t & mask];
+        buf[n].timestamp = slot.timestamp;
+        buf[n].len = min<uint16_t>(slot.len, WARBLE_NOTIFICATION_MAX_LEN);
+        memcpy(buf[n].value, slot.value, buf[n].len);
+
+        // with DROP_OLDEST the producer may have evicted, and be overwriting, the entry that was just copied
+        if (tail.compare_exchange_strong(t, t + 1, memory_order_acq_rel)) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+uint32_t NotificationRing::get_dropped() const {
+    return dropped.load(memory_order_relaxed);
+}
@@ -0,0 +1,46 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#include "warble/gattchar_fwd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Fixed capacity single producer, single consumer queue of notifications.  The I/O thread pushes, the
+ * application drains from one thread of its choosing
+ */
+class NotificationRing {
+public:
+    enum Overflow {
+        // discard the notification that did not fit
+        DROP_NEWEST,
+        // evict the oldest queued notification to make room
+        DROP_OLDEST
+    };
+
+    /**
+     * Capacity is rounded up to the next power of 2
+     */
+    NotificationRing(std::size_t capacity, Overflow overflow);
+
+    void push(const std::uint8_t* value, std::size_t len, std::uint64_t timestamp);
+    std::size_t drain(WarbleGattNotification* buf, std::size_t max);
+    std::uint32_t get_dropped() const;
+
+private:
+    std::vector<WarbleGattNotification> slots;
+    std::size_t mask;
+    Overflow overflow;
+
+    // producer and consumer indices live on separate cache lines so the two threads do not contend
+    std::atomic<std::uint64_t> head;
+    char head_pad[64 - sizeof(std::atomic<std::uint64_t>)];
+    std::atomic<std::uint64_t> tail;
+    char tail_pad[64 - sizeof(std::atomic<std::uint64_t>)];
+    std::atomic<std::uint32_t> dropped;
+};
@@ -19,6 +19,13 @@ WarbleScanner::~WarbleScanner() {
 
 }
 
+int32_t WarbleScanner::get_fd() const {
+    return -1;
+}
+
+void WarbleScanner::process() {
+}
+
 void warble_scanner_set_handler(void* context, FnVoid_VoidP_WarbleScanResultP handler) {
     get_scanner()->set_handler(context, handler);
 }
@@ -31,6 +38,14 @@ void warble_scanner_stop() {
     get_scanner()->stop();
 }
 
+int32_t warble_scanner_get_fd() {
+    return get_scanner()->get_fd();
+}
+
+void warble_scanner_process() {
+    get_scanner()->process();
+}
+
 const WarbleScanMftData* warble_scan_result_get_manufacturer_data(const WarbleScanResult* result, WARBLE_USHORT company_id) {
     auto manufacturers = &((WarbleScanPrivateData*) result->private_data)->manufacturer_data;
     auto it = manufacturers->find(company_id);
@@ -11,6 +11,7 @@
 #include <unordered_set>
 #include <unordered_map>
 
+// get_fd and process only do something in the blepp backend's manual io-mode
 class WarbleScanner {
 public:
     virtual ~WarbleScanner() = 0;
@@ -18,6 +19,8 @@ public:
     virtual void set_handler(void* context, FnVoid_VoidP_WarbleScanResultP handler) = 0;
     virtual void start(std::int32_t nopts, const WarbleOption* opts) = 0;
     virtual void stop() = 0;
+    virtual std::int32_t get_fd() const;
+    virtual void process();
 };
 
 struct WarbleScanPrivateData {
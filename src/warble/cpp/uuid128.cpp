@@ -0,0 +1,92 @@
+/**
+ * @copyright MbientLab License
+ */
+
+#include "uuid128.h"
+
+using namespace std;
+
+static const uint64_t BASE_UUID_HI = 0x0000000000001000ULL, BASE_UUID_LO = 0x800000805f9b34fbULL;
+
+// nibble value of each ASCII hex digit, 0xff for every other byte
+static const struct HexTable {
+    uint8_t values[256];
+
+    HexTable() {
+        for(int i = 0; i < 256; i++) {
+            values[i] = 0xff;
+        }
+        for(int i = 0; i < 10; i++) {
+            values['0' + i] = static_cast<uint8_t>(i);
+        }
+        for(int i = 0; i < 6; i++) {
+            values['a' + i] = values['A' + i] = static_cast<uint8_t>(10 + i);
+        }
+    }
+} HEX;
+
+// Accumulates `count` hex digits onto `value`, returns false on a non hex byte.  Stops at the first bad byte so
+// it never reads past a string's terminator
+static inline bool parse_hex(const char* str, size_t count, uint64_t& value) {
+    for(size_t i = 0; i < count; i++) {
+        uint8_t nibble = HEX.values[static_cast<uint8_t>(str[i])];
+        if (nibble == 0xff) {
+            return false;
+        }
+        value = (value << 4) | nibble;
+    }
+    return true;
+}
+
+bool Uuid128::parse(const char* str, Uuid128& uuid) {
+    // 8-4-4-4-12 groups, the first three fill the high half and the last two the low half
+    uint64_t hi = 0, lo = 0;
+    if (!parse_hex(str, 8, hi) || str[8] != '-' ||
+            !parse_hex(str + 9, 4, hi) || str[13] != '-' ||
+            !parse_hex(str + 14, 4, hi) || str[18] != '-' ||
+            !parse_hex(str + 19, 4, lo) || str[23] != '-' ||
+            !parse_hex(str + 24, 12, lo) || str[36] != '\0') {
+        return false;
+    }
+
+    uuid.hi = hi;
+    uuid.lo = lo;
+    return true;
+}
+
+Uuid128 Uuid128::from_att(const uint8_t* src, size_t len) {
+    Uuid128 uuid;
+    if (len == 2) {
+        uuid.hi = BASE_UUID_HI | (static_cast<uint64_t>(src[0] | (src[1] << 8)) << 32);
+        uuid.lo = BASE_UUID_LO;
+    } else {
+        uuid.hi = uuid.lo = 0;
+        for(size_t i = 0; i < 8; i++) {
+            uuid.hi = (uuid.hi << 8) | src[15 - i];
+            uuid.lo = (uuid.lo << 8) | src[7 - i];
+        }
+    }
+    return uuid;
+}
+
+void Uuid128::to_att(uint8_t* dest) const {
+    for(size_t i = 0; i < 8; i++) {
+        dest[i] = static_cast<uint8_t>(lo >> (8 * i));
+        dest[i + 8] = static_cast<uint8_t>(hi >> (8 * i));
+    }
+}
+
+void Uuid128::to_string(char* dest) const {
+    static const char DIGITS[] = "0123456789abcdef";
+
+    size_t pos = 0;
+    for(size_t i = 0; i < 32; i++) {
+        if (i == 8 || i == 12 || i == 16 || i == 20) {
+            dest[pos++] = '-';
+        }
+
+        uint64_t half = i < 16 ? hi : lo;
+        dest[pos++] = DIGITS[(half >> (60 - 4 * (i % 16))) & 0xf];
+    }
+    dest[pos] = '\0';
+}
@@ -0,0 +1,45 @@
+/**
+ * @copyright MbientLab License
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 128-bit uuid stored as two integers in the order its digits are written, so ordering and equality are
+ * plain integer comparisons
+ */
+struct Uuid128 {
+    std::uint64_t hi, lo;
+
+    /**
+     * Parses the 36 character form, in either case, without allocating.  Returns false if the string is malformed
+     */
+    static bool parse(const char* str, Uuid128& uuid);
+    /**
+     * Converts a little endian 16 or 128-bit uuid as sent over ATT, 16-bit values are expanded with the Bluetooth base uuid
+     */
+    static Uuid128 from_att(const std::uint8_t* src, std::size_t len);
+
+    /**
+     * Writes the 16 little endian bytes ATT uses for 128-bit uuids
+     */
+    void to_att(std::uint8_t* dest) const;
+    /**
+     * Writes the lowercase 36 character form and a null terminator into dest
+     */
+    void to_string(char* dest) const;
+};
+
+inline bool operator==(const Uuid128& a, const Uuid128& b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline bool operator!=(const Uuid128& a, const Uuid128& b) {
+    return !(a == b);
+}
+
+inline bool operator<(const Uuid128& a, const Uuid128& b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
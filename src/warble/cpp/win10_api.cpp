@@ -6,6 +6,7 @@
 #include "error_messages.h"
 #include "gatt_def.h"
 #include "gattchar_def.h"
+#include "uuid128.h"
 
 #include <collection.h>
 #include <cstring>
@@ -54,19 +55,23 @@ struct WarbleGattChar_Win10 : public WarbleGattChar {
 
     virtual void write_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void write_without_resp_async(const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+    virtual void write_long_async(const uint8_t* value, uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
 
     virtual void read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler);
+    virtual void read_long_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler);
 
     virtual void enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void disable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
     virtual void on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler);
+    virtual void on_notification_received_long(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler);
 
     virtual const char* get_uuid() const;
     virtual WarbleGatt* get_gatt() const;
 private:
-    inline void write_inner_async(GattWriteOption option, const uint8_t* value, uint8_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    // WinRT transparently switches to read blob and prepared write requests for long values
+    inline void write_inner_async(GattWriteOption option, const uint8_t* value, uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
         Array<byte>^ wrapper = ref new Array<byte>(len);
-        for (uint8_t i = 0; i < len; i++) {
+        for (uint16_t i = 0; i < len; i++) {
             wrapper[i] = value[i];
         }
 
@@ -77,6 +82,32 @@ private:
             }).CHECK_TASK_ERROR(partial);
     }
 
+    template<typename Length, typename Handler>
+    inline void read_inner_async(void* context, Handler handler) {
+        auto partial = bind(handler, context, this, placeholders::_1, placeholders::_2, placeholders::_3);
+        auto partial_error = bind(partial, nullptr, 0, placeholders::_1);
+
+        create_task(characteristic->ReadValueAsync()).then([partial, partial_error](GattReadResult^ result) {
+            if (result->Status == GattCommunicationStatus::Success) {
+                Array<byte>^ wrapper = ref new Array<byte>(result->Value->Length);
+                CryptographicBuffer::CopyToByteArray(result->Value, &wrapper);
+                partial((uint8_t*)wrapper->Data, static_cast<Length>(wrapper->Length), nullptr);
+            } else {
+                partial_error(WARBLE_GATT_READ_ERROR);
+            }
+        }).CHECK_TASK_ERROR(partial_error);
+    }
+
+    template<typename Length, typename Handler>
+    inline void on_notification_inner(void* context, Handler handler) {
+        characteristic->ValueChanged -= cookie;
+        cookie = characteristic->ValueChanged += ref new TypedEventHandler<GattCharacteristic^, GattValueChangedEventArgs^>([context, handler, this](GattCharacteristic^ sender, GattValueChangedEventArgs^ obj) {
+            Array<byte>^ wrapper = ref new Array<byte>(obj->CharacteristicValue->Length);
+            CryptographicBuffer::CopyToByteArray(obj->CharacteristicValue, &wrapper);
+            handler(context, this, (uint8_t*)wrapper->Data, static_cast<Length>(wrapper->Length));
+        });
+    }
+
     WarbleGatt* owner;
     GattCharacteristic^ characteristic;
     Windows::Foundation::EventRegistrationToken cookie;
@@ -103,8 +134,8 @@ struct WarbleGatt_Win10 : public WarbleGatt {
     virtual void on_disconnect(void* context, FnVoid_VoidP_WarbleGattP_Int handler);
     virtual bool is_connected() const;
 
-    virtual WarbleGattChar* find_characteristic(const string& uuid) const;
-    virtual bool service_exists(const string& uuid) const;
+    virtual WarbleGattChar* find_characteristic(const char* uuid) const;
+    virtual bool service_exists(const char* uuid) const;
 
 private:
     void cleanup(bool dispose = true);
@@ -271,27 +302,33 @@ bool WarbleGatt_Win10::is_connected() const {
     return device != nullptr && device->ConnectionStatus == BluetoothConnectionStatus::Connected;
 }
 
-static inline HRESULT string_to_guid(const string& uuid, GUID& raw) {
-    wstring wide_uuid(uuid.begin(), uuid.end());
-    wstringstream stream;
-    stream << L'{' << wide_uuid << L'}';
+static inline bool string_to_guid(const char* uuid, GUID& raw) {
+    Uuid128 parsed;
+    if (!Uuid128::parse(uuid, parsed)) {
+        return false;
+    }
 
-    auto casted = ref new Platform::String(stream.str().c_str());
-    return IIDFromString(casted->Data(), &raw);
+    raw.Data1 = static_cast<unsigned long>(parsed.hi >> 32);
+    raw.Data2 = static_cast<unsigned short>(parsed.hi >> 16);
+    raw.Data3 = static_cast<unsigned short>(parsed.hi);
+    for (int i = 0; i < 8; i++) {
+        raw.Data4[i] = static_cast<unsigned char>(parsed.lo >> (56 - 8 * i));
+    }
+    return true;
 }
 
-WarbleGattChar* WarbleGatt_Win10::find_characteristic(const string& uuid) const {
+WarbleGattChar* WarbleGatt_Win10::find_characteristic(const char* uuid) const {
     GUID raw;
-    if (SUCCEEDED(string_to_guid(uuid, raw))) {
+    if (string_to_guid(uuid, raw)) {
         auto it = characteristics.find(raw);
         return it == characteristics.end() ? nullptr : it->second;
     }
     return nullptr;
 }
 
-bool WarbleGatt_Win10::service_exists(const string& uuid) const {
+bool WarbleGatt_Win10::service_exists(const char* uuid) const {
     GUID raw;
-    return SUCCEEDED(string_to_guid(uuid, raw)) ? services.count(raw) : 0;
+    return string_to_guid(uuid, raw) ? services.count(raw) : 0;
 }
 
 WarbleGattChar_Win10::WarbleGattChar_Win10(WarbleGatt* owner, GattCharacteristic^ characteristic) : owner(owner), characteristic(characteristic) {
@@ -312,19 +349,16 @@ void WarbleGattChar_Win10::write_without_resp_async(const uint8_t* value, uint8_
     write_inner_async(GattWriteOption::WriteWithoutResponse, value, len, context, handler);
 }
 
+void WarbleGattChar_Win10::write_long_async(const uint8_t* value, uint16_t len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
+    write_inner_async(GattWriteOption::WriteWithResponse, value, len, context, handler);
+}
+
 void WarbleGattChar_Win10::read_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler) {
-    auto partial = bind(handler, context, this, placeholders::_1, placeholders::_2, placeholders::_3);
-    auto partial_error = bind(partial, nullptr, 0, placeholders::_1);
+    read_inner_async<uint8_t>(context, handler);
+}
 
-    create_task(characteristic->ReadValueAsync()).then([partial, partial_error](GattReadResult^ result) {
-        if (result->Status == GattCommunicationStatus::Success) {
-            Array<byte>^ wrapper = ref new Array<byte>(result->Value->Length);
-            CryptographicBuffer::CopyToByteArray(result->Value, &wrapper);
-            partial((uint8_t*)wrapper->Data, wrapper->Length, nullptr);
-        } else {
-            partial_error(WARBLE_GATT_READ_ERROR);
-        }
-    }).CHECK_TASK_ERROR(partial_error);
+void WarbleGattChar_Win10::read_long_async(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler) {
+    read_inner_async<uint16_t>(context, handler);
 }
 
 void WarbleGattChar_Win10::enable_notifications_async(void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler) {
@@ -346,11 +380,11 @@ void WarbleGattChar_Win10::disable_notifications_async(void* context, FnVoid_Voi
 }
 
 void WarbleGattChar_Win10::on_notification_received(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler) {
-    cookie = characteristic->ValueChanged += ref new TypedEventHandler<GattCharacteristic^, GattValueChangedEventArgs^>([context, handler, this](GattCharacteristic^ sender, GattValueChangedEventArgs^ obj) {
-        Array<byte>^ wrapper = ref new Array<byte>(obj->CharacteristicValue->Length);
-        CryptographicBuffer::CopyToByteArray(obj->CharacteristicValue, &wrapper);
-        handler(context, this, (uint8_t*)wrapper->Data, wrapper->Length);
-    });
+    on_notification_inner<uint8_t>(context, handler);
+}
+
+void WarbleGattChar_Win10::on_notification_received_long(void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler) {
+    on_notification_inner<uint16_t>(context, handler);
 }
 
 const char* WarbleGattChar_Win10::get_uuid() const {
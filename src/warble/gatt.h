@@ -32,12 +32,26 @@ WARBLE_API WarbleGatt* warble_gatt_create_with_options(WARBLE_INT nopts, const W
 WARBLE_API void warble_gatt_delete(WarbleGatt* obj);
 
 /**
- * Connects to the remote device
+ * Connects to the remote device.  The blepp backend reads these options from <code>warble_gatt_create_with_options</code>:
+ * <ul>
+ *  <li>'connect-timeout': milliseconds to look for the device before the attempt fails, defaults to 10000</li>
+ *  <li>'connect-scan-interval', 'connect-scan-window': milliseconds between the starts of consecutive scans, and how 
+ *      long each scan lasts, while the adapter looks for the device.  A wider window finds the device sooner at the 
+ *      cost of airtime the adapter's other links could use.  The values are set on the adapter, affect every connect 
+ *      made through it, and need the CAP_NET_ADMIN capability; the kernel defaults are kept otherwise</li>
+ * </ul>
  * @param obj           Calling object
  * @param context       Additional data for the callback function
  * @param handler       Callback function that is executed when the connect task is completed
  */
 WARBLE_API void warble_gatt_connect_async(WarbleGatt* obj, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+/**
+ * Aborts the connect attempt in progress, its handler is called with an error right away rather than once the attempt 
+ * times out.  A pending auto-reconnect is abandoned as well.  Does nothing if there is no attempt in progress or the 
+ * backend cannot abort one
+ * @param obj           Calling object
+ */
+WARBLE_API void warble_gatt_cancel_connect(WarbleGatt* obj);
 /**
  * Disconnects from the remot device.  The callback function set in <code>warble_gatt_on_disconnect</code> will be called 
  * after all resources are freed
@@ -45,7 +59,9 @@ WARBLE_API void warble_gatt_connect_async(WarbleGatt* obj, void* context, FnVoid
  */
 WARBLE_API void warble_gatt_disconnect(WarbleGatt* obj);
 /**
- * Sets a handler to listen for disconnect events
+ * Sets a handler to listen for disconnect events.  If the object was created with the 'auto-reconnect' option, 
+ * dropped links are restored without calling the handler, and it is only called once reconnecting is abandoned 
+ * or the link is closed with <code>warble_gatt_disconnect</code>
  * @param obj           Calling object
  * @param context       Additional data for the callback function
  * @param handler       Callback function that is executed when a disconnect event is received
@@ -59,7 +75,11 @@ WARBLE_API void warble_gatt_on_disconnect(WarbleGatt* obj, void* context, FnVoid
 WARBLE_API WARBLE_INT warble_gatt_is_connected(const WarbleGatt* obj);
 
 /**
- * Checks if a GATT characteristic exists with the uuid
+ * Checks if a GATT characteristic exists with the uuid.  If the object was created with the 'discover-services' option 
+ * set to 'on-demand', services are walked the first time a characteristic is looked for, blocking the calling thread 
+ * until the remote device responds.  Lookups made from a callback function only see services that were already walked.  
+ * Since every lookup runs on the application's event loop in the 'manual' io-mode, 'on-demand' cannot be used with it 
+ * and creating the object fails.
  * @param obj           Calling object
  * @param uuid          128-bit string representation of the uuid
  * @return WarbleGattChar pointer if characteristic exists, null otherwise
@@ -72,6 +92,114 @@ WARBLE_API WarbleGattChar* warble_gatt_find_characteristic(const WarbleGatt* obj
  * @return 0 if there service does not exists, non-zero otherwise
  */
 WARBLE_API WARBLE_INT warble_gatt_has_service(const WarbleGatt* obj, const char* uuid);
+/**
+ * Gets the number of characteristic reads, writes, and notification config changes that have been issued 
+ * but not yet completed.  Operations are sent to the remote device in the order they were issued, so 
+ * callers do not need to wait for one to finish before issuing the next
+ * @param obj           Calling object
+ * @return Number of pending operations, including the one currently waiting on a response
+ */
+WARBLE_API WARBLE_INT warble_gatt_get_queue_depth(const WarbleGatt* obj);
+/**
+ * Gets the ATT MTU in use on the connection.  The largest value that fits in a single write or notification is 3 bytes 
+ * less than this value
+ * @param obj           Calling object
+ * @return ATT MTU negotiated with the remote device, 23 if no exchange was made
+ */
+WARBLE_API WARBLE_USHORT warble_gatt_get_mtu(const WarbleGatt* obj);
+/**
+ * Asks the controller to change the interval, latency, and supervision timeout of the connection.  Short intervals 
+ * raise throughput and lower round trip latency, long ones save airtime for other links on the adapter.  The remote 
+ * device may still negotiate different values.  Objects created with the 'conn-interval-min', 'conn-interval-max', 
+ * 'conn-latency', or 'supervision-timeout' options request their parameters as soon as the link is up.  The blepp 
+ * backend waits on the controller from a thread of its own, which also runs the handler.  In the 'manual' io-mode the 
+ * handler runs before this function returns, as soon as the request is handed to the adapter, so a rejection by the 
+ * controller is not reported.
+ * @param obj           Calling object
+ * @param params        Parameters to request
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed once the controller has accepted or rejected the request
+ */
+WARBLE_API void warble_gatt_update_conn_params(WarbleGatt* obj, const WarbleGattConnParams* params, void* context, FnVoid_VoidP_WarbleGattP_CharP handler);
+/**
+ * Gets the auto-reconnect counters.  Links are restored with the same WarbleGattChar objects and notifications 
+ * enabled before the drop are enabled again
+ * @param obj           Calling object
+ * @param stats         Struct to write the counters to, all zero if auto-reconnect is not enabled or supported
+ */
+WARBLE_API void warble_gatt_get_reconnect_stats(const WarbleGatt* obj, WarbleReconnectStats* stats);
+/**
+ * Gets the timings and counters recorded since the object was created.  Recording is lock free so the function 
+ * can be polled from any thread while the connection is in use
+ * @param obj           Calling object
+ * @param stats         Struct to write the values to, all zero if the backend does not record them
+ */
+WARBLE_API void warble_gatt_get_stats(const WarbleGatt* obj, WarbleGattStats* stats);
+/**
+ * Sets a handler that is called once the stream queue, after <code>warble_gattchar_stream_write</code> refused a command 
+ * because it was full, has drained to half of the 'stream-window' option.  The handler runs on the I/O thread
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when the stream can take more commands
+ */
+WARBLE_API void warble_gatt_on_stream_ready(WarbleGatt* obj, void* context, FnVoid_VoidP_WarbleGattP handler);
+/**
+ * Gets the number of value bytes in the stream queue that the socket has not taken yet
+ * @param obj           Calling object
+ * @return Queued bytes, always 0 for backends that hand commands straight to the OS
+ */
+WARBLE_API WARBLE_UINT warble_gatt_get_stream_queued(const WarbleGatt* obj);
+
+/**
+ * Gets the socket an application driving warble from its own event loop watches, when the library was initialized 
+ * with the 'io-mode' option set to 'manual'.  The socket and the events change as the connection progresses and with 
+ * each warble call, read them again after calling <code>warble_gatt_process</code> or any other function on the object
+ * @param obj           Calling object
+ * @param events        Set to the WARBLE_IO flags to watch for
+ * @return Socket to watch, -1 if there is none right now or the library does not run in 'manual' mode
+ */
+WARBLE_API WARBLE_INT warble_gatt_get_fd(const WarbleGatt* obj, WARBLE_UINT* events);
+/**
+ * Gets how long the event loop can wait before calling <code>warble_gatt_process</code> even if the socket has no 
+ * events, used for connect timeouts and auto-reconnect delays in 'manual' mode
+ * @param obj           Calling object
+ * @return Milliseconds to wait, -1 to wait only on the socket
+ */
+WARBLE_API WARBLE_INT warble_gatt_get_timeout(const WarbleGatt* obj);
+/**
+ * Runs one non-blocking step of the connection in 'manual' mode: reads and handles what the socket has, writes what 
+ * is waiting on it, or handles an expired timeout.  Callback functions run on the calling thread from inside this 
+ * function.  Does nothing in the other modes
+ * @param obj           Calling object
+ * @param events        WARBLE_IO flags the event loop saw on the socket, 0 if the wait timed out
+ */
+WARBLE_API void warble_gatt_process(WarbleGatt* obj, WARBLE_UINT events);
+
+/**
+ * Reads several characteristics at once.  The blepp backend packs the reads into as few Read Multiple Variable 
+ * requests as the ATT MTU allows, and reads the values one after another if the remote device does not support 
+ * the request.  Other backends read each characteristic in turn.  The results array passed to the handler is only 
+ * valid for the duration of the callback.
+ * @param obj           Calling object
+ * @param chars         Array of characteristics to read
+ * @param nchars        Number of elements in the chars array
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed once every value has been read, results are in the same order 
+ *                      as the chars array
+ */
+WARBLE_API void warble_gatt_read_multiple(WarbleGatt* obj, WarbleGattChar* const* chars, WARBLE_INT nchars, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
+
+/**
+ * Submits a group of characteristic operations to be executed in order, with a single callback once all of them 
+ * have completed.  The ops array and the values it points to are copied before the function returns.  The results 
+ * array passed to the handler is only valid for the duration of the callback.
+ * @param obj           Calling object
+ * @param ops           Array of operations to execute
+ * @param nops          Number of elements in the ops array
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when every operation has completed
+ */
+WARBLE_API void warble_gatt_submit_batch(WarbleGatt* obj, const WarbleGattOp* ops, WARBLE_INT nops, void* context, FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint handler);
 
 #ifdef __cplusplus
 }
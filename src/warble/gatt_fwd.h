@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include "gattchar_fwd.h"
 #include "types.h"
 
 /**
@@ -29,4 +30,101 @@ typedef void(*FnVoid_VoidP_WarbleGattP_CharP)(void* context, WarbleGatt* caller,
  * @param caller            Object associated with the callback function
  * @param value             Additional data returned to the function
  */
-typedef void(*FnVoid_VoidP_WarbleGattP_Int)(void* context, WarbleGatt* caller, WARBLE_INT value);
\ No newline at end of file
+typedef void(*FnVoid_VoidP_WarbleGattP_Int)(void* context, WarbleGatt* caller, WARBLE_INT value);
+/**
+ * 2 parameter function that accepts <code>(void*, WarbleGatt*)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ */
+typedef void(*FnVoid_VoidP_WarbleGattP)(void* context, WarbleGatt* caller);
+
+/**
+ * LE connection parameters, see <code>warble_gatt_update_conn_params</code>
+ */
+typedef struct {
+    float min_interval;                         ///< Shortest connection interval in milliseconds, 7.5 to 4000 in steps of 1.25
+    float max_interval;                         ///< Longest connection interval in milliseconds, 7.5 to 4000 in steps of 1.25
+    WARBLE_USHORT latency;                      ///< Number of connection events the remote device may skip, up to 499
+    WARBLE_USHORT supervision_timeout;          ///< Milliseconds without a packet before the link is lost, 100 to 32000
+} WarbleGattConnParams;
+
+/**
+ * Auto-reconnect counters, see <code>warble_gatt_get_reconnect_stats</code>
+ */
+typedef struct {
+    WARBLE_UINT attempts;                       ///< Connect attempts made to restore dropped links
+    WARBLE_UINT reconnects;                     ///< Dropped links that were restored
+    WARBLE_UINT last_latency_ms;                ///< Time from the most recently restored link dropping until it was usable again
+    WARBLE_UINT max_latency_ms;                 ///< Longest time a link took to be restored
+} WarbleReconnectStats;
+
+/**
+ * Number of buckets in a WarbleHistogram
+ */
+#define WARBLE_HISTOGRAM_BUCKETS 32
+
+/**
+ * Distribution of a timing.  Bucket 0 counts samples under 1 microsecond, bucket i counts samples from 2^(i-1) up to 
+ * 2^i microseconds, and the last bucket also counts everything longer
+ */
+typedef struct {
+    WARBLE_UINT count;                          ///< Number of samples recorded
+    WARBLE_UINT max_us;                         ///< Longest sample in microseconds
+    WARBLE_ULONG total_us;                      ///< Sum of the samples in microseconds
+    WARBLE_UINT buckets[WARBLE_HISTOGRAM_BUCKETS];  ///< Number of samples in each bucket
+} WarbleHistogram;
+
+/**
+ * Timings and counters of one or every WarbleGatt object, see <code>warble_gatt_get_stats</code>
+ */
+typedef struct {
+    WarbleHistogram connect;                    ///< Successful connect attempts, from the connect call until the link was ready
+    WarbleHistogram discovery;                  ///< From the link coming up until the attribute table was ready, part of the connect time
+    WarbleHistogram read;                       ///< Successful reads, from the first request until the whole value was received
+    WarbleHistogram write;                      ///< Successful writes that ask for a response, from the first request until the last response
+    WarbleHistogram notification_interval;      ///< Time between consecutive notifications or indications on the same link
+    WARBLE_UINT connect_failures;               ///< Connect attempts that failed or were cancelled
+    WARBLE_UINT op_failures;                    ///< Reads and writes that failed
+    WARBLE_UINT notifications;                  ///< Notifications and indications received
+} WarbleGattStats;
+
+/**
+ * Operations that can be submitted with <code>warble_gatt_submit_batch</code>
+ */
+typedef enum {
+    WARBLE_GATT_OP_READ = 0,                    ///< Read the characteristic value
+    WARBLE_GATT_OP_WRITE,                       ///< Write the value, requesting a response
+    WARBLE_GATT_OP_WRITE_WITHOUT_RESP,          ///< Write the value without requesting a response
+    WARBLE_GATT_OP_ENABLE_NOTIFICATIONS,        ///< Enable characteristic notifications
+    WARBLE_GATT_OP_DISABLE_NOTIFICATIONS        ///< Disable characteristic notifications
+} WarbleGattOpType;
+
+/**
+ * Describes one operation in a batch
+ */
+typedef struct {
+    WarbleGattChar* gattchar;                   ///< Characteristic to operate on
+    WarbleGattOpType type;                      ///< What to do with the characteristic
+    const WARBLE_UBYTE* value;                  ///< Bytes to write, ignored for non write operations
+    WARBLE_USHORT len;                          ///< Number of bytes to write, up to 512 for WARBLE_GATT_OP_WRITE and 255 otherwise
+} WarbleGattOp;
+
+/**
+ * Outcome of one operation in a batch, or of one characteristic read with <code>warble_gatt_read_multiple</code>
+ */
+typedef struct {
+    WarbleGattChar* gattchar;                   ///< Characteristic the operation targeted
+    const WARBLE_UBYTE* value;                  ///< Value read from the characteristic, null for non read operations
+    WARBLE_USHORT len;                          ///< Number of bytes read
+    const char* error;                          ///< Null if the operation succeeded, error message otherwise
+} WarbleGattOpResult;
+
+/**
+ * 5 parameter function that accepts <code>(void*, WarbleGatt*, const WarbleGattOpResult*, int32_t, uint32_t)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param results           Outcome of each operation, in submission order
+ * @param nresults          Number of elements in the results array
+ * @param elapsed           Microseconds from submission until the last operation completed
+ */
+typedef void(*FnVoid_VoidP_WarbleGattP_WarbleGattOpResultP_Int_Uint)(void* context, WarbleGatt* caller, const WarbleGattOpResult* results, WARBLE_INT nresults, WARBLE_UINT elapsed);
\ No newline at end of file
@@ -32,14 +32,47 @@ WARBLE_API void warble_gattchar_write_async(WarbleGattChar* obj, const WARBLE_UB
  * @param handler       Callback function that is executed when the async task has completed
  */
 WARBLE_API void warble_gattchar_write_without_resp_async(WarbleGattChar* obj, const WARBLE_UBYTE* value, WARBLE_UBYTE len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+/**
+ * Writes a value of up to 512 bytes to the characteristic, requesting a response from the remote device.  Values 
+ * that do not fit in a single ATT PDU are sent with prepare and execute write requests
+ * @param obj           Calling object
+ * @param value         Pointer to the first byte to write
+ * @param len           Number of bytes to write
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when the async task has completed
+ */
+WARBLE_API void warble_gattchar_write_long_async(WarbleGattChar* obj, const WARBLE_UBYTE* value, WARBLE_USHORT len, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
+/**
+ * Queues a write without response command on the connection's stream.  The blepp backend hands queued commands to 
+ * the socket as fast as the kernel takes them, holding the rest while the adapter's buffers are full rather than 
+ * failing the write.  Once 'stream-window' commands are queued (an option of 
+ * <code>warble_gatt_create_with_options</code>, 1 to 65536, defaults to 32), further writes are refused until the handler set with 
+ * <code>warble_gatt_on_stream_ready</code> is called.  Commands go out in the order they were queued, but are not 
+ * ordered with the other characteristic operations.  Other backends send the command right away
+ * @param obj           Calling object
+ * @param value         Pointer to the first byte to write, copied before the function returns
+ * @param len           Number of bytes to write, at most 3 less than the ATT MTU
+ * @return 1 if the command was queued, 0 if the stream is full, -1 if the connection is down, the characteristic was 
+ * not found again after a reconnect, or the value does not fit in one command
+ */
+WARBLE_API WARBLE_INT warble_gattchar_stream_write(WarbleGattChar* obj, const WARBLE_UBYTE* value, WARBLE_USHORT len);
 
 /**
- * Reads the current value of the characteristic from the remote device
+ * Reads the current value of the characteristic from the remote device.  Values longer than 255 bytes fail the task 
+ * with a "value too long" error, use warble_gattchar_read_long_async for those
  * @param obj           Calling object
  * @param context       Additional data for the callback function
  * @param handler       Callback function that is executed when the async task has completed
  */
 WARBLE_API void warble_gattchar_read_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP handler);
+/**
+ * Reads the full value of the characteristic from the remote device, issuing read blob requests until 
+ * the remote device has sent every byte
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when the async task has completed
+ */
+WARBLE_API void warble_gattchar_read_long_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP handler);
 
 /**
  * Enables notifications on the characteristic
@@ -56,12 +89,61 @@ WARBLE_API void warble_gattchar_enable_notifications_async(WarbleGattChar* obj,
  */
 WARBLE_API void warble_gattchar_disable_notifications_async(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_CharP handler);
 /**
- * Sets a handler to listen for characteristic notifications
+ * Sets a handler to listen for characteristic notifications.  The handler's length is 8 bits so notifications longer 
+ * than 255 bytes are cut to their first 255 bytes, use warble_gattchar_on_notification_received_long or 
+ * warble_gattchar_on_notification_received_ex to receive the whole value
  * @param obj           Calling object
  * @param context       Additional data for the callback function
  * @param handler       Callback function that is executed when notifications are received
  */
 WARBLE_API void warble_gattchar_on_notification_received(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte handler);
+/**
+ * Variant of warble_gattchar_on_notification_received whose handler receives the full length of notifications 
+ * larger than 255 bytes.  Replaces any handler previously set on the characteristic
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when notifications are received
+ */
+WARBLE_API void warble_gattchar_on_notification_received_long(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort handler);
+/**
+ * Variant of warble_gattchar_on_notification_received_long whose handler also receives the kernel's receive timestamp 
+ * and the sequence gap.  Replaces any handler previously set on the characteristic.  Backends without receive 
+ * timestamps never call the handler
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when notifications are received
+ */
+WARBLE_API void warble_gattchar_on_notification_received_ex(WarbleGattChar* obj, void* context, FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP handler);
+/**
+ * Checks a counter in each notification value for skipped values, the result is passed to the extended notification 
+ * handler and counted in the sequence stats.  Notifications too short to hold the counter are not checked.  Resets 
+ * the sequence stats
+ * @param obj           Calling object
+ * @param config        Where the counter sits in the value
+ */
+WARBLE_API void warble_gattchar_set_sequence_tracking(WarbleGattChar* obj, const WarbleGattSequenceConfig* config);
+/**
+ * Gets the sequence tracking counters
+ * @param obj           Calling object
+ * @param stats         Struct to write the values to
+ */
+WARBLE_API void warble_gattchar_get_sequence_stats(const WarbleGattChar* obj, WarbleGattSequenceStats* stats);
+/**
+ * Copies buffered notifications, oldest first, into the caller's array.  Only characteristics belonging to a WarbleGatt 
+ * created with the 'notification-buffer' option queue notifications, the notification handlers are not called for them.  
+ * Must not be called from more than one thread at a time for the same characteristic
+ * @param obj           Calling object
+ * @param buf           Array to copy the notifications into
+ * @param max           Number of elements in the buf array
+ * @return Number of notifications copied
+ */
+WARBLE_API WARBLE_INT warble_gattchar_drain_notifications(WarbleGattChar* obj, WarbleGattNotification* buf, WARBLE_INT max);
+/**
+ * Gets how many notifications were discarded because the notification buffer was full
+ * @param obj           Calling object
+ * @return Number of dropped notifications since the characteristic was discovered
+ */
+WARBLE_API WARBLE_UINT warble_gattchar_get_dropped_notifications(const WarbleGattChar* obj);
 
 /**
  * Gets the string representation of the characteristic's uuid
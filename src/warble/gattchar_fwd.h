@@ -16,6 +16,48 @@ struct WarbleGattChar;
 typedef struct WarbleGattChar WarbleGattChar;
 #endif
 
+/**
+ * Largest notification payload, ATT MTU of 517 minus the 3 byte header
+ */
+#define WARBLE_NOTIFICATION_MAX_LEN 514
+
+/**
+ * Notification copied out of a characteristic's notification buffer
+ */
+typedef struct {
+    WARBLE_ULONG timestamp;                             ///< Nanoseconds since the Unix epoch when the kernel received the notification
+    WARBLE_USHORT len;                                  ///< Number of bytes in the value
+    WARBLE_UBYTE value[WARBLE_NOTIFICATION_MAX_LEN];    ///< Notification payload
+} WarbleGattNotification;
+
+/**
+ * Notification passed to the handler set with warble_gattchar_on_notification_received_ex
+ */
+typedef struct {
+    const WARBLE_UBYTE* value;                          ///< Notification payload, only valid for the duration of the callback
+    WARBLE_USHORT len;                                  ///< Number of bytes in the value
+    WARBLE_ULONG timestamp;                             ///< Nanoseconds since the Unix epoch when the kernel received the notification
+    WARBLE_UINT gap;                                    ///< Sequence counter values skipped right before this notification, 0 if sequence tracking is off
+} WarbleGattNotificationEvent;
+
+/**
+ * Location of a counter the remote device increments by 1 with every notification
+ */
+typedef struct {
+    WARBLE_USHORT offset;                               ///< Index of the counter's first byte in the notification value
+    WARBLE_UBYTE size;                                  ///< Counter width in bytes, between 1 and 4, 0 turns tracking off
+    WARBLE_UBYTE big_endian;                            ///< Non-zero if the most significant byte comes first
+} WarbleGattSequenceConfig;
+
+/**
+ * Sequence tracking counters of a characteristic
+ */
+typedef struct {
+    WARBLE_UINT gaps;                                   ///< Notifications that came after one or more skipped counter values
+    WARBLE_UINT missing;                                ///< Total counter values skipped
+    WARBLE_UINT out_of_order;                           ///< Notifications that repeated the previous counter or went back by more than half its range
+} WarbleGattSequenceStats;
+
 /**
  * 3 parameter function that accepts <code>(void*, WarbleGattChar*, const char*)</code> and has no return value
  * @param context           Additional data registered with the callback function
@@ -39,4 +81,28 @@ typedef void(*FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte)(void* context, WarbleGa
  * @param length            Number of bytes for the value
  * @param value2            Additional data returned to the function
  */
-typedef void(*FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP)(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_UBYTE length, const char* value2);
\ No newline at end of file
+typedef void(*FnVoid_VoidP_WarbleGattCharP_UbyteP_Ubyte_CharP)(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_UBYTE length, const char* value2);
+/**
+ * 4 parameter function that accepts <code>(void*, WarbleGattChar*, const uint8_t*, uint16_t)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param value             Pointer to the beginning of a byte array
+ * @param length            Number of bytes for the value
+ */
+typedef void(*FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort)(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_USHORT length);
+/**
+ * 5 parameter function that accepts <code>(void*, WarbleGattChar*, const uint8_t*, uint16_t, const char*)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param value             Pointer to the beginning of a byte array
+ * @param length            Number of bytes for the value
+ * @param value2            Additional data returned to the function
+ */
+typedef void(*FnVoid_VoidP_WarbleGattCharP_UbyteP_Ushort_CharP)(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_USHORT length, const char* value2);
+/**
+ * 3 parameter function that accepts <code>(void*, WarbleGattChar*, const WarbleGattNotificationEvent*)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param event             Notification value and its receive details
+ */
+typedef void(*FnVoid_VoidP_WarbleGattCharP_WarbleGattNotificationEventP)(void* context, WarbleGattChar* caller, const WarbleGattNotificationEvent* event);
\ No newline at end of file
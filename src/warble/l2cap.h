@@ -0,0 +1,155 @@
+/**
+ * @copyright MbientLab License
+ * @file l2cap.h
+ * @brief Functions for the WarbleL2capChannel object
+ */
+#pragma once
+
+#include "dllmarker.h"
+#include "gatt_fwd.h"
+#include "l2cap_fwd.h"
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates a WarbleL2capChannel object for an LE credit based channel to the device the WarbleGatt object is 
+ * connected to.  Data on the channel is sent as whole SDUs, each one up to 65535 bytes, without ATT framing.  The blepp 
+ * backend reads these options:
+ * <ul>
+ *  <li>'mtu': largest SDU the local device accepts, 23 to 65535, defaults to 65535</li>
+ *  <li>'security': security level the channel needs before it is opened, one of 'low', 'medium', or 'high', 
+ *      defaults to 'low'</li>
+ *  <li>'connect-timeout': milliseconds to wait for the remote device to accept the channel, defaults to 10000</li>
+ * </ul>
+ * @param gatt          Object for the ACL link the channel runs over, must be connected when the channel is opened and 
+ *                      outlive the channel
+ * @param psm           Protocol/service multiplexer the remote device listens on
+ * @param nopts         Number of options being passed
+ * @param opts          Array of config options
+ * @return Pointer to the newly created object, null if the backend does not support L2CAP channels
+ */
+WARBLE_API WarbleL2capChannel* warble_l2cap_create(WarbleGatt* gatt, WARBLE_USHORT psm, WARBLE_INT nopts, const WarbleOption* opts);
+/**
+ * Frees the memory allocated for the WarbleL2capChannel object, closing the channel if it is open.  Must not be called 
+ * from one of the channel's callback functions
+ * @param obj           Object to delete
+ */
+WARBLE_API void warble_l2cap_delete(WarbleL2capChannel* obj);
+/**
+ * Opens the channel
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when the channel is open or could not be opened
+ */
+WARBLE_API void warble_l2cap_connect_async(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_CharP handler);
+/**
+ * Closes the channel, the handler set with <code>warble_l2cap_on_close</code> is called once it is down.  The 
+ * ACL link is left up
+ * @param obj           Calling object
+ */
+WARBLE_API void warble_l2cap_close(WarbleL2capChannel* obj);
+/**
+ * Sets a handler that is called when the channel closes, either side closing it or the ACL link dropping.  The 
+ * status is 0 if the channel was closed with <code>warble_l2cap_close</code>, otherwise the errno value the socket 
+ * reported
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when the channel closes
+ */
+WARBLE_API void warble_l2cap_on_close(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_Int handler);
+/**
+ * Checks if the channel is open
+ * @param obj           Calling object
+ * @return 0 if not open, non-zero if open
+ */
+WARBLE_API WARBLE_INT warble_l2cap_is_open(const WarbleL2capChannel* obj);
+/**
+ * Gets the largest SDU the remote device accepts, only valid while the channel is open
+ * @param obj           Calling object
+ * @return Largest number of bytes <code>warble_l2cap_send</code> can send at once
+ */
+WARBLE_API WARBLE_USHORT warble_l2cap_get_send_mtu(const WarbleL2capChannel* obj);
+/**
+ * Gets the largest SDU the local device accepts, only valid while the channel is open
+ * @param obj           Calling object
+ * @return Largest number of bytes a received SDU can hold
+ */
+WARBLE_API WARBLE_USHORT warble_l2cap_get_receive_mtu(const WarbleL2capChannel* obj);
+/**
+ * Sends one SDU without blocking.  The kernel splits it into PDUs and sends them as the remote device hands out 
+ * credits.  When the socket has no room left the SDU is refused, and the handler set with 
+ * <code>warble_l2cap_on_send_ready</code> is called once it can take more
+ * @param obj           Calling object
+ * @param value         Pointer to the first byte to send
+ * @param len           Number of bytes to send, at most <code>warble_l2cap_get_send_mtu</code>
+ * @return 1 if the SDU was sent, 0 if the socket is full, -1 if the channel is not open or the SDU is too long
+ */
+WARBLE_API WARBLE_INT warble_l2cap_send(WarbleL2capChannel* obj, const WARBLE_UBYTE* value, WARBLE_USHORT len);
+/**
+ * Sets a handler that is called on the I/O thread when the socket has room again after 
+ * <code>warble_l2cap_send</code> refused an SDU
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when SDUs can be sent again
+ */
+WARBLE_API void warble_l2cap_on_send_ready(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP handler);
+/**
+ * Sets a handler that is called on the I/O thread with each SDU the remote device sends.  While a handler is set, 
+ * SDUs are read as soon as they arrive and <code>warble_l2cap_read</code> has nothing to return.  Pass null to 
+ * leave SDUs for <code>warble_l2cap_read</code> instead
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when an SDU is received
+ */
+WARBLE_API void warble_l2cap_on_sdu_received(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort handler);
+/**
+ * Sets a handler that is called on the I/O thread when SDUs are waiting to be read with <code>warble_l2cap_read</code>.  
+ * The handler is called once, and is armed again when <code>warble_l2cap_read</code> finds no SDU waiting.  Received 
+ * SDUs stay in the socket until read, and the remote device is given credits for more as they are
+ * @param obj           Calling object
+ * @param context       Additional data for the callback function
+ * @param handler       Callback function that is executed when there is data to read
+ */
+WARBLE_API void warble_l2cap_on_readable(WarbleL2capChannel* obj, void* context, FnVoid_VoidP_WarbleL2capChannelP handler);
+/**
+ * Copies the next received SDU into the buffer without blocking
+ * @param obj           Calling object
+ * @param buffer        Buffer to copy the SDU into
+ * @param capacity      Size of the buffer, an SDU longer than this is cut short and the rest of it is lost
+ * @return Number of bytes copied, 0 if no SDU is waiting, -1 if the channel is not open
+ */
+WARBLE_API WARBLE_INT warble_l2cap_read(WarbleL2capChannel* obj, WARBLE_UBYTE* buffer, WARBLE_UINT capacity);
+/**
+ * Gets the socket to watch when the library runs with the 'io-mode' option set to 'manual', see 
+ * <code>warble_gatt_get_fd</code>
+ * @param obj           Calling object
+ * @param events        Set to the WARBLE_IO flags to watch for
+ * @return Socket to watch, -1 if there is none right now or the library does not run in 'manual' mode
+ */
+WARBLE_API WARBLE_INT warble_l2cap_get_fd(const WarbleL2capChannel* obj, WARBLE_UINT* events);
+/**
+ * Gets how long the event loop can wait before calling <code>warble_l2cap_process</code> even if the socket has no 
+ * events
+ * @param obj           Calling object
+ * @return Milliseconds to wait, -1 to wait only on the socket
+ */
+WARBLE_API WARBLE_INT warble_l2cap_get_timeout(const WarbleL2capChannel* obj);
+/**
+ * Runs one non-blocking step of the channel in 'manual' mode, see <code>warble_gatt_process</code>
+ * @param obj           Calling object
+ * @param events        WARBLE_IO flags the event loop saw on the socket, 0 if the wait timed out
+ */
+WARBLE_API void warble_l2cap_process(WarbleL2capChannel* obj, WARBLE_UINT events);
+/**
+ * Gets the WarbleGatt object the channel was created from
+ * @param obj           Calling object
+ * @return WarbleGatt object the channel runs over
+ */
+WARBLE_API WarbleGatt* warble_l2cap_get_gatt(const WarbleL2capChannel* obj);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,46 @@
+/**
+ * @copyright MbientLab License
+ * @file l2cap_fwd.h
+ * @brief Type declarations for the WarbleL2capChannel functions
+ */
+#pragma once
+
+#include "types.h"
+
+/**
+ * LE credit based L2CAP channel to a connected remote device
+ */
+#ifdef __cplusplus
+struct WarbleL2capChannel;
+#else
+typedef struct WarbleL2capChannel WarbleL2capChannel;
+#endif
+
+/**
+ * 3 parameter function that accepts <code>(void*, WarbleL2capChannel*, const char*)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param value             Additional data returned to the function
+ */
+typedef void(*FnVoid_VoidP_WarbleL2capChannelP_CharP)(void* context, WarbleL2capChannel* caller, const char* value);
+/**
+ * 3 parameter function that accepts <code>(void*, WarbleL2capChannel*, int)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param value             Additional data returned to the function
+ */
+typedef void(*FnVoid_VoidP_WarbleL2capChannelP_Int)(void* context, WarbleL2capChannel* caller, WARBLE_INT value);
+/**
+ * 2 parameter function that accepts <code>(void*, WarbleL2capChannel*)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ */
+typedef void(*FnVoid_VoidP_WarbleL2capChannelP)(void* context, WarbleL2capChannel* caller);
+/**
+ * 4 parameter function that accepts <code>(void*, WarbleL2capChannel*, const uint8_t*, uint16_t)</code> and has no return value
+ * @param context           Additional data registered with the callback function
+ * @param caller            Object associated with the callback function
+ * @param value             Byte array returned to the function
+ * @param length            Number of bytes in the array
+ */
+typedef void(*FnVoid_VoidP_WarbleL2capChannelP_UbyteP_Ushort)(void* context, WarbleL2capChannel* caller, const WARBLE_UBYTE* value, WARBLE_USHORT length);
@@ -6,8 +6,17 @@
 #pragma once
 
 #include "dllmarker.h"
+#include "gatt_fwd.h"
 #include "types.h"
 
+/**
+ * Number of links warble holds on a local adapter
+ */
+typedef struct {
+    char mac[18];               ///< Mac address of the adapter
+    WARBLE_INT links;           ///< Connections that are active or being established on the adapter
+} WarbleAdapterLinks;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,6 +37,20 @@ WARBLE_API const char* warble_lib_config();
  * @param opts      Array of config options
  */
 WARBLE_API void warble_lib_init(WARBLE_INT nopts, const WarbleOption* opts);
+/**
+ * Gets the link count of each local adapter that is up or holds a warble connection.  WarbleGatt objects created 
+ * with the 'hci' option set to 'auto', or a comma separated list of adapters, connect through the adapter with the 
+ * fewest links.  Backends that do not pick adapters report none
+ * @param links     Array to fill
+ * @param max       Number of elements the links array can hold
+ * @return Number of adapters, which may be greater than max
+ */
+WARBLE_API WARBLE_INT warble_lib_get_adapter_links(WarbleAdapterLinks* links, WARBLE_INT max);
+/**
+ * Gets the timings and counters of every WarbleGatt object the library has created, including deleted ones
+ * @param stats     Struct to write the values to
+ */
+WARBLE_API void warble_lib_get_stats(WarbleGattStats* stats);
 
 #ifdef __cplusplus
 }
@@ -29,6 +29,17 @@ WARBLE_API void warble_scanner_start(WARBLE_INT nopts, const WarbleOption* opts)
  * Stops the BLE scan
  */
 WARBLE_API void warble_scanner_stop();
+/**
+ * Gets the socket advertising reports arrive on while a scan is running and the library was initialized with the 
+ * 'io-mode' option set to 'manual', the event loop watches it for WARBLE_IO_READ
+ * @return Socket to watch, -1 if there is no scan running or the library does not run in 'manual' mode
+ */
+WARBLE_API WARBLE_INT warble_scanner_get_fd();
+/**
+ * Reads one batch of advertising reports without blocking and passes them to the scan handler, on the calling thread, 
+ * in 'manual' mode.  Does nothing in the other modes
+ */
+WARBLE_API void warble_scanner_process();
 
 /**
  * Extracts the manufacturer data from the ad packet
@@ -12,6 +12,7 @@
 #define WARBLE_USHORT std::uint16_t
 #define WARBLE_UINT std::uint32_t
 #define WARBLE_INT std::int32_t
+#define WARBLE_ULONG std::uint64_t
 
 #else
 
@@ -20,9 +21,23 @@
 #define WARBLE_USHORT uint16_t
 #define WARBLE_UINT uint32_t
 #define WARBLE_INT int32_t
+#define WARBLE_ULONG uint64_t
 
 #endif
 
+/**
+ * Socket is, or should be watched for being, readable.  Used with the get_fd and process functions of the 'manual' io-mode
+ */
+#define WARBLE_IO_READ 0x1
+/**
+ * Socket is, or should be watched for being, writable
+ */
+#define WARBLE_IO_WRITE 0x2
+/**
+ * Socket reported an error or hangup, always watched for
+ */
+#define WARBLE_IO_ERROR 0x4
+
 /**
  * Simple string pair used to configure the API
  */
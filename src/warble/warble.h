@@ -5,7 +5,9 @@
  */
 #pragma once
 
+#include "connmgr.h"
 #include "gatt.h"
 #include "gattchar.h"
+#include "l2cap.h"
 #include "lib.h"
 #include "scanner.h"
\ No newline at end of file
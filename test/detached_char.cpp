@@ -0,0 +1,133 @@
+// run: make test
+//
+// Reconnects to the simulated device in test/detached_char.sim, whose second characteristic is gone on the second
+// link, and checks every operation on the stale object fails locally instead of going out with ATT handle 0
+#include "warble/warble.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+static const char* KEPT_UUID = "326a9001-85cb-9195-d9dd-464cfbbae75a";
+static const char* DROPPED_UUID = "326a9002-85cb-9195-d9dd-464cfbbae75a";
+static const char* DETACHED = "no longer present";
+
+// Waits on one callback from warble's threads, holding on to its error
+class Outcome {
+public:
+    Outcome() : failed(false), done(false) {
+    }
+
+    void complete(const char* error) {
+        lock_guard<mutex> lock(m);
+        failed = error != nullptr;
+        this->error = failed ? error : "";
+        done = true;
+        cv.notify_all();
+    }
+
+    // false if the callback did not run in time
+    bool wait() {
+        unique_lock<mutex> lock(m);
+        bool finished = cv.wait_for(lock, seconds(5), [this]() { return done; });
+        done = false;
+        return finished;
+    }
+
+    bool failed;
+    string error;
+
+private:
+    mutex m;
+    condition_variable cv;
+    bool done;
+};
+
+static int failures = 0;
+
+static void check(bool passed, const char* what, const string& detail = "") {
+    printf("%s: %s%s%s\n", passed ? "PASS" : "FAIL", what, detail.empty() ? "" : " - ", detail.c_str());
+    if (!passed) {
+        failures++;
+    }
+}
+
+static void check_detached(Outcome& outcome, const char* what) {
+    bool finished = outcome.wait();
+    check(finished && outcome.failed && outcome.error.find(DETACHED) != string::npos, what, finished ? outcome.error : "timed out");
+}
+
+static void on_write(void* context, WarbleGattChar* caller, const char* error) {
+    static_cast<Outcome*>(context)->complete(error);
+}
+
+static void on_read(void* context, WarbleGattChar* caller, const WARBLE_UBYTE* value, WARBLE_UBYTE len, const char* error) {
+    static_cast<Outcome*>(context)->complete(error);
+}
+
+static bool connect(WarbleGatt* gatt, Outcome& outcome) {
+    warble_gatt_connect_async(gatt, &outcome, [](void* context, WarbleGatt* caller, const char* error) {
+        static_cast<Outcome*>(context)->complete(error);
+    });
+    return outcome.wait() && !outcome.failed;
+}
+
+int main(int argc, char** argv) {
+    WarbleOption lib_opts[] = { { "sim-file", argc > 1 ? argv[1] : "test/detached_char.sim" } };
+    warble_lib_init(1, lib_opts);
+
+    WarbleOption gatt_opts[] = { { "mac", "CA:FE:00:00:00:02" } };
+    auto gatt = warble_gatt_create_with_options(1, gatt_opts);
+    Outcome outcome;
+
+    check(connect(gatt, outcome), "first connect", outcome.error);
+    auto kept = warble_gatt_find_characteristic(gatt, KEPT_UUID);
+    auto dropped = warble_gatt_find_characteristic(gatt, DROPPED_UUID);
+    check(kept != nullptr && dropped != nullptr, "both characteristics found on the first link");
+    if (kept == nullptr || dropped == nullptr) {
+        return 1;
+    }
+
+    warble_gatt_on_disconnect(gatt, &outcome, [](void* context, WarbleGatt* caller, WARBLE_INT status) {
+        static_cast<Outcome*>(context)->complete(nullptr);
+    });
+    warble_gatt_disconnect(gatt);
+    check(outcome.wait(), "disconnect");
+    warble_gatt_on_disconnect(gatt, nullptr, [](void* context, WarbleGatt* caller, WARBLE_INT status) { });
+
+    check(connect(gatt, outcome), "second connect", outcome.error);
+    check(warble_gatt_find_characteristic(gatt, DROPPED_UUID) == nullptr, "dropped characteristic is not found on the second link");
+
+    const WARBLE_UBYTE value[] = { 0xaa, 0xbb };
+    warble_gattchar_read_async(dropped, &outcome, on_read);
+    check_detached(outcome, "read");
+    warble_gattchar_write_async(dropped, value, sizeof(value), &outcome, on_write);
+    check_detached(outcome, "write");
+    warble_gattchar_write_without_resp_async(dropped, value, sizeof(value), &outcome, on_write);
+    check_detached(outcome, "write without response");
+    warble_gattchar_enable_notifications_async(dropped, &outcome, on_write);
+    check_detached(outcome, "enable notifications");
+    check(warble_gattchar_stream_write(dropped, value, sizeof(value)) == -1, "stream write");
+
+    WarbleGattChar* chars[] = { dropped, kept };
+    string multiple_errors[2];
+    warble_gatt_read_multiple(gatt, chars, 2, multiple_errors, [](void* context, WarbleGatt* caller, const WarbleGattOpResult* results, WARBLE_INT nresults, WARBLE_UINT elapsed_us) {
+        auto errors = static_cast<string*>(context);
+        for(WARBLE_INT i = 0; i < nresults; i++) {
+            errors[i] = results[i].error == nullptr ? "" : results[i].error;
+        }
+    });
+    warble_gattchar_read_async(kept, &outcome, on_read);
+    // ops complete in order, the read multiple has finished once the read after it has
+    check(outcome.wait() && !outcome.failed, "read on the remaining characteristic", outcome.error);
+    check(multiple_errors[0].find(DETACHED) != string::npos && multiple_errors[1].empty(), "read multiple", multiple_errors[0]);
+
+    warble_gatt_delete(gatt);
+    return failures == 0 ? 0 : 1;
+}